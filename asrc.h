@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Filter length in input frames and number of stored filter phases.
+// Coefficients are linearly interpolated between adjacent phases.
+#define ASRC_TAPS 16
+#define ASRC_PHASES_LOG2 8
+#define ASRC_PHASES (1 << ASRC_PHASES_LOG2)
+
+// Upper bound of input frames consumed by one asrc_process() call
+#define ASRC_MAX_INPUT_FRAMES 256
+
+typedef struct {
+  uint32_t input_rate;
+  uint32_t output_rate;
+  uint64_t nominal_step;  // Input frames per output frame (32.32 fixed point)
+  uint64_t step;          // nominal_step with the current ratio adjustment
+  uint32_t frac;          // Position between input frames (0.32)
+  // Q15 coefficients. Each phase sums to exactly 1.0 so that the DC gain
+  // does not depend on the phase.
+  int16_t coeffs[ASRC_PHASES + 1][ASRC_TAPS];
+  // The last ASRC_TAPS input frames followed by the new input (interleaved)
+  int32_t history[(ASRC_TAPS + ASRC_MAX_INPUT_FRAMES) * 2];
+} asrc_t;
+
+/**
+ * @brief Prepares a converter from input_rate to output_rate (stereo).
+ *
+ * The filter is designed for this pair of rates. Designing it takes a few
+ * milliseconds on the RP2040, so nothing is recomputed when the rates are
+ * unchanged since the previous call; only the state is reset.
+ */
+void asrc_init(asrc_t *asrc, uint32_t input_rate, uint32_t output_rate);
+
+/**
+ * @brief Clears the filter history and the fractional position.
+ */
+void asrc_reset(asrc_t *asrc);
+
+/**
+ * @brief Adjusts the conversion ratio around the nominal one.
+ *
+ * @param ppb Positive values consume input faster, in parts per billion.
+ */
+void asrc_set_ratio_adjust(asrc_t *asrc, int32_t ppb);
+
+/**
+ * @brief Returns how many input frames the next asrc_process() call with
+ * output_frames consumes.
+ */
+uint32_t asrc_input_frames(const asrc_t *asrc, uint32_t output_frames);
+
+/**
+ * @brief Converts interleaved stereo frames.
+ *
+ * @param input Exactly asrc_input_frames(asrc, output_frames) frames.
+ * @param output Receives output_frames frames.
+ */
+void asrc_process(asrc_t *asrc, const int32_t *input, uint32_t input_frames,
+                  int32_t *output, uint32_t output_frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,20 @@
 #include "audio_device.h"
 
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "asrc.h"
 #include "blink.h"
+#include "capture.h"
+#include "clock_monitor.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
 #include "i2s.h"
 #include "log.h"
 #include "ringbuffer.h"
+#include "sample_format.h"
+#include "spdif_rx.h"
 
 //--------------------------------------------------------------------+/
 // MACRO CONSTANT TYPEDEF PROTOTYPES
@@ -15,31 +23,288 @@
 // --- Configuration ---
 #define I2S_DATA_PIN PICODAC_I2S_DATA_PIN
 #define I2S_CLOCK_PIN_BASE PICODAC_I2S_BASE_CLOCK_PIN  // LRCLK = BASE + 1
+#define I2S_MCLK_PIN PICODAC_I2S_MCLK_PIN
+#define I2S_MCLK_MULTIPLIER PICODAC_I2S_MCLK_MULTIPLIER  // 0: MCLK 出力なし
+// 水位はホスト側シミュレータ (tools/sim) から上書きできる
+#ifndef SAFE_WATER_LEVEL
 #define SAFE_WATER_LEVEL 0.5
+#endif
+#ifndef UNDERRUN_WATER_LEVEL
 #define UNDERRUN_WATER_LEVEL 0.16
-#define RECOVERY_WATER_LEVEL 0.4
+#endif
+// アンダーランから再開する水位。再開時はフェードインするため低めでよい
+#ifndef RECOVERY_WATER_LEVEL
+#define RECOVERY_WATER_LEVEL 0.22
+#endif
 #define PIO pio0
 
+// PICODAC_DUAL_OUTPUT=1 の 2 つ目のステレオ出力 (pio1、マスターモード)
+#define I2S2_DATA_PIN PICODAC_I2S2_DATA_PIN
+#define I2S2_CLOCK_PIN_BASE PICODAC_I2S2_BASE_CLOCK_PIN  // LRCLK = BASE + 1
+#define I2S2_MCLK_PIN PICODAC_I2S2_MCLK_PIN
+#define PIO2 pio1
+
+// PICODAC_LOW_LATENCY で DMA ブロック長とリングバッファ長の組を選ぶ
+// 0: 1ms / 16ms, 1: 0.5ms / 8ms, 2: 0.25ms / 4ms
+// ブロックが短いほどブロック処理と DMA 割り込みの回数が増え、CPU 負荷が上がる
+#define LOW_LATENCY PICODAC_LOW_LATENCY
+#define BLOCK_US (LOW_LATENCY == 2 ? 250 : LOW_LATENCY == 1 ? 500 : 1000)
+// リングバッファ長 (ms)。水位はこの長さに対する比率
+#define RING_MS (LOW_LATENCY == 2 ? 4 : LOW_LATENCY == 1 ? 8 : 16)
+// I2S の DMA バッファ数。DMA が CPU を介さず順に再生するため、
+// ブロック処理が (DMA_BLOCKS - 1) ブロック分遅れても途切れない
+// 短いブロックでは割り込みやフラッシュ書き込みによる遅れの余裕を確保する
+// PDM ではコア 1 が変調する間もブロックを先に渡しておく
+#define DMA_BLOCKS (LOW_LATENCY || PDM ? 4 : 2)
+// CPU 負荷の集計窓
+#define CPU_WINDOW_US 1000000
+
+// PICODAC_I2S_CLOCK_SLAVE=1 で BCLK/LRCLK を外部発振器から受け取る
+#if PICODAC_I2S_CLOCK_SLAVE
+#define I2S_CLOCK_MODE I2S_CLOCK_SLAVE
+#else
+#define I2S_CLOCK_MODE I2S_CLOCK_MASTER
+#endif
+
+// PICODAC_I2S_FORMAT でシリアル形式を選ぶ (マスターモードのみ)
+// 0: I2S, 1: 左詰め, 2: 右詰め, 3: TDM (PICODAC_I2S_TDM_SLOTS スロット)
+#define I2S_FORMAT ((i2s_format_t)PICODAC_I2S_FORMAT)
+#define I2S_TDM_SLOTS PICODAC_I2S_TDM_SLOTS
+// PICODAC_I2S_DATA_LINES 本の隣接ピンに 2ch ずつ出力する (1〜4)
+#define I2S_DATA_LINES PICODAC_I2S_DATA_LINES
+
+// PICODAC_SPDIF で出力 0 に S/PDIF を加える
+// 0: なし, 1: I2S の代わりに S/PDIF, 2: I2S と同時に S/PDIF
+// S/PDIF には先頭の 2ch (ステレオまたは FL FR) を出力する
+#define SPDIF ((i2s_spdif_mode_t)PICODAC_SPDIF)
+#define SPDIF_PIN PICODAC_SPDIF_PIN
+
+// PICODAC_PDM=1 で出力 0 を I2S の代わりに PDM (1 ビット DAC) にする
+// PICODAC_PDM_PIN と +1 に L/R のビット列を出し、RC フィルタで音声に戻す
+// 変調はコア 1 で行う。先頭の 2ch を出力し、レートは 48kHz まで
+#define PDM PICODAC_PDM
+#define PDM_PIN PICODAC_PDM_PIN
+
+// PICODAC_DSD=1 で出力 0 にネイティブ DSD64 の alt を加える。88.2kHz の
+// フレームに 32 ビットずつの DSD を受け、2.8224MHz のビット列で出力する
+// DSD クロックは BCLK、左はデータピン、右は LRCLK
+// データピンは LRCLK の次 (PICODAC_I2S_BASE_CLOCK_PIN + 2) に置く
+// DSD には音量をかけず、ミュートは DSD の無音
+#define DSD PICODAC_DSD
+
+// PICODAC_SPDIF_IN=1 で S/PDIF 入力を出力 0 の 2 つ目の音源にする
+// USB のストリームが止まっている間、ロックした入力を再生する。USB が優先
+// 受信ステートマシンは LED と同じ pio1 に置く (PICODAC_DUAL_OUTPUT とは排他)
+#define SPDIF_IN PICODAC_SPDIF_IN
+#define SPDIF_IN_PIN PICODAC_SPDIF_IN_PIN
+#define SPDIF_IN_PIO pio1
+// 1 回に受信するフレーム数
+#define SPDIF_IN_CHUNK_FRAMES 64
+// ASRC なしでは、水位が目標からこれだけずれたら 1 フレーム捨てるか繰り返す
+#define SPDIF_IN_SLIP_MS 1.0f
+#define SPDIF_IN_SLIP_LPF_ALPHA 0.05f
+
+// PICODAC_ADC=1 で出力 0 の BCLK/LRCLK に ADC をつなぎ、PICODAC_ADC_DATA_PIN の
+// I2S 入力を USB の IN ストリームで送る (capture.c)。再生していない間は無音を
+// 出してクロックだけを動かす
+#define ADC PICODAC_ADC
+#define ADC_DATA_PIN PICODAC_ADC_DATA_PIN
+// クロックだけを動かす時のスロット幅 (64fs)
+#define CAPTURE_CLOCK_BIT_DEPTH 32
+
+// 実レート測定の窓長 (SOF 数の log2)。2^7 = 128ms で 1/128 frame の分解能
+#define RATE_WINDOW_SOF_LOG2 7
+// 外部クロックの実レートが公称からこれ以上ずれていれば、ホストの選んだ
+// レートと外部発振器が合っていない。窓の分解能 (44.1kHz で約 180ppm) と
+// 発振器の偏差を見込む
+#define RATE_MISMATCH_PPM 500
+
+// PICODAC_CLOCK_MONITOR=1 で空き PIO ステートマシンにより LRCLK を計測する
+// S/PDIF のみと PDM の出力には LRCLK がないので使わない
+#define CLOCK_MONITOR \
+  (PICODAC_CLOCK_MONITOR && SPDIF != I2S_SPDIF_ONLY && !PDM)
+
+// PICODAC_SYNC_START=1 で、再生開始を特定の SOF フレーム番号に揃える
+// 同一ホストに繋いだ複数台が同じフレームの同じ時刻に再生を開始する
+#define SYNC_START PICODAC_SYNC_START
+// 開始フレームはこの倍数のフレーム番号から選ぶ
+#define SYNC_START_FRAME_INTERVAL 16
+// SOF から I2S 開始までの遅延。SOF 割り込みの遅延揺らぎを吸収する
+#define SYNC_START_DELAY_US 500
+// 開始時にリングバッファへ残すパケット数 (リングバッファの SAFE_WATER_LEVEL)
+#define SYNC_START_DEPTH_PACKETS (RING_MS / 2)
+#define SYNC_START_MAX_PACKETS 32
+
+// PICODAC_FAST_START=1 で、半分まで溜まるのを待たずに低い水位で再生を始める
+// 再生しながらフィードバックで多めに要求し、SAFE_WATER_LEVEL まで溜める
+#define FAST_START PICODAC_FAST_START
+// 再生を始める水位 (ms)。溜めている間は 1 ブロック未満をアンダーランとする
+#define FAST_START_DEPTH_MS 3
+// 溜めている間に上乗せして要求するレート
+#define FAST_START_RATE_BOOST 0.02f
+// フィードバックを無視するホストのため、溜めるのはこの時間で打ち切る
+#define FAST_START_MAX_FILL_US 1000000
+
+// PICODAC_ADAPTIVE_DEPTH=1 で、パケット到着間隔の揺らぎと最低水位を観測し、
+// リングバッファ長 (= 目標深さの 2 倍) を実行時に伸縮する
+// 水位は全てリングバッファ長に対する比率なので、フィードバックが新しい深さへ導く
+#define ADAPTIVE_DEPTH PICODAC_ADAPTIVE_DEPTH
+#define ADAPTIVE_WINDOW_US 2000000
+#define ADAPTIVE_MIN_RING_MS (RING_MS < 8 ? RING_MS : 8)
+#define ADAPTIVE_MAX_RING_MS 32
+#define ADAPTIVE_STEP_RING_MS 2
+// アンダーラン水位に対して最低水位が保つべき余裕 (これに揺らぎを加える)
+#define ADAPTIVE_MARGIN_MS 1.0f
+// 縮める判定のヒステリシス
+#define ADAPTIVE_SHRINK_HYSTERESIS_MS 1.5f
+
+// PICODAC_ASRC=1 で、リングバッファと I2S の間に ASRC を挟む
+// 変換比をリングバッファの水位で制御するため、フィードバックを無視するホストでも
+// バッファが溢れたり枯渇したりしない。この時フィードバックは公称レートを返す
+#define ASRC PICODAC_ASRC
+// 0 以外なら I2S をこのレートに固定し、全てのレートを ASRC で変換する
+// PLL と PIO の設定がストリームのレートによらず一定になる
+#define ASRC_OUTPUT_RATE PICODAC_ASRC_OUTPUT_RATE
+// 水位誤差から変換比への係数とローパスフィルタ係数 (feedback() と同じ形)
+#define ASRC_STEER_GAIN 0.01f
+#define ASRC_STEER_LPF_ALPHA 0.01f
+
+// フォーマット切り替え
+// 停止から FORMAT_SWITCH_KEEP_US 以内に同じレートで再開したときは、
+// リングバッファの中身を捨てずにそのまま鳴らす (サンプルは左詰めなので
+// ビット深度によらない)
+#define FORMAT_SWITCH_KEEP_US 20000
+
 // 256 刻みで指定
 enum {
   VOLUME_CTRL_0_DB = 0,
   VOLUME_CTRL_96_DB = 96 * 256,
 };
 
-// --- Module-level Static Variables ---
-static ringbuffer_t rb;
-static app_state_t g_current_state;
-static i2s_config_t i2s_config;
+// 各出力の状態。出力 0 は pio0、出力 1 (PICODAC_DUAL_OUTPUT=1) は pio1 を使う
+// LED とクロックモニタは出力 0 のもの
+typedef enum {
+  FADE_NONE,
+  FADE_OUT,
+  FADE_IN,
+} fade_t;
+
+// SOF 同期開始で記録するパケット
+typedef struct {
+  uint16_t frame;
+  uint16_t bytes;
+} sync_packet_t;
+
+typedef struct {
+  uint8_t id;
+  ringbuffer_t rb;
+  volatile app_state_t g_current_state;
+  i2s_config_t i2s_config;
 
-static uint32_t current_sample_rate = 48000;
-static uint8_t current_bit_depth = 16;
+  uint32_t current_sample_rate;
+  uint8_t current_bit_depth;
+  uint8_t current_channels;
 
-static float steady_buffer_fill_ratio = 0;
+  float steady_buffer_fill_ratio;
+  uint32_t ring_ms;
 
-// Audio controls - Current states
-static int8_t mute[3] = {0, 0, 0};  // 0: unmuted, 1: muted
-static int16_t volume[3] = {VOLUME_CTRL_0_DB, VOLUME_CTRL_0_DB,
-                            VOLUME_CTRL_0_DB};
+  audio_device_stats_t stats;
+
+  // ブロック処理の CPU 時間 (CPU_WINDOW_US ごとに cpu_stats へ集計)
+  audio_device_cpu_stats_t cpu_stats;
+  uint64_t cpu_window_start_us;
+  uint32_t cpu_busy_us;
+  uint32_t cpu_busy_blocks;
+
+  // SOF 基準で数えた I2S の実レート (frames/ms, 16.16 固定小数点)
+  volatile uint32_t measured_rate_q16;
+  volatile bool measured_rate_valid;
+  // 最後に測った外部クロックのレート。停止後も残し、ホストのレート選択を検証する
+  volatile uint32_t external_rate_q16;
+  volatile bool external_rate_known;
+  bool rate_window_started;
+  uint32_t rate_window_start_frames;
+  uint32_t rate_sof_count;
+
+  // SOF 同期開始
+  // ARMED 中はパケットごとの受信フレーム番号を記録し、
+  // リングバッファを直近 SYNC_START_DEPTH_PACKETS パケットに保つ
+  sync_packet_t sync_packets[SYNC_START_MAX_PACKETS];
+  uint32_t sync_packets_head;
+  volatile uint32_t sync_packets_count;
+  volatile uint64_t sync_sof_time_us;
+  volatile bool sync_start_fired;
+  int sync_alarm_num;
+  audio_device_sync_start_stats_t sync_start_stats;
+
+  // アンダーランの補間
+  // 直前の音声をフェードアウトしてから無音にし、再開時にフェードインする
+  fade_t fade;
+  uint64_t underrun_start_us;
+  uint32_t underrun_concealed_frames;
+  audio_device_underrun_stats_t underrun_stats;
+
+  // 高速開始
+  // fast_start_filling の間はフィードバックで多めに要求し、アンダーラン判定を緩める
+  volatile bool fast_start_filling;
+  uint64_t stream_start_time_us;
+  uint64_t first_packet_time_us;
+  audio_device_start_stats_t start_stats;
+
+  // フォーマット切り替え (FORMAT_SWITCH_KEEP_US を参照)
+  uint64_t output_stop_time_us;
+  uint32_t output_stop_rate;
+  uint8_t output_stop_channels;
+  // DSD と PCM の間では中身を残さない
+  bool output_stop_dsd;
+
+  // 深さの適応
+  // 窓ごとにパケット到着間隔の最小/最大と、DMA 直前の最低水位を記録する
+  uint64_t last_packet_time_us;
+  uint32_t window_min_interval_us;
+  uint32_t window_max_interval_us;
+  float window_min_fill;
+  uint32_t window_underruns;
+  uint64_t window_start_us;
+  bool window_settling;
+  audio_device_depth_stats_t depth_stats;
+
+  // ASRC
+  asrc_t asrc;
+  float asrc_filtered_fill;
+  audio_device_asrc_stats_t asrc_stats;
+  uint32_t asrc_busy_us;
+  uint32_t asrc_busy_frames;
+
+  // S/PDIF 入力 (出力 0 のみ)
+  // 再生中は current_sample_rate が入力のレートになるので、
+  // ホストが設定したレートは usb_sample_rate に別に持つ
+  bool spdif_in_active;
+  uint32_t usb_sample_rate;
+  float slip_filtered_fill;
+  uint32_t spdif_in_slips;
+
+  // ADC の録音 (出力 0 のみ)。再生していない間は capture_clock で I2S を
+  // 無音のまま動かす
+  bool capture_clock;
+
+  // Audio controls - Current states
+  // [0] がマスター、[1] 以降が各チャネル
+  int8_t mute[1 + AUDIO_MAX_CHANNELS];  // 0: unmuted, 1: muted
+  int16_t volume[1 + AUDIO_MAX_CHANNELS];
+} audio_device_t;
+
+// --- Module-level Static Variables ---
+static audio_device_t devices[AUDIO_DEVICE_NUM];
+
+// 全出力で共通の SOF フレーム番号
+static volatile uint16_t last_sof_frame = 0;
+
+static void device_on_rx(audio_device_t *dev, const int32_t *buffer,
+                         uint32_t num_samples);
+static void stream_start(audio_device_t *dev, uint8_t bit_depth,
+                         uint8_t channels);
+static void stream_stop(audio_device_t *dev);
 
 // 事前計算した dB のゲインを 2^31 でスケールした LUT
 // -96dB(16bitオーディオのダイナミックレンジ相当)までサポートする
@@ -71,156 +336,868 @@ static const uint32_t gain_lookup_table[97] = {
     0x80000000,
 };
 
-static uint32_t calc_buffer_size(uint32_t sample_rate) {
-  // sample_rate (kHz) * 2ch * 16ms * 4bytes/sample
-  return sample_rate * 2 * 16 * 4 / 1000;
+static uint32_t calc_buffer_size(uint32_t sample_rate, uint32_t channels,
+                                 uint32_t ms) {
+  // sample_rate (kHz) * channels * ms * 4bytes/sample
+  return sample_rate * channels * ms * 4 / 1000;
+}
+
+// 時間をリングバッファの水位に換算する
+static float level_of_ms(const audio_device_t *dev, float ms) {
+  return ms / dev->ring_ms;
 }
 
 //--------------------------------------------------------------------+/
-// Initialization
+// Fast start
 //--------------------------------------------------------------------+/
-void audio_device_init(void) {
-  g_current_state = STATE_STOPPED;
+static float start_water_level(const audio_device_t *dev) {
+  // 同期開始は各デバイスで同じパケット数を揃えるため、常に SAFE_WATER_LEVEL
+  // S/PDIF 入力はフィードバックで多めに要求できない
+  if (FAST_START && !SYNC_START && !dev->spdif_in_active &&
+      level_of_ms(dev, FAST_START_DEPTH_MS) < SAFE_WATER_LEVEL) {
+    return level_of_ms(dev, FAST_START_DEPTH_MS);
+  }
+  return SAFE_WATER_LEVEL;
+}
 
-  // --- Ring Buffer Init ---
-  memset(&rb, 0, sizeof(ringbuffer_t));
-  ringbuffer_init(&rb, calc_buffer_size(current_sample_rate),
-                  calc_buffer_size(SAMPLE_RATES[N_SAMPLE_RATES - 1]));
+static float underrun_water_level(const audio_device_t *dev) {
+  if (dev->fast_start_filling) {
+    return level_of_ms(dev, (float)dev->i2s_config.buffer_frames * 1000 /
+                                dev->i2s_config.sample_rate);
+  }
+  return UNDERRUN_WATER_LEVEL;
+}
 
-  // --- I2S Config Setup ---
-  i2s_config = (i2s_config_t){
+// I2S 開始時に呼ぶ。最初のブロックは無音で、受信データはその次のブロックから鳴る
+static void record_first_sample(audio_device_t *dev, uint64_t i2s_start_us) {
+  const uint64_t block_us = dev->i2s_config.buffer_frames * 1000000ull /
+                            dev->i2s_config.sample_rate;
+  const uint64_t first_sample_us = i2s_start_us + block_us;
+  dev->start_stats.stream_start_to_first_sample_us =
+      (uint32_t)(first_sample_us - dev->stream_start_time_us);
+  dev->start_stats.first_packet_to_first_sample_us =
+      dev->first_packet_time_us
+          ? (uint32_t)(first_sample_us - dev->first_packet_time_us)
+          : 0;
+  dev->start_stats.output_gap_us =
+      dev->output_stop_time_us
+          ? (uint32_t)(first_sample_us - dev->output_stop_time_us)
+          : 0;
+  dev->start_stats.valid = true;
+}
+
+//--------------------------------------------------------------------+/
+// SOF-aligned synchronized start
+//--------------------------------------------------------------------+/
+// SYNC_START_DELAY_US 経過時のアラーム割り込み
+// アラームは出力ごとに確保しているので、番号から出力を探す
+static void sync_start_alarm_callback(uint alarm_num) {
+  audio_device_t *dev = NULL;
+  for (uint32_t i = 0; i < AUDIO_DEVICE_NUM; ++i) {
+    if (devices[i].sync_alarm_num == (int)alarm_num) {
+      dev = &devices[i];
+    }
+  }
+  if (dev == NULL) {
+    return;
+  }
+  i2s_fire(&dev->i2s_config);
+  uint64_t now = time_us_64();
+  record_first_sample(dev, now);
+
+  uint32_t elapsed = (uint32_t)(now - dev->sync_sof_time_us);
+  dev->sync_start_stats.sof_to_start_us = elapsed;
+  dev->sync_start_stats.start_error_us =
+      (int32_t)elapsed - SYNC_START_DELAY_US;
+  dev->sync_start_stats.valid = true;
+  dev->sync_start_fired = true;
+}
+
+static void sync_packets_clear(audio_device_t *dev) {
+  dev->sync_packets_head = 0;
+  dev->sync_packets_count = 0;
+}
+
+// 最古のパケットをリングバッファから読み捨てる
+static void sync_packets_drop_oldest(audio_device_t *dev) {
+  ringbuffer_skip(&dev->rb, dev->sync_packets[dev->sync_packets_head].bytes);
+  dev->sync_packets_head =
+      (dev->sync_packets_head + 1) % SYNC_START_MAX_PACKETS;
+  --dev->sync_packets_count;
+}
+
+static void sync_packets_push(audio_device_t *dev, uint16_t frame,
+                              uint16_t bytes) {
+  if (dev->sync_packets_count == SYNC_START_MAX_PACKETS) {
+    sync_packets_drop_oldest(dev);
+  }
+  uint32_t tail = (dev->sync_packets_head + dev->sync_packets_count) %
+                  SYNC_START_MAX_PACKETS;
+  dev->sync_packets[tail] = (sync_packet_t){.frame = frame, .bytes = bytes};
+  ++dev->sync_packets_count;
+}
+
+// 開始フレームより SYNC_START_DEPTH_PACKETS 以上古いパケットを捨てる
+// 全台で先頭が同じフレームのパケットになり、サンプル単位で揃う
+static void sync_packets_trim_to(audio_device_t *dev, uint16_t start_frame) {
+  uint16_t oldest = (start_frame - SYNC_START_DEPTH_PACKETS) & 0x7FF;
+  while (dev->sync_packets_count) {
+    uint16_t age =
+        (dev->sync_packets[dev->sync_packets_head].frame - oldest) & 0x7FF;
+    if (age < 0x400) {
+      break;
+    }
+    sync_packets_drop_oldest(dev);
+  }
+}
+
+//--------------------------------------------------------------------+/
+// ASRC
+//--------------------------------------------------------------------+/
+static uint32_t i2s_sample_rate(const audio_device_t *dev) {
+  return ASRC && ASRC_OUTPUT_RATE ? ASRC_OUTPUT_RATE
+                                  : dev->current_sample_rate;
+}
+
+// 176.4/192kHz では MCLK が clk_sys / 2 を超えないよう倍率を半分にする
+static uint16_t mclk_multiplier(const audio_device_t *dev) {
+  return MAX_WIDE_FORMAT_SAMPLE_RATE < i2s_sample_rate(dev)
+             ? I2S_MCLK_MULTIPLIER / 2
+             : I2S_MCLK_MULTIPLIER;
+}
+
+// DMA ブロックのフレーム数。44.1kHz 系では端数を切り捨てる
+static uint32_t block_frames(const audio_device_t *dev) {
+  return (uint32_t)((uint64_t)i2s_sample_rate(dev) * BLOCK_US / 1000000);
+}
+
+// リングバッファから ASRC を通して frames フレームを作る
+static void asrc_read(audio_device_t *dev, int32_t *out, uint32_t frames) {
+  static int32_t in_buf[ASRC_MAX_INPUT_FRAMES * 2];
+  const uint32_t start_us = time_us_32();
+
+  // 水位が目標より高ければ速く、低ければ遅く消費する
+  dev->asrc_filtered_fill =
+      dev->steady_buffer_fill_ratio * ASRC_STEER_LPF_ALPHA +
+      dev->asrc_filtered_fill * (1 - ASRC_STEER_LPF_ALPHA);
+  dev->asrc_stats.ratio_ppb =
+      (int32_t)((dev->asrc_filtered_fill - 0.5f) * ASRC_STEER_GAIN * 1e9f);
+  asrc_set_ratio_adjust(&dev->asrc, dev->asrc_stats.ratio_ppb);
+
+  const uint32_t in_frames = asrc_input_frames(&dev->asrc, frames);
+  const size_t in_bytes = in_frames * sizeof(int32_t) * 2;
+  const size_t read = ringbuffer_read(&dev->rb, (uint8_t *)in_buf, in_bytes);
+  // 不足分は無音で埋める。次のブロックで水位により STALLED へ遷移する
+  memset((uint8_t *)in_buf + read, 0, in_bytes - read);
+  asrc_process(&dev->asrc, in_buf, in_frames, out, frames);
+
+  // 1 秒ごとに 1 フレームあたりのサイクル数を更新
+  dev->asrc_busy_us += time_us_32() - start_us;
+  dev->asrc_busy_frames += frames;
+  if (dev->asrc.output_rate <= dev->asrc_busy_frames) {
+    dev->asrc_stats.cycles_per_frame =
+        (uint32_t)((uint64_t)dev->asrc_busy_us *
+                   (clock_get_hz(clk_sys) / 1000000) / dev->asrc_busy_frames);
+    dev->asrc_busy_us = 0;
+    dev->asrc_busy_frames = 0;
+  }
+}
+
+//--------------------------------------------------------------------+/
+// S/PDIF input
+//--------------------------------------------------------------------+/
+// 入力のクロックは出力と独立なので、ASRC がなければ水位がずれていく
+// ローパスした水位が目標から SPDIF_IN_SLIP_MS 以上離れたら、1 フレーム捨てる (1)
+// か繰り返す (-1)。フィルタ値も 1 フレーム分動かし、続けて滑りすぎないようにする
+static int spdif_in_slip(audio_device_t *dev) {
+  dev->slip_filtered_fill =
+      dev->steady_buffer_fill_ratio * SPDIF_IN_SLIP_LPF_ALPHA +
+      dev->slip_filtered_fill * (1 - SPDIF_IN_SLIP_LPF_ALPHA);
+  const float margin = level_of_ms(dev, SPDIF_IN_SLIP_MS);
+  int slip = 0;
+  if (SAFE_WATER_LEVEL + margin < dev->slip_filtered_fill) {
+    slip = 1;
+  } else if (dev->slip_filtered_fill < SAFE_WATER_LEVEL - margin) {
+    slip = -1;
+  } else {
+    return 0;
+  }
+  dev->slip_filtered_fill -=
+      slip * level_of_ms(dev, 1000.0f / dev->current_sample_rate);
+  ++dev->spdif_in_slips;
+  return slip;
+}
+
+static void spdif_in_stop(audio_device_t *dev) {
+  stream_stop(dev);
+  dev->spdif_in_active = false;
+  dev->current_sample_rate = dev->usb_sample_rate;
+}
+
+// 受信したフレームをリングバッファへ書く。USB のストリームが止まっていて
+// 入力がロックしていれば、入力のレートで再生を始める
+static void spdif_in_task(audio_device_t *dev) {
+  static int32_t rx_buf[SPDIF_IN_CHUNK_FRAMES * 2];
+  uint32_t frames;
+  do {
+    frames = spdif_rx_task(rx_buf, SPDIF_IN_CHUNK_FRAMES);
+    if (dev->spdif_in_active && frames) {
+      device_on_rx(dev, rx_buf, frames * 2);
+    }
+  } while (frames == SPDIF_IN_CHUNK_FRAMES);
+
+  const uint32_t rate = spdif_rx_get_sample_rate();
+  if (dev->spdif_in_active && rate != dev->current_sample_rate) {
+    LOG_INFO("S/PDIF input lost");
+    spdif_in_stop(dev);
+  }
+  // PDM では 88.2/96kHz の入力を再生しない
+  if (rate != 0 && rate <= SAMPLE_RATES[N_SAMPLE_RATES - 1] &&
+      dev->g_current_state == STATE_STOPPED) {
+    LOG_INFO("S/PDIF input locked at %lu Hz", rate);
+    dev->spdif_in_active = true;
+    dev->current_sample_rate = rate;
+    dev->slip_filtered_fill = SAFE_WATER_LEVEL;
+    dev->spdif_in_slips = 0;
+    stream_start(dev, 24, 2);
+  }
+}
+
+//--------------------------------------------------------------------+/
+// Adaptive depth
+//--------------------------------------------------------------------+/
+static void depth_window_reset(audio_device_t *dev, uint64_t now_us) {
+  dev->window_start_us = now_us;
+  dev->window_min_interval_us = UINT32_MAX;
+  dev->window_max_interval_us = 0;
+  dev->window_min_fill = 1.0f;
+  dev->window_underruns = dev->stats.underruns;
+}
+
+// パケット受信ごとに到着間隔を記録する
+static void depth_on_packet(audio_device_t *dev, uint64_t now_us) {
+  if (dev->last_packet_time_us != 0) {
+    const uint32_t interval = (uint32_t)(now_us - dev->last_packet_time_us);
+    if (interval < dev->window_min_interval_us) {
+      dev->window_min_interval_us = interval;
+    }
+    if (dev->window_max_interval_us < interval) {
+      dev->window_max_interval_us = interval;
+    }
+  }
+  dev->last_packet_time_us = now_us;
+}
+
+// 再生中の DMA ブロックごとに呼ぶ。窓が終わるとリングバッファ長を見直す
+static void depth_on_block(audio_device_t *dev, float buffer_level) {
+  if (buffer_level < dev->window_min_fill) {
+    dev->window_min_fill = buffer_level;
+  }
+
+  const uint64_t now = time_us_64();
+  if (now - dev->window_start_us < ADAPTIVE_WINDOW_US ||
+      dev->fast_start_filling) {
+    return;
+  }
+
+  const uint32_t jitter_us =
+      dev->window_max_interval_us < dev->window_min_interval_us
+          ? 0
+          : dev->window_max_interval_us - dev->window_min_interval_us;
+  const float margin_ms =
+      (dev->window_min_fill - UNDERRUN_WATER_LEVEL) * dev->ring_ms;
+  const float required_ms = ADAPTIVE_MARGIN_MS + jitter_us / 1000.0f;
+  dev->depth_stats.jitter_us = jitter_us;
+  dev->depth_stats.min_fill_us =
+      (uint32_t)(dev->window_min_fill * dev->ring_ms * 1000);
+
+  // 伸縮直後の窓は水位がまだ新しい深さへ移行中なので判断しない
+  uint32_t new_ring_ms = dev->ring_ms;
+  if (dev->window_settling) {
+    dev->window_settling = false;
+  } else if (dev->window_underruns != dev->stats.underruns ||
+             margin_ms < required_ms) {
+    new_ring_ms = dev->ring_ms + ADAPTIVE_STEP_RING_MS;
+  } else if (required_ms + ADAPTIVE_SHRINK_HYSTERESIS_MS < margin_ms) {
+    new_ring_ms = dev->ring_ms - ADAPTIVE_STEP_RING_MS;
+  }
+  if (new_ring_ms < ADAPTIVE_MIN_RING_MS) {
+    new_ring_ms = ADAPTIVE_MIN_RING_MS;
+  }
+  if (ADAPTIVE_MAX_RING_MS < new_ring_ms) {
+    new_ring_ms = ADAPTIVE_MAX_RING_MS;
+  }
+
+  // 縮める場合、格納済みデータが収まらなければ次の窓に持ち越す
+  if (new_ring_ms != dev->ring_ms &&
+      ringbuffer_resize_keep(
+          &dev->rb, calc_buffer_size(dev->current_sample_rate,
+                                     dev->current_channels, new_ring_ms)) == 0) {
+    LOG_DEBUG("Ring buffer %lu ms -> %lu ms (jitter %lu us, margin %.2f ms)",
+              dev->ring_ms, new_ring_ms, jitter_us, margin_ms);
+    dev->ring_ms = new_ring_ms;
+    dev->depth_stats.ring_ms = dev->ring_ms;
+    dev->depth_stats.target_depth_us = dev->ring_ms * 1000 * SAFE_WATER_LEVEL;
+    dev->window_settling = true;
+  }
+  depth_window_reset(dev, now);
+}
+
+//--------------------------------------------------------------------+/
+// Underrun concealment
+//--------------------------------------------------------------------+/
+// ブロック全体に直線のゲインをかけて 0 へ、または 0 から戻す
+static void apply_fade(int32_t *buf, uint32_t frames, uint32_t channels,
+                       fade_t dir) {
+  for (uint32_t i = 0; i < frames; ++i) {
+    const int32_t g = (int32_t)(((dir == FADE_OUT ? frames - 1 - i : i + 1)
+                                 << 15) /
+                                frames);
+    for (uint32_t ch = 0; ch < channels; ++ch) {
+      buf[channels * i + ch] =
+          (int32_t)(((int64_t)buf[channels * i + ch] * g) >> 15);
+    }
+  }
+}
+
+//--------------------------------------------------------------------+/
+// I2S output
+//--------------------------------------------------------------------+/
+// ゲインをかけたサンプルを I2S バッファの形式に変換する
+// 右詰めではサンプルを右シフト (符号拡張) してスロット末尾に揃える
+// 16bit の場合は 1 ワードに L (上位) と R (下位) を詰めて DMA 転送量を半分にする
+// TDM ではチャネル順にスロットへ書き、残りは i2s_arm() でクリアされた無音のまま
+// 複数のデータ線ではビット単位でインターリーブする
+static void write_i2s_block(const audio_device_t *dev, int32_t *samples,
+                            uint32_t frames, uint32_t channels,
+                            int32_t *i2s_buf) {
+  const uint32_t shift = i2s_get_sample_shift(&dev->i2s_config);
+  if (shift) {
+    for (uint32_t i = 0; i < frames * channels; ++i) {
+      samples[i] >>= shift;
+    }
+  }
+
+  const uint32_t words_per_frame = i2s_get_words_per_frame(&dev->i2s_config);
+  if (1 < dev->i2s_config.data_lines) {
+    sample_format_pack_lines(samples, frames, channels,
+                             dev->i2s_config.data_lines, (uint32_t *)i2s_buf);
+  } else if (words_per_frame == 1) {
+    for (uint32_t i = 0; i < frames; ++i) {
+      i2s_buf[i] = (int32_t)(((uint32_t)samples[i * channels] & 0xFFFF0000) |
+                             ((uint32_t)samples[i * channels + 1] >> 16));
+    }
+  } else {
+    const uint32_t slots =
+        channels < words_per_frame ? channels : words_per_frame;
+    for (uint32_t i = 0; i < frames; ++i) {
+      for (uint32_t ch = 0; ch < slots; ++ch) {
+        i2s_buf[words_per_frame * i + ch] = samples[i * channels + ch];
+      }
+    }
+  }
+}
+
+//--------------------------------------------------------------------+/
+// CPU load
+//--------------------------------------------------------------------+/
+// ブロック処理の終わりに呼ぶ。DMA 割り込み自体の時間は含まない
+static void cpu_on_block(audio_device_t *dev, uint32_t start_us) {
+  const uint64_t now = time_us_64();
+  dev->cpu_busy_us += (uint32_t)now - start_us;
+  ++dev->cpu_busy_blocks;
+  if (dev->cpu_window_start_us == 0) {
+    dev->cpu_window_start_us = now;
+  } else if (CPU_WINDOW_US <= now - dev->cpu_window_start_us) {
+    const uint32_t sys_hz = clock_get_hz(clk_sys);
+    dev->cpu_stats.cycles_per_block =
+        (uint32_t)((uint64_t)dev->cpu_busy_us * (sys_hz / 1000000) /
+                   dev->cpu_busy_blocks);
+    // 1 フレーム周期のサイクル数から、ブロック処理で使った分を引いた余裕
+    const uint32_t budget = sys_hz / dev->i2s_config.sample_rate;
+    const uint32_t used =
+        dev->cpu_stats.cycles_per_block / dev->i2s_config.buffer_frames;
+    dev->cpu_stats.sample_rate = dev->i2s_config.sample_rate;
+    dev->cpu_stats.spare_cycles_per_frame = used < budget ? budget - used : 0;
+    dev->cpu_stats.load_permille = (uint16_t)((uint64_t)dev->cpu_busy_us *
+                                              1000 /
+                                              (now - dev->cpu_window_start_us));
+    dev->cpu_window_start_us = now;
+    dev->cpu_busy_us = 0;
+    dev->cpu_busy_blocks = 0;
+  }
+}
+
+//--------------------------------------------------------------------+/
+// Output instances
+//--------------------------------------------------------------------+/
+static audio_device_t *device(uint8_t id) {
+  assert(id < AUDIO_DEVICE_NUM);
+  return &devices[id];
+}
+
+// LED は出力 0 の状態を表す
+static void device_blink_period(const audio_device_t *dev, uint32_t us) {
+  if (dev->id == 0) {
+    blink_set_period_us(us);
+  }
+}
+
+static void device_led_on(const audio_device_t *dev) {
+  if (dev->id == 0) {
+    blink_led_on();
+  }
+}
+
+// 出力 1 は pio1 を使うマスターモードの 1 データ線ステレオ出力 (S/PDIF なし)
+// フォーマット (I2S/左詰め/右詰め/TDM) と MCLK 倍率は出力 0 と共通
+static i2s_config_t device_i2s_config(const audio_device_t *dev) {
+  i2s_config_t config = {
       .data_pin = I2S_DATA_PIN,
       .clock_pin_base = I2S_CLOCK_PIN_BASE,
       .pio_instance = PIO,
-      .bit_depth = current_bit_depth,
-      .buffer_frames = current_sample_rate / 1000,
-      .sample_rate = current_sample_rate,
+      .bit_depth = dev->current_bit_depth,
+      .buffer_frames = block_frames(dev),
+      .dma_blocks = DMA_BLOCKS,
+      .sample_rate = i2s_sample_rate(dev),
+      .clock_mode = I2S_CLOCK_MODE,
+      .mclk_multiplier = mclk_multiplier(dev),
+      .mclk_pin = I2S_MCLK_PIN,
+      .data_lines = I2S_DATA_LINES,
+      .format = I2S_FORMAT,
+      .tdm_slots = I2S_TDM_SLOTS,
+      .spdif = SPDIF,
+      .spdif_pin = SPDIF_PIN,
+      .pdm = PDM,
+      .pdm_pin = PDM_PIN,
+      .capture = ADC,
+      .capture_pin = ADC_DATA_PIN,
   };
+  if (dev->id == 1) {
+    config.data_pin = I2S2_DATA_PIN;
+    config.clock_pin_base = I2S2_CLOCK_PIN_BASE;
+    config.pio_instance = PIO2;
+    config.clock_mode = I2S_CLOCK_MASTER;
+    config.mclk_pin = I2S2_MCLK_PIN;
+    config.data_lines = 1;
+    config.spdif = I2S_SPDIF_OFF;
+    config.pdm = false;
+    config.capture = false;
+  }
+  return config;
+}
+
+//--------------------------------------------------------------------+/
+// Initialization
+//--------------------------------------------------------------------+/
+static void device_init(audio_device_t *dev, uint8_t id) {
+  memset(dev, 0, sizeof(*dev));
+  dev->id = id;
+  dev->g_current_state = STATE_STOPPED;
+  dev->current_sample_rate = 48000;
+  dev->usb_sample_rate = 48000;
+  dev->current_bit_depth = 16;
+  dev->current_channels = 2;
+  dev->fade = FADE_NONE;
+  dev->sync_alarm_num = -1;
+  dev->window_min_interval_us = UINT32_MAX;
+  dev->window_min_fill = 1.0f;
+  dev->asrc_filtered_fill = 0.5f;
+  for (uint32_t ch = 0; ch <= AUDIO_MAX_CHANNELS; ++ch) {
+    dev->volume[ch] = VOLUME_CTRL_0_DB;
+  }
+
+  // --- Ring Buffer Init ---
+  dev->ring_ms = RING_MS;
+  // 最大の容量はステレオの最高レートか、最大チャンネル数の 48kHz の大きい方
+  // 出力 1 はステレオのみ
+  const uint32_t max_ring_ms = ADAPTIVE_DEPTH ? ADAPTIVE_MAX_RING_MS : RING_MS;
+  const uint32_t max_stereo_size =
+      calc_buffer_size(SAMPLE_RATES[N_SAMPLE_RATES - 1], 2, max_ring_ms);
+  const uint32_t max_multichannel_size =
+      id == 0 ? calc_buffer_size(MAX_MULTICHANNEL_SAMPLE_RATE,
+                                 AUDIO_MAX_CHANNELS, max_ring_ms)
+              : 0;
+  ringbuffer_init(&dev->rb,
+                  calc_buffer_size(dev->current_sample_rate,
+                                   dev->current_channels, dev->ring_ms),
+                  max_stereo_size < max_multichannel_size
+                      ? max_multichannel_size
+                      : max_stereo_size);
+  dev->depth_stats.adaptive = ADAPTIVE_DEPTH;
+  dev->depth_stats.ring_ms = dev->ring_ms;
+  dev->depth_stats.target_depth_us = dev->ring_ms * 1000 * SAFE_WATER_LEVEL;
+  dev->cpu_stats.block_us = BLOCK_US;
+
+  // --- I2S Config Setup ---
+  dev->i2s_config = device_i2s_config(dev);
 
   // Initial setup of I2S hardware
-  i2s_init(&i2s_config);
+  i2s_init(&dev->i2s_config);
+
+  if (SYNC_START) {
+    dev->sync_alarm_num = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(dev->sync_alarm_num,
+                                sync_start_alarm_callback);
+  }
+}
+
+void audio_device_init(void) {
+  for (uint8_t id = 0; id < AUDIO_DEVICE_NUM; ++id) {
+    device_init(&devices[id], id);
+  }
+
+  if (CLOCK_MONITOR) {
+    clock_monitor_init(PIO, I2S_CLOCK_PIN_BASE + 1);
+  }
+  if (SPDIF_IN) {
+    spdif_rx_init(SPDIF_IN_PIO, SPDIF_IN_PIN);
+  }
   // i2s_start(&i2s_config);
   blink_set_period_us(1000000);
 }
 
+//--------------------------------------------------------------------+/
+// DSD
+//--------------------------------------------------------------------+/
+// 1 フレームは 2 ワード (i2s_get_words_per_frame())
+static void fill_dsd_silence(uint32_t *words, uint32_t count) {
+  for (uint32_t i = 0; i < count; ++i) {
+    words[i] = SAMPLE_FORMAT_DSD_SILENCE;
+  }
+}
+
+//--------------------------------------------------------------------+/
+// ADC capture
+//--------------------------------------------------------------------+/
+// 録音中で出力 0 が再生していなければ、無音を出して I2S のクロックだけを動かす
+// 再生が始まると stream_start() がこれを止め、再生の設定で開始し直す
+static void capture_task(audio_device_t *dev) {
+  if (!capture_is_active() || dev->capture_clock ||
+      dev->g_current_state != STATE_STOPPED) {
+    return;
+  }
+  LOG_DEBUG("Starting I2S clocks for capture at %lu Hz",
+            dev->current_sample_rate);
+  dev->i2s_config.bit_depth = CAPTURE_CLOCK_BIT_DEPTH;
+  dev->i2s_config.buffer_frames = block_frames(dev);
+  dev->i2s_config.sample_rate = i2s_sample_rate(dev);
+  dev->i2s_config.mclk_multiplier = mclk_multiplier(dev);
+  i2s_reconfigure(&dev->i2s_config);
+  // DMA ブロックは i2s_arm() で無音になっているので書き込まなくてよい
+  i2s_start(&dev->i2s_config);
+  i2s_mute(&dev->i2s_config);
+  dev->capture_clock = true;
+}
+
+// パケットの長さ、深さの維持、詰める処理は capture.c が受け持つ
+void audio_device_capture_start(uint8_t bit_depth) {
+  audio_device_t *dev = device(0);
+  assert(ADC);
+  capture_start(&dev->i2s_config, bit_depth);
+  capture_task(dev);
+}
+
+void audio_device_capture_stop(void) {
+  audio_device_t *dev = device(0);
+  capture_stop();
+  if (dev->capture_clock) {
+    i2s_stop(&dev->i2s_config);
+    dev->capture_clock = false;
+  }
+}
+
+uint16_t audio_device_capture_fill(uint8_t *dst, uint16_t max_bytes) {
+  return capture_fill(dst, max_bytes);
+}
+
+void audio_device_get_capture_stats(audio_device_capture_stats_t *stats) {
+  capture_stats_t cap;
+  capture_get_stats(&cap);
+  stats->active = cap.active;
+  stats->clock_only = device(0)->capture_clock;
+  stats->bit_depth = cap.bit_depth;
+  stats->load_permille = cap.load_permille;
+  stats->cycles_per_packet = cap.cycles_per_packet;
+  stats->depth_us = cap.depth_us;
+  stats->slips = cap.slips;
+  stats->empty_packets = cap.empty_packets;
+}
+
 //--------------------------------------------------------------------+/
 // Main loop tasks
 //--------------------------------------------------------------------+/
-// This is the equivalent of i2s_task() in main.c
-void audio_device_task(void) {
-  switch (g_current_state) {
+static bool rate_matches(uint32_t frames_per_ms_q16, uint32_t freq) {
+  // 16.16 の frames/ms と Hz を 2^16 倍の Hz で比べる
+  const uint64_t measured = (uint64_t)frames_per_ms_q16 * 1000;
+  const uint64_t nominal = (uint64_t)freq << 16;
+  const uint64_t diff =
+      measured < nominal ? nominal - measured : measured - nominal;
+  return diff * 1000000 <= nominal * RATE_MISMATCH_PPM;
+}
+
+// 外部クロックがホストの選んだレートで動いていなければストリームを止める
+// 以後の同じレートの選択は USB 側で拒否される
+static bool rate_mismatch(audio_device_t *dev) {
+  if (dev->i2s_config.clock_mode != I2S_CLOCK_SLAVE || ASRC ||
+      dev->spdif_in_active || !dev->measured_rate_valid ||
+      rate_matches(dev->measured_rate_q16, dev->current_sample_rate)) {
+    return false;
+  }
+  LOG_ERROR("External clock runs at %lu Hz, stream is %lu Hz. Stopping.",
+            (unsigned long)(((uint64_t)dev->measured_rate_q16 * 1000) >> 16),
+            (unsigned long)dev->current_sample_rate);
+  stream_stop(dev);
+  return true;
+}
+
+static void device_task(audio_device_t *dev) {
+  switch (dev->g_current_state) {
     case STATE_STOPPED:
       // Not playing, nothing to do
       break;
 
     case STATE_BUFFERING:
       // Buffering, wait for buffer to be sufficiently full
-      if (SAFE_WATER_LEVEL <= ringbuffer_fill_ratio(&rb)) {
-        LOG_DEBUG("Buffer reached safe level. Starting I2S playback....");
-        i2s_start(&i2s_config);
-        i2s_unmute();
-        g_current_state = STATE_PLAYING;
-        blink_led_on();
+      if (start_water_level(dev) <= ringbuffer_fill_ratio(&dev->rb)) {
+        if (SYNC_START && !dev->spdif_in_active) {
+          LOG_DEBUG("Buffer reached safe level. Waiting for sync start SOF.");
+          i2s_arm(&dev->i2s_config);
+          // 既存のデータは 1 パケットとして扱い、新しいパケットで押し出す
+          sync_packets_clear(dev);
+          sync_packets_push(dev, (last_sof_frame - 1) & 0x7FF,
+                            ringbuffer_count(&dev->rb));
+          dev->sync_start_fired = false;
+          dev->g_current_state = STATE_ARMED;
+          break;
+        }
+        LOG_DEBUG("Buffer reached start level. Starting I2S playback....");
+        i2s_start(&dev->i2s_config);
+        record_first_sample(dev, time_us_64());
+        i2s_unmute(&dev->i2s_config);
+        dev->fast_start_filling = start_water_level(dev) < SAFE_WATER_LEVEL;
+        dev->g_current_state = STATE_PLAYING;
+        device_led_on(dev);
+      }
+      break;
+
+    case STATE_ARMED:
+      // アラーム割り込みで I2S が開始されるのを待つ
+      if (dev->sync_start_fired) {
+        sync_packets_trim_to(dev, dev->sync_start_stats.start_frame);
+        LOG_INFO("Sync start at frame %u: %u us after SOF (error %d us)",
+                 dev->sync_start_stats.start_frame,
+                 dev->sync_start_stats.sof_to_start_us,
+                 dev->sync_start_stats.start_error_us);
+        dev->g_current_state = STATE_PLAYING;
+        device_led_on(dev);
       }
       break;
 
     case STATE_STALLED:
+      if (rate_mismatch(dev)) {
+        break;
+      }
       // Stalled, wait for buffer to recover
-      if (RECOVERY_WATER_LEVEL <= ringbuffer_fill_ratio(&rb)) {
+      if (RECOVERY_WATER_LEVEL <= ringbuffer_fill_ratio(&dev->rb)) {
         LOG_DEBUG("Buffer recovered. Resuming playback.");
-        g_current_state = STATE_PLAYING;
-        blink_led_on();
+        dev->underrun_stats.last_duration_us =
+            (uint32_t)(time_us_64() - dev->underrun_start_us);
+        dev->underrun_stats.last_concealed_frames =
+            dev->underrun_concealed_frames;
+        dev->fade = FADE_IN;
+        dev->g_current_state = STATE_PLAYING;
+        device_led_on(dev);
       } else {
         // Keep feeding silence while stalled
-        if (i2s_is_buffer_ready()) {
-          int32_t *i2s_buf = i2s_get_write_buffer();
+        // S/PDIF の無音はプリアンブルとチャネルステータスを含めて符号化する
+        // PDM の無音もコア 1 で変調し、ループの状態を途切れさせない
+        if (i2s_is_buffer_ready(&dev->i2s_config)) {
+          int32_t *i2s_buf = i2s_get_write_buffer(&dev->i2s_config);
           const uint32_t i2s_buf_size_frames =
-              i2s_get_buffer_size_frames(&i2s_config);
-          memset(i2s_buf, 0, i2s_buf_size_frames * sizeof(int32_t) * 2);
+              i2s_get_buffer_size_frames(&dev->i2s_config);
+          if (dev->i2s_config.dsd) {
+            fill_dsd_silence((uint32_t *)i2s_buf,
+                             i2s_buf_size_frames *
+                                 i2s_get_words_per_frame(&dev->i2s_config));
+          } else if (dev->i2s_config.pdm) {
+            i2s_write_pdm(&dev->i2s_config, NULL, 0);
+          } else if (dev->i2s_config.spdif != I2S_SPDIF_ONLY) {
+            memset(i2s_buf, 0,
+                   i2s_buf_size_frames * sizeof(int32_t) *
+                       i2s_get_words_per_frame(&dev->i2s_config));
+          }
+          if (dev->i2s_config.spdif != I2S_SPDIF_OFF) {
+            i2s_write_spdif(&dev->i2s_config, NULL, 0);
+          }
+          dev->underrun_concealed_frames += i2s_buf_size_frames;
+          dev->underrun_stats.concealed_frames += i2s_buf_size_frames;
         }
       }
       break;
 
     case STATE_PLAYING:
+      if (rate_mismatch(dev)) {
+        break;
+      }
       // Playing, keep feeding I2S buffer
-      if (i2s_is_buffer_ready()) {
-        int32_t *i2s_buf = i2s_get_write_buffer();
+      if (i2s_is_buffer_ready(&dev->i2s_config)) {
+        const uint32_t start_us = time_us_32();
+        int32_t *i2s_buf = i2s_get_write_buffer(&dev->i2s_config);
         const uint32_t i2s_buf_size_frames =
-            i2s_get_buffer_size_frames(&i2s_config);
+            i2s_get_buffer_size_frames(&dev->i2s_config);
+        const uint32_t channels = dev->current_channels;
         const uint32_t bytes_to_read =
-            i2s_buf_size_frames * sizeof(int32_t) * 2;
+            i2s_buf_size_frames * sizeof(int32_t) * channels;
 
         // Check for underrun
-        float buffer_level = steady_buffer_fill_ratio =
-            ringbuffer_fill_ratio(&rb);
-        if (buffer_level <= UNDERRUN_WATER_LEVEL) {
+        float buffer_level = dev->steady_buffer_fill_ratio =
+            ringbuffer_fill_ratio(&dev->rb);
+        if (dev->fast_start_filling &&
+            (SAFE_WATER_LEVEL <= buffer_level ||
+             FAST_START_MAX_FILL_US <
+                 time_us_64() - dev->stream_start_time_us)) {
+          dev->fast_start_filling = false;
+        }
+        if (ADAPTIVE_DEPTH) {
+          depth_on_block(dev, buffer_level);
+        }
+        if (buffer_level <= underrun_water_level(dev)) {
           // Underrun: change state to STALLED
+          // 残っている音声でこのブロックをフェードアウトし、次から無音にする
           LOG_DEBUG("Underrun! Ratio: %.2f. Entering STALLED state.",
                     buffer_level);
-          g_current_state = STATE_STALLED;
-          blink_set_period_us(250000);
-          // Feed silence once to avoid noise
-          memset(i2s_buf, 0, i2s_buf_size_frames * sizeof(int32_t) * 2);
+          ++dev->stats.underruns;
+          dev->fast_start_filling = false;
+          dev->fade = FADE_OUT;
+          dev->underrun_start_us = time_us_64();
+          dev->underrun_concealed_frames = 0;
+          dev->g_current_state = STATE_STALLED;
+          device_blink_period(dev, 250000);
+        }
+        // 最大サイズは 192kHz のステレオ (= 48kHz の 8ch)、1ms バッファで
+        // 決め打ちして計算。仮定が成立しない場合は assert で検知する
+        // 出力はメインループで順に処理するため、作業領域は共有する
+        static int32_t temp_buf[192 * 2];
+        assert(bytes_to_read <= sizeof(temp_buf));
+        if (ASRC) {
+          asrc_read(dev, temp_buf, i2s_buf_size_frames);
         } else {
-          // 最大サイズは 96kHz、1ms バッファで決め打ちして計算
-          // 仮定が成立しない場合は assert で検知する
-          static int32_t temp_buf[96 * 2];
-          assert(bytes_to_read <= sizeof(temp_buf));
-          ringbuffer_read(&rb, (uint8_t *)temp_buf, bytes_to_read);
-
-          // Get gain values for left, right, and master channels
-          int16_t left_gain_db = volume[1] / 256;
-          int16_t left_gain_idx = left_gain_db + 96;
-          uint32_t left_gain_scaled = gain_lookup_table[left_gain_idx];
-
-          int16_t right_gain_db = volume[2] / 256;
-          int16_t right_gain_idx = right_gain_db + 96;
-          uint32_t right_gain_scaled = gain_lookup_table[right_gain_idx];
-
-          int16_t master_gain_db = volume[0] / 256;
-          int16_t master_gain_idx = master_gain_db + 96;
-          uint32_t master_gain_scaled = gain_lookup_table[master_gain_idx];
-
-          // Pre-calculate effective mute states
-          bool effective_left_mute = mute[0] || mute[1];
-          bool effective_right_mute = mute[0] || mute[2];
-
-          // Apply mute by setting gain to 0 if muted
-          if (effective_left_mute) {
-            left_gain_scaled = 0;
+          const size_t frame_bytes = sizeof(int32_t) * channels;
+          const int slip = dev->spdif_in_active ? spdif_in_slip(dev) : 0;
+          if (slip == 1) {
+            ringbuffer_skip(&dev->rb, frame_bytes);
           }
-          if (effective_right_mute) {
-            right_gain_scaled = 0;
+          // 繰り返す時は 1 フレーム少なく読み、最後のフレームを複製する
+          const size_t want =
+              slip == -1 ? bytes_to_read - frame_bytes : bytes_to_read;
+          // 高速開始中のアンダーラン判定は 1 ブロック未満なので、不足分は無音
+          // DSD の 0 は負のフルスケールなので、無音のパターンで埋める
+          const size_t read =
+              ringbuffer_read(&dev->rb, (uint8_t *)temp_buf, want);
+          memset((uint8_t *)temp_buf + read,
+                 dev->i2s_config.dsd ? (SAMPLE_FORMAT_DSD_IDLE & 0xFF) : 0,
+                 want - read);
+          if (slip == -1) {
+            memcpy((uint8_t *)temp_buf + want,
+                   (uint8_t *)temp_buf + want - frame_bytes, frame_bytes);
           }
+        }
 
-          // Apply gain
-          for (uint32_t i = 0; i < i2s_buf_size_frames; ++i) {
-            int64_t left = (int64_t)temp_buf[i * 2];
-            int64_t right = (int64_t)temp_buf[i * 2 + 1];
+        // DSD のビット列にはフェードもゲインもかけられない
+        // ミュートはマスターか L/R のどれかで DSD の無音にする
+        if (dev->i2s_config.dsd) {
+          if (dev->mute[0] || dev->mute[1] || dev->mute[2]) {
+            fill_dsd_silence((uint32_t *)i2s_buf, i2s_buf_size_frames *
+                                                      i2s_get_words_per_frame(
+                                                          &dev->i2s_config));
+          } else {
+            sample_format_pack_dsd(temp_buf, i2s_buf_size_frames,
+                                   (uint32_t *)i2s_buf);
+          }
+          dev->fade = FADE_NONE;
+          cpu_on_block(dev, start_us);
+          break;
+        }
 
-            left = (left * left_gain_scaled) >> 31;
-            left = (left * master_gain_scaled) >> 31;
+        // フェードとゲインはどちらも線形なので、先にフェードをかけておく
+        if (dev->fade != FADE_NONE) {
+          apply_fade(temp_buf, i2s_buf_size_frames, channels, dev->fade);
+          dev->fade = FADE_NONE;
+        }
 
-            right = (right * right_gain_scaled) >> 31;
-            right = (right * master_gain_scaled) >> 31;
+        // Get gain values for each channel and the master
+        // マスターとチャネルのミュートはどちらもゲイン 0 にする
+        const uint32_t master_gain_scaled =
+            dev->mute[0] ? 0 : gain_lookup_table[dev->volume[0] / 256 + 96];
+        uint32_t gain_scaled[AUDIO_MAX_CHANNELS];
+        for (uint32_t ch = 0; ch < channels; ++ch) {
+          gain_scaled[ch] =
+              dev->mute[ch + 1]
+                  ? 0
+                  : gain_lookup_table[dev->volume[ch + 1] / 256 + 96];
+        }
 
-            // Convert back to int32_t for I2S buffer
-            i2s_buf[2 * i] = (int32_t)left;
-            i2s_buf[2 * i + 1] = (int32_t)right;
+        // Apply gain
+        for (uint32_t i = 0; i < i2s_buf_size_frames; ++i) {
+          for (uint32_t ch = 0; ch < channels; ++ch) {
+            int64_t sample = (int64_t)temp_buf[i * channels + ch];
+            sample = (sample * gain_scaled[ch]) >> 31;
+            sample = (sample * master_gain_scaled) >> 31;
+            temp_buf[i * channels + ch] = (int32_t)sample;
           }
         }
+
+        // S/PDIF は左詰めのサンプルから符号化する
+        if (dev->i2s_config.spdif != I2S_SPDIF_OFF) {
+          i2s_write_spdif(&dev->i2s_config, temp_buf, channels);
+        }
+        if (dev->i2s_config.pdm) {
+          i2s_write_pdm(&dev->i2s_config, temp_buf, channels);
+        } else if (dev->i2s_config.spdif != I2S_SPDIF_ONLY) {
+          write_i2s_block(dev, temp_buf, i2s_buf_size_frames, channels,
+                          i2s_buf);
+        }
+        cpu_on_block(dev, start_us);
       }
       break;
   }
 }
 
+// This is the equivalent of i2s_task() in main.c
+void audio_device_task(void) {
+  if (CLOCK_MONITOR) {
+    clock_monitor_task();
+  }
+  if (SPDIF_IN) {
+    spdif_in_task(&devices[0]);
+  }
+  if (ADC) {
+    capture_task(&devices[0]);
+  }
+
+  for (uint32_t i = 0; i < AUDIO_DEVICE_NUM; ++i) {
+    device_task(&devices[i]);
+  }
+}
+
 //--------------------------------------------------------------------+/
 // Data flow
 //--------------------------------------------------------------------+/
 // This is the equivalent of the logic inside audio_task() in main.c
-void audio_device_on_usb_rx(const int32_t *buffer, uint32_t num_samples) {
+static void device_on_rx(audio_device_t *dev, const int32_t *buffer,
+                         uint32_t num_samples) {
+  const uint64_t now = time_us_64();
+  if (dev->g_current_state == STATE_BUFFERING &&
+      dev->first_packet_time_us == 0) {
+    dev->first_packet_time_us = now;
+  }
+  if (ADAPTIVE_DEPTH) {
+    depth_on_packet(dev, now);
+  }
+
   uint32_t bytes = num_samples * sizeof(int32_t);
-  size_t written = ringbuffer_write(&rb, (void *)buffer, bytes);
+  size_t written = ringbuffer_write(&dev->rb, (void *)buffer, bytes);
   if (written != bytes) {
     // TODO
     // リングバッファに書き込めない場合、本来は再生に追いつくために
@@ -230,85 +1207,368 @@ void audio_device_on_usb_rx(const int32_t *buffer, uint32_t num_samples) {
     // INFO だとログ出力による遅延で正のフィードバックがかかり
     // 問題が悪化する可能性が高いため DEBUG とする
     LOG_DEBUG("bytes: %d, but written: %d", bytes, written);
+    ++dev->stats.overruns;
+    dev->stats.overrun_bytes += bytes - written;
+  }
+
+  if (dev->g_current_state == STATE_ARMED && !dev->sync_start_fired) {
+    sync_packets_push(dev, last_sof_frame, written);
+    while (SYNC_START_DEPTH_PACKETS < dev->sync_packets_count) {
+      sync_packets_drop_oldest(dev);
+    }
   }
 
   // バッファレベルの測定
   // 再生中は DMA 直前に測る
-  if (g_current_state != STATE_PLAYING) {
-    steady_buffer_fill_ratio = ringbuffer_fill_ratio(&rb);
+  if (dev->g_current_state != STATE_PLAYING) {
+    dev->steady_buffer_fill_ratio = ringbuffer_fill_ratio(&dev->rb);
   }
 }
 
-float audio_device_get_steady_buffer_fill_ratio() {
-  return steady_buffer_fill_ratio;
+void audio_device_on_usb_rx(uint8_t id, const int32_t *buffer,
+                            uint32_t num_samples) {
+  audio_device_t *dev = device(id);
+  // S/PDIF 入力の再生中は、ホストがストリームを始めるまで捨てる
+  if (dev->spdif_in_active) {
+    return;
+  }
+  device_on_rx(dev, buffer, num_samples);
 }
 
-bool audio_device_is_playing() { return g_current_state == STATE_PLAYING; }
+float audio_device_get_steady_buffer_fill_ratio(uint8_t id) {
+  return device(id)->steady_buffer_fill_ratio;
+}
+
+bool audio_device_is_playing(uint8_t id) {
+  return device(id)->g_current_state == STATE_PLAYING;
+}
+
+// I2S が消費したフレーム数 (= LRCLK 周期数) を SOF 間隔で数え、実レートを求める
+static void device_on_usb_sof(audio_device_t *dev, uint16_t frame_number) {
+  // 直近 SYNC_START_DEPTH_PACKETS パケットが揃ってから、
+  // 区切りのよいフレーム番号で開始を予約する
+  if (dev->g_current_state == STATE_ARMED && dev->sync_alarm_num >= 0 &&
+      !dev->sync_start_fired && dev->sync_sof_time_us == 0 &&
+      SYNC_START_DEPTH_PACKETS <= dev->sync_packets_count &&
+      frame_number % SYNC_START_FRAME_INTERVAL == 0) {
+    uint64_t now = time_us_64();
+    dev->sync_sof_time_us = now;
+    dev->sync_start_stats.start_frame = frame_number;
+    hardware_alarm_set_target(dev->sync_alarm_num,
+                              from_us_since_boot(now + SYNC_START_DELAY_US));
+  }
+
+  if (dev->g_current_state != STATE_PLAYING &&
+      dev->g_current_state != STATE_STALLED) {
+    dev->rate_window_started = false;
+    dev->measured_rate_valid = false;
+    return;
+  }
+
+  uint32_t frames = i2s_get_frames_played(&dev->i2s_config);
+  if (!dev->rate_window_started) {
+    dev->rate_window_started = true;
+    dev->rate_window_start_frames = frames;
+    dev->rate_sof_count = 0;
+    return;
+  }
+
+  if (++dev->rate_sof_count == (1u << RATE_WINDOW_SOF_LOG2)) {
+    dev->measured_rate_q16 = (frames - dev->rate_window_start_frames)
+                             << (16 - RATE_WINDOW_SOF_LOG2);
+    dev->measured_rate_valid = true;
+    dev->external_rate_q16 = dev->measured_rate_q16;
+    dev->external_rate_known = true;
+    dev->rate_window_start_frames = frames;
+    dev->rate_sof_count = 0;
+  }
+}
+
+// USB SOF 割り込みから呼ばれる
+void audio_device_on_usb_sof(uint16_t frame_number) {
+  last_sof_frame = frame_number;
+  for (uint32_t i = 0; i < AUDIO_DEVICE_NUM; ++i) {
+    device_on_usb_sof(&devices[i], frame_number);
+  }
+}
+
+void audio_device_get_stats(uint8_t id, audio_device_stats_t *s) {
+  *s = device(id)->stats;
+}
+
+void audio_device_get_sync_start_stats(
+    uint8_t id, audio_device_sync_start_stats_t *stats) {
+  *stats = device(id)->sync_start_stats;
+}
+
+bool audio_device_get_measured_rate(uint8_t id, uint32_t *frames_per_ms_q16) {
+  const audio_device_t *dev = device(id);
+  // マスターモードでは I2S クロックは公称値から導出されるため測定しない
+  // ASRC 使用時の I2S レートは USB のレートと無関係
+  if (dev->i2s_config.clock_mode != I2S_CLOCK_SLAVE ||
+      !dev->measured_rate_valid || ASRC) {
+    return false;
+  }
+  *frames_per_ms_q16 = dev->measured_rate_q16;
+  return true;
+}
+
+bool audio_device_is_rate_playable(uint8_t id, uint32_t freq) {
+  const audio_device_t *dev = device(id);
+  // 外部クロックのレートが分かるまでは受け入れ、最初の再生で測る
+  if (dev->i2s_config.clock_mode != I2S_CLOCK_SLAVE ||
+      !dev->external_rate_known || ASRC) {
+    return true;
+  }
+  return rate_matches(dev->external_rate_q16, freq);
+}
+
+float audio_device_get_rate_boost(uint8_t id) {
+  return device(id)->fast_start_filling ? FAST_START_RATE_BOOST : 0.0f;
+}
+
+void audio_device_get_start_stats(uint8_t id,
+                                  audio_device_start_stats_t *stats) {
+  *stats = device(id)->start_stats;
+}
+
+void audio_device_get_depth_stats(uint8_t id,
+                                  audio_device_depth_stats_t *stats) {
+  *stats = device(id)->depth_stats;
+}
+
+void audio_device_get_underrun_stats(uint8_t id,
+                                     audio_device_underrun_stats_t *stats) {
+  *stats = device(id)->underrun_stats;
+}
+
+void audio_device_get_hw_underrun_stats(uint8_t id,
+                                        i2s_underrun_stats_t *stats) {
+  i2s_get_underrun_stats(&device(id)->i2s_config, stats);
+}
+
+void audio_device_get_cpu_stats(uint8_t id, audio_device_cpu_stats_t *stats) {
+  *stats = device(id)->cpu_stats;
+}
+
+// 各出力の負荷は 1 秒窓の値なので、再生中の出力だけを足す
+uint16_t audio_device_get_total_load_permille(void) {
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < AUDIO_DEVICE_NUM; ++i) {
+    const app_state_t state = devices[i].g_current_state;
+    if (state == STATE_PLAYING || state == STATE_STALLED) {
+      total += devices[i].cpu_stats.load_permille;
+    }
+  }
+  // 録音は再生と同じコア 0 の USB 処理で詰める
+  if (ADC && capture_is_active()) {
+    capture_stats_t cap;
+    capture_get_stats(&cap);
+    total += cap.load_permille;
+  }
+  return (uint16_t)total;
+}
+
+bool audio_device_uses_asrc(void) { return ASRC; }
+
+void audio_device_get_asrc_stats(uint8_t id,
+                                 audio_device_asrc_stats_t *stats) {
+  *stats = device(id)->asrc_stats;
+}
+
+void audio_device_get_spdif_in_stats(audio_device_spdif_in_stats_t *stats) {
+  const audio_device_t *dev = device(0);
+  spdif_rx_stats_t rx;
+  spdif_rx_get_stats(&rx);
+  stats->locked = rx.locked;
+  stats->playing = dev->spdif_in_active;
+  stats->sample_rate = rx.sample_rate;
+  stats->bad_subframes = rx.bad_subframes;
+  stats->slips = dev->spdif_in_slips;
+}
+
+void audio_device_get_pdm_stats(i2s_pdm_stats_t *stats) {
+  i2s_get_pdm_stats(&device(0)->i2s_config, stats);
+}
 
 //--------------------------------------------------------------------+/
 // Audio Stream State Control
 //--------------------------------------------------------------------+/
-void audio_device_stream_start(uint8_t bit_depth) {
-  LOG_INFO("Starting stream with %d bits, %lu Hz", bit_depth,
-           current_sample_rate);
-  current_bit_depth = bit_depth;
-  i2s_deinit(&i2s_config);
-  // --- I2S Config Setup ---
-  i2s_config = (i2s_config_t){
-      .data_pin = I2S_DATA_PIN,
-      .clock_pin_base = I2S_CLOCK_PIN_BASE,
-      .bit_depth = bit_depth,
-      .pio_instance = PIO,
-      .buffer_frames = current_sample_rate / 1000,
-      .sample_rate = current_sample_rate,
-  };
-  i2s_init(&i2s_config);
-  // i2s_start(current_sample_rate, bit_depth, current_sample_rate / 1000);
+static void stream_start(audio_device_t *dev, uint8_t bit_depth,
+                         uint8_t channels) {
+  const uint8_t id = dev->id;
+  LOG_INFO("Starting stream %u with %d bits, %d ch, %lu Hz", id, bit_depth,
+           channels, dev->current_sample_rate);
+  // ASRC と出力 1 はステレオのみ (usb_audio 側で弾く)
+  assert(2 <= channels && channels <= AUDIO_MAX_CHANNELS &&
+         ((!ASRC && id == 0) || channels == 2));
+  const uint64_t switch_start_us = time_us_64();
+  if (dev->capture_clock) {
+    // 録音のためだけに動かしていたクロックを止める
+    i2s_stop(&dev->i2s_config);
+    dev->capture_clock = false;
+    capture_on_clock_restart();
+  }
+  dev->current_bit_depth = bit_depth;
+  dev->current_channels = channels;
+  // PIO プログラムも DMA チャネルもそのまま使い、レジスタだけ書き換える
+  dev->i2s_config.bit_depth = bit_depth;
+  dev->i2s_config.buffer_frames = block_frames(dev);
+  dev->i2s_config.sample_rate = i2s_sample_rate(dev);
+  dev->i2s_config.mclk_multiplier = mclk_multiplier(dev);
+  i2s_reconfigure(&dev->i2s_config);
 
-  // resize により clear も行われるため、明示的なクリアは不要
-  ringbuffer_resize(&rb, calc_buffer_size(current_sample_rate));
-  g_current_state = STATE_BUFFERING;
-  blink_set_period_us(500000);
+  // 直前の停止からすぐ同じレート、同じチャネル数で再開した場合
+  // (ビット深度の切り替えなど) は中身を残す。それ以外は resize によりクリアされる
+  // 深さはストリームをまたいで引き継ぐ
+  const bool keep =
+      dev->output_stop_time_us != 0 &&
+      dev->output_stop_rate == dev->current_sample_rate &&
+      dev->output_stop_channels == channels &&
+      dev->output_stop_dsd == dev->i2s_config.dsd &&
+      switch_start_us - dev->output_stop_time_us < FORMAT_SWITCH_KEEP_US;
+  const uint32_t size =
+      calc_buffer_size(dev->current_sample_rate, channels, dev->ring_ms);
+  if (keep) {
+    ringbuffer_resize_keep(&dev->rb, size);
+  } else {
+    ringbuffer_resize(&dev->rb, size);
+    dev->output_stop_time_us = 0;
+  }
+  dev->start_stats.ring_kept = keep;
+  dev->start_stats.switch_us = (uint32_t)(time_us_64() - switch_start_us);
+  dev->sync_sof_time_us = 0;
+  dev->stream_start_time_us = time_us_64();
+  dev->first_packet_time_us = 0;
+  dev->start_stats.valid = false;
+  dev->last_packet_time_us = 0;
+  dev->window_settling = false;
+  depth_window_reset(dev, dev->stream_start_time_us);
+  dev->fast_start_filling = false;
+  if (ASRC) {
+    // フィルタの再計算はレートが変わった時だけ行われる
+    asrc_init(&dev->asrc, dev->current_sample_rate, i2s_sample_rate(dev));
+    dev->asrc_filtered_fill = 0.5f;
+    dev->asrc_busy_us = 0;
+    dev->asrc_busy_frames = 0;
+    dev->asrc_stats.active = true;
+    dev->asrc_stats.ratio_ppb = 0;
+  }
+  if (CLOCK_MONITOR && id == 0 && !dev->i2s_config.dsd) {
+    // LRCLK は I2S 開始まで止まっているため、エッジが来るまで何も計測しない
+    // DSD では LRCLK のピンが右チャネルのデータになる
+    clock_monitor_start(i2s_sample_rate(dev));
+  }
+  dev->g_current_state = STATE_BUFFERING;
+  device_blink_period(dev, 500000);
 }
 
-void audio_device_stream_stop(void) {
-  LOG_DEBUG("Stopping stream");
-  i2s_stop(&i2s_config);
-  g_current_state = STATE_STOPPED;
-  blink_set_period_us(1000000);
+static void stream_stop(audio_device_t *dev) {
+  const uint8_t id = dev->id;
+  LOG_DEBUG("Stopping stream %u", id);
+  if (dev->sync_alarm_num >= 0) {
+    hardware_alarm_cancel(dev->sync_alarm_num);
+  }
+  const bool was_running = dev->g_current_state == STATE_PLAYING ||
+                           dev->g_current_state == STATE_STALLED;
+  i2s_stop(&dev->i2s_config);
+  // キャプチャリングも空になるので、録音は深さを溜め直す
+  dev->capture_clock = false;
+  capture_on_clock_restart();
+  if (was_running) {
+    // i2s_stop() は最後のフレームが出るまで待つので、ここが出力の途切れ始め
+    dev->output_stop_time_us = time_us_64();
+    dev->output_stop_rate = dev->current_sample_rate;
+    dev->output_stop_channels = dev->current_channels;
+    dev->output_stop_dsd = dev->i2s_config.dsd;
+  }
+  if (CLOCK_MONITOR && id == 0) {
+    clock_monitor_stop();
+  }
+  dev->asrc_stats.active = false;
+  dev->fast_start_filling = false;
+  // 次のストリームは DSD の alt が選ばれない限り PCM
+  dev->i2s_config.dsd = false;
+  dev->g_current_state = STATE_STOPPED;
+  device_blink_period(dev, 1000000);
+}
+
+// ホストのストリームは S/PDIF 入力より優先する
+void audio_device_stream_start(uint8_t id, uint8_t bit_depth,
+                               uint8_t channels) {
+  audio_device_t *dev = device(id);
+  if (dev->spdif_in_active) {
+    LOG_INFO("USB stream takes over from the S/PDIF input");
+    spdif_in_stop(dev);
+  }
+  dev->current_sample_rate = dev->usb_sample_rate;
+  stream_start(dev, bit_depth, channels);
+}
+
+// usb_audio は 88.2kHz の時だけ DSD の alt を受け付ける
+void audio_device_stream_start_dsd(uint8_t id) {
+  audio_device_t *dev = device(id);
+  assert(DSD && id == 0);
+  if (dev->spdif_in_active) {
+    LOG_INFO("USB stream takes over from the S/PDIF input");
+    spdif_in_stop(dev);
+  }
+  dev->current_sample_rate = dev->usb_sample_rate;
+  dev->i2s_config.dsd = true;
+  stream_start(dev, 32, 2);
+}
+
+void audio_device_stream_stop(uint8_t id) {
+  audio_device_t *dev = device(id);
+  if (dev->spdif_in_active) {
+    return;
+  }
+  stream_stop(dev);
 }
 
 //--------------------------------------------------------------------+/
 // Audio Feature Control
 //--------------------------------------------------------------------+/
 
-void audio_device_set_mute(uint8_t channel, bool muted) {
-  (void)channel;
-  LOG_DEBUG("Set channel %d Mute: %d", channel, muted);
-  mute[channel] = muted;
+void audio_device_set_mute(uint8_t id, uint8_t channel, bool muted) {
+  LOG_DEBUG("Set output %u channel %d Mute: %d", id, channel, muted);
+  if (AUDIO_MAX_CHANNELS < channel) {
+    return;
+  }
+  device(id)->mute[channel] = muted;
 }
 
-bool audio_device_get_mute(uint8_t channel) {
-  (void)channel;
+bool audio_device_get_mute(uint8_t id, uint8_t channel) {
   // LOG_DEBUG("Get channel %u mute %d", channel, mute[channel]);
-  return mute[channel];
+  return channel <= AUDIO_MAX_CHANNELS && device(id)->mute[channel];
 }
 
-void audio_device_set_volume(uint8_t channel, int16_t volume_db_256) {
-  (void)channel;
-  LOG_DEBUG("Set channel %d volume: %d dB", channel, volume_db_256 / 256);
-  volume[channel] = volume_db_256;
+void audio_device_set_volume(uint8_t id, uint8_t channel,
+                             int16_t volume_db_256) {
+  LOG_DEBUG("Set output %u channel %d volume: %d dB", id, channel,
+            volume_db_256 / 256);
+  if (AUDIO_MAX_CHANNELS < channel) {
+    return;
+  }
+  // ゲインの LUT は -96〜0dB。範囲外の SET_CUR は端に丸める
+  if (volume_db_256 < -VOLUME_CTRL_96_DB) {
+    volume_db_256 = -VOLUME_CTRL_96_DB;
+  } else if (VOLUME_CTRL_0_DB < volume_db_256) {
+    volume_db_256 = VOLUME_CTRL_0_DB;
+  }
+  device(id)->volume[channel] = volume_db_256;
 }
 
-int16_t audio_device_get_volume(uint8_t channel) {
-  (void)channel;
+int16_t audio_device_get_volume(uint8_t id, uint8_t channel) {
   // LOG_DEBUG("Get channel %u volume %d dB", channel, volume[channel] / 256);
-  return volume[channel];
+  return channel <= AUDIO_MAX_CHANNELS ? device(id)->volume[channel]
+                                       : VOLUME_CTRL_0_DB;
 }
 
 // This logic is from tud_audio_feature_unit_get_request() in main.c
-void audio_device_get_volume_range(uint8_t channel, int16_t *min, int16_t *max,
-                                   int16_t *res) {
+void audio_device_get_volume_range(uint8_t id, uint8_t channel, int16_t *min,
+                                   int16_t *max, int16_t *res) {
+  (void)id;
   (void)channel;
   LOG_DEBUG("Get channel %u volume range (%d, %d, %u) dB", channel,
             -VOLUME_CTRL_96_DB / 256, VOLUME_CTRL_0_DB / 256, 256 / 256);
@@ -321,16 +1581,24 @@ void audio_device_get_volume_range(uint8_t channel, int16_t *min, int16_t *max,
 // Clock Control
 //--------------------------------------------------------------------+/
 
-void audio_device_set_sampling_freq(uint32_t freq) {
-  LOG_DEBUG("Clock set current freq: %ld", freq);
-  current_sample_rate = freq;
+void audio_device_set_sampling_freq(uint8_t id, uint32_t freq) {
+  LOG_DEBUG("Clock %u set current freq: %ld", id, freq);
+  audio_device_t *dev = device(id);
+  dev->usb_sample_rate = freq;
+  // S/PDIF 入力の再生は止めない。次にホストがストリームを始める時に使う
+  if (dev->spdif_in_active) {
+    return;
+  }
+  dev->current_sample_rate = freq;
 
-  audio_device_stream_stop();
-  g_current_state = STATE_STOPPED;
-  blink_set_period_us(1000000);
+  audio_device_stream_stop(id);
+  dev->g_current_state = STATE_STOPPED;
+  device_blink_period(dev, 1000000);
 }
 
-uint32_t audio_device_get_sampling_freq(void) { return current_sample_rate; }
+uint32_t audio_device_get_sampling_freq(uint8_t id) {
+  return device(id)->usb_sample_rate;
+}
 
 bool audio_device_is_clock_valid(void) {
   LOG_DEBUG("Clock get is valid %u", 1);
@@ -4,59 +4,271 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "i2s.h"
+
 // List of supported sample rates
-#if defined(__RX__)
+#if defined(__RX__) || PICODAC_PDM
+// The PDM modulator runs PDM_OSR bits per frame on core 1, which has the
+// time for that up to 48kHz.
 static const uint32_t SAMPLE_RATES[] = {44100, 48000};
-#else
+#elif (PICODAC_I2S_FORMAT == 3 && 4 < PICODAC_I2S_TDM_SLOTS) || \
+    2 < PICODAC_I2S_DATA_LINES || PICODAC_SPDIF
+// More than 4 TDM slots at 176.4/192kHz would need a BCLK above what the PIO
+// can drive at 2 cycles per bit. 3 or 4 data lines take 8 words per frame,
+// which the DMA blocks hold up to 96kHz. S/PDIF sends a cell per PIO cycle,
+// and above 96kHz the fractional clock divider moves the cell edges by a
+// large part of a cell.
 static const uint32_t SAMPLE_RATES[] = {44100, 48000, 88200, 96000};
+#else
+static const uint32_t SAMPLE_RATES[] = {44100,  48000,  88200,
+                                        96000,  176400, 192000};
 #endif
 
+// Highest rate of the 24/32-bit formats. At 176.4/192kHz only 16-bit
+// frames fit a full-speed isochronous packet.
+#define MAX_WIDE_FORMAT_SAMPLE_RATE 96000
+
+// Channels of the widest format output 0 can render: two per data line or
+// one per TDM slot, rounded down to the 2/4/6/8-channel formats. S/PDIF
+// alone and PDM carry only the front pair. Stereo formats use the first two.
+#if PICODAC_PDM || PICODAC_SPDIF == 1
+#define AUDIO_MAX_CHANNELS 2
+#elif 1 < PICODAC_I2S_DATA_LINES
+#define AUDIO_MAX_CHANNELS (2 * PICODAC_I2S_DATA_LINES)
+#elif PICODAC_I2S_FORMAT == 3
+#define AUDIO_MAX_CHANNELS (PICODAC_I2S_TDM_SLOTS & ~1)
+#else
+#define AUDIO_MAX_CHANNELS 2
+#endif
+// Highest rate of the 4/6/8-channel formats (16-bit). 8 channels at 48kHz
+// take 784 bytes per packet.
+#define MAX_MULTICHANNEL_SAMPLE_RATE 48000
+
 #define N_SAMPLE_RATES (sizeof(SAMPLE_RATES) / sizeof(SAMPLE_RATES[0]))
 
+// Independent outputs. With PICODAC_DUAL_OUTPUT=1 output 1 is a second
+// stereo output on pio1 with its own clock, ring buffer and controls.
+// Output 0 alone carries the multichannel formats, the LED and the clock
+// monitor.
+#if PICODAC_DUAL_OUTPUT
+#define AUDIO_DEVICE_NUM 2
+#else
+#define AUDIO_DEVICE_NUM 1
+#endif
+
 // Audio device state
 typedef enum {
   STATE_STOPPED,
   STATE_BUFFERING,
+  STATE_ARMED,  // I2S is primed and waits for the sync start SOF
   STATE_PLAYING,
   STATE_STALLED
 } app_state_t;
 
 // --- Initialization ---
+// Initializes all AUDIO_DEVICE_NUM outputs. The other functions take the
+// output index (0 ~ AUDIO_DEVICE_NUM - 1) as their first argument.
 void audio_device_init(void);
 
 // --- Main loop tasks ---
-// Handles consuming data from the ring buffer and sending it to I2S.
+// Handles consuming data from the ring buffers and sending it to I2S.
 // This should be called periodically in the main loop.
 void audio_device_task(void);
 
 // --- Data flow ---
 // Call this when audio data is received from the USB host.
-void audio_device_on_usb_rx(const int32_t *buffer, uint32_t num_samples);
+void audio_device_on_usb_rx(uint8_t id, const int32_t *buffer,
+                            uint32_t num_samples);
+
+float audio_device_get_steady_buffer_fill_ratio(uint8_t id);
+
+bool audio_device_is_playing(uint8_t id);
+
+// Call this from the USB SOF interrupt to measure the actual I2S frame rates.
+void audio_device_on_usb_sof(uint16_t frame_number);
+
+// Ring buffer error counters since boot.
+typedef struct {
+  uint32_t underruns;      // Entries into STATE_STALLED
+  uint32_t overruns;       // USB packets that did not fit in the ring
+  uint32_t overrun_bytes;  // Bytes dropped by those packets
+} audio_device_stats_t;
+
+void audio_device_get_stats(uint8_t id, audio_device_stats_t *stats);
+
+// Underrun concealment. An underrun fades out the audio still in the ring,
+// plays silence until RECOVERY_WATER_LEVEL and fades back in.
+typedef struct {
+  uint32_t last_duration_us;       // Last underrun, fade-out to fade-in
+  uint32_t last_concealed_frames;  // Silent frames played by the last underrun
+  uint32_t concealed_frames;       // Silent frames played since boot
+} audio_device_underrun_stats_t;
+
+void audio_device_get_underrun_stats(uint8_t id,
+                                     audio_device_underrun_stats_t *stats);
+
+// PIO TX stalls of the output's I2S state machine (see i2s.h)
+void audio_device_get_hw_underrun_stats(uint8_t id,
+                                        i2s_underrun_stats_t *stats);
+
+// Result of the last SOF-aligned synchronized start.
+// Units on the same host start on the same SOF frame number, so the
+// inter-device skew is the difference of their sof_to_start_us values.
+typedef struct {
+  bool valid;
+  uint16_t start_frame;      // SOF frame number the start was aligned to
+  uint16_t sof_to_start_us;  // SOF interrupt to PIO enable
+  int16_t start_error_us;    // Deviation from the configured start delay
+} audio_device_sync_start_stats_t;
+
+void audio_device_get_sync_start_stats(uint8_t id,
+                                       audio_device_sync_start_stats_t *stats);
+
+// Measured I2S frame rate in frames/ms (16.16 fixed point).
+// Returns false unless the I2S clock is external and a measurement exists.
+bool audio_device_get_measured_rate(uint8_t id, uint32_t *frames_per_ms_q16);
+
+// False if the I2S clock is external and its last measured rate is more
+// than a few hundred ppm away from freq. A stream whose rate turns out not
+// to match the external clock is stopped once the rate has been measured.
+bool audio_device_is_rate_playable(uint8_t id, uint32_t freq);
+
+// Relative rate the feedback should request on top of the nominal one.
+// Non-zero while a fast start builds the buffer up to its target level.
+float audio_device_get_rate_boost(uint8_t id);
+
+// Time to first sample of the last stream start. The first sample is the
+// first USB sample that leaves I2S, one DMA block after I2S starts.
+// A restart at the same rate shortly after a stop (e.g. a bit depth change)
+// keeps the buffered samples; output_gap_us is then the silence between the
+// last sample of the old stream and the first of the new one.
+typedef struct {
+  bool valid;
+  bool ring_kept;                            // Buffered samples were kept
+  uint32_t stream_start_to_first_sample_us;  // From SET_INTERFACE
+  uint32_t first_packet_to_first_sample_us;  // From the first OUT packet
+  uint32_t switch_us;      // Time spent reconfiguring I2S and the buffer
+  uint32_t output_gap_us;  // From the previous stop, 0 if not kept
+} audio_device_start_stats_t;
+
+void audio_device_get_start_stats(uint8_t id,
+                                  audio_device_start_stats_t *stats);
+
+// Ring buffer depth. With PICODAC_ADAPTIVE_DEPTH=1 the target depth follows
+// the packet arrival jitter and the lowest fill seen in each window.
+typedef struct {
+  bool adaptive;
+  uint16_t ring_ms;          // Ring buffer length; levels are ratios of it
+  uint32_t target_depth_us;  // Fill level the feedback steers to
+  uint32_t jitter_us;        // Packet interval spread in the last window
+  uint32_t min_fill_us;      // Lowest fill before a DMA block, last window
+} audio_device_depth_stats_t;
+
+void audio_device_get_depth_stats(uint8_t id,
+                                  audio_device_depth_stats_t *stats);
+
+// Cost of filling one DMA block (ring buffer read, ASRC and gain), averaged
+// over the last second. Shorter blocks (PICODAC_LOW_LATENCY) cost more per
+// frame because the fixed per-block work is repeated more often.
+// spare_cycles_per_frame is what is left of one frame period after filling
+// the blocks, i.e. the budget for further per-frame processing at the
+// current rate.
+typedef struct {
+  uint16_t block_us;          // DMA block length of the latency profile
+  uint16_t load_permille;     // Share of core 0 spent filling blocks
+  uint32_t cycles_per_block;  // Mean cycles per block, DMA IRQ excluded
+  uint32_t sample_rate;       // I2S rate the figures were measured at
+  uint16_t spare_cycles_per_frame;
+} audio_device_cpu_stats_t;
+
+void audio_device_get_cpu_stats(uint8_t id, audio_device_cpu_stats_t *stats);
+
+// Sum of load_permille over the outputs that are playing, i.e. the share of
+// core 0 spent filling blocks with all active streams.
+uint16_t audio_device_get_total_load_permille(void);
+
+// True when the firmware is built with the ASRC (PICODAC_ASRC=1). The ring
+// buffer level is then held by the conversion ratio instead of the feedback.
+bool audio_device_uses_asrc(void);
+
+typedef struct {
+  bool active;
+  int32_t ratio_ppb;          // Conversion ratio adjustment steered by the ring
+  uint32_t cycles_per_frame;  // Mean conversion cost over the last second
+} audio_device_asrc_stats_t;
+
+void audio_device_get_asrc_stats(uint8_t id,
+                                 audio_device_asrc_stats_t *stats);
+
+// S/PDIF input (PICODAC_SPDIF_IN=1). Output 0 plays the received stream
+// while no USB stream is running on it; a USB stream takes over as soon as
+// the host starts one. Without the ASRC the source clock is followed by
+// dropping or repeating single frames.
+typedef struct {
+  bool locked;             // A stream at a supported rate is received
+  bool playing;            // Output 0 plays the received stream
+  uint32_t sample_rate;    // Nominal rate of the received stream
+  uint32_t bad_subframes;  // Parity and preamble errors since the lock
+  uint32_t slips;          // Frames dropped or repeated since playing
+} audio_device_spdif_in_stats_t;
+
+void audio_device_get_spdif_in_stats(audio_device_spdif_in_stats_t *stats);
+
+// PDM output (PICODAC_PDM=1) on output 0: the modulator on core 1.
+// active is false without it.
+void audio_device_get_pdm_stats(i2s_pdm_stats_t *stats);
 
-float audio_device_get_steady_buffer_fill_ratio();
+// ADC capture (PICODAC_ADC=1): an I2S ADC on the clocks of output 0, sent to
+// the host on an isochronous IN stream. While output 0 is not playing, its
+// clocks run with silence for the capture alone. Each packet carries the
+// nominal frames per ms, one more or one less whenever the captured depth
+// drifts from its target, so the host follows the I2S clock.
+typedef struct {
+  bool active;                 // The host has the IN stream open
+  bool clock_only;             // I2S runs for the capture alone
+  uint8_t bit_depth;           // Of the USB stream, 16 or 24
+  uint16_t load_permille;      // Share of core 0 spent filling IN packets
+  uint32_t cycles_per_packet;  // Mean over the last second
+  uint32_t depth_us;           // Captured audio waiting, low-pass filtered
+  uint32_t slips;              // Packets a frame longer or shorter than nominal
+  uint32_t empty_packets;      // Sent while the depth builds up after a start
+} audio_device_capture_stats_t;
 
-bool audio_device_is_playing();
+// Called from the IN stream's SET_INTERFACE, bit_depth 16 or 24
+void audio_device_capture_start(uint8_t bit_depth);
+void audio_device_capture_stop(void);
+// Fills the next IN packet, at most max_bytes; dst is word aligned.
+// Returns its length, 0 while the capture is stopped or starting.
+uint16_t audio_device_capture_fill(uint8_t *dst, uint16_t max_bytes);
+void audio_device_get_capture_stats(audio_device_capture_stats_t *stats);
 
 // --- Audio Stream State Control ---
-void audio_device_stream_start(uint8_t bit_depth);
-void audio_device_stream_stop(void);
+// channels: 2 to AUDIO_MAX_CHANNELS (output 0) or 2 (output 1), interleaved
+// in USB order
+void audio_device_stream_start(uint8_t id, uint8_t bit_depth,
+                               uint8_t channels);
+// Native DSD64 on output 0 (PICODAC_DSD=1): stereo frames of
+// sample_format_unpack_dsd() at 88.2kHz, played as a 2.8224MHz bitstream
+void audio_device_stream_start_dsd(uint8_t id);
+void audio_device_stream_stop(uint8_t id);
 
 // --- Audio Feature Control (to be called from USB control request handlers)
 // ---
 
-void audio_device_set_mute(uint8_t channel, bool muted);
-bool audio_device_get_mute(uint8_t channel);
+void audio_device_set_mute(uint8_t id, uint8_t channel, bool muted);
+bool audio_device_get_mute(uint8_t id, uint8_t channel);
 
 // Volume is handled as dB * 256 (UAC2 native format)
-void audio_device_set_volume(uint8_t channel, int16_t volume_db_256);
-int16_t audio_device_get_volume(uint8_t channel);
-void audio_device_get_volume_range(uint8_t channel, int16_t *min, int16_t *max,
-                                   int16_t *res);
+void audio_device_set_volume(uint8_t id, uint8_t channel,
+                             int16_t volume_db_256);
+int16_t audio_device_get_volume(uint8_t id, uint8_t channel);
+void audio_device_get_volume_range(uint8_t id, uint8_t channel, int16_t *min,
+                                   int16_t *max, int16_t *res);
 
 // --- Clock Control (to be called from USB control request handlers) ---
 
-void audio_device_set_sampling_freq(uint32_t freq);
-uint32_t audio_device_get_sampling_freq(void);
+void audio_device_set_sampling_freq(uint8_t id, uint32_t freq);
+uint32_t audio_device_get_sampling_freq(uint8_t id);
 
 bool audio_device_is_clock_valid(void);
 
@@ -0,0 +1,174 @@
+#include "capture.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+#include "log.h"
+#include "sample_format.h"
+
+// Depth to capture before sending, which absorbs the main loop's delays in
+// filling packets
+#define CAPTURE_DEPTH_US 2000
+// A packet is a frame longer or shorter while the filtered depth is this far
+// from the target
+#define CAPTURE_SLIP_US 500
+// The depth low-pass: 1/16 of each new reading, in 1/256 frames
+#define CAPTURE_DEPTH_FRAC_BITS 8
+#define CAPTURE_SLIP_LPF_SHIFT 4
+// Load accounting window
+#define CAPTURE_LOAD_WINDOW_US 1000000
+
+// Module-level state
+static const i2s_config_t *i2s = NULL;
+static bool is_active = false;
+static uint8_t bit_depth = 0;
+// Set once CAPTURE_DEPTH_US is captured; cleared when the ring empties
+static bool is_primed = false;
+static uint32_t nominal_frac = 0;  // In 1/1000 frames (44.1kHz family)
+static int32_t filtered_depth = 0;  // CAPTURE_DEPTH_FRAC_BITS fixed point
+static capture_stats_t stats;
+
+static uint64_t load_window_start_us = 0;
+static uint32_t busy_us = 0;
+static uint32_t busy_packets = 0;
+
+void capture_start(const i2s_config_t *config, uint8_t depth) {
+  LOG_INFO("Starting capture with %d bits", depth);
+  assert(config->capture && (depth == 16 || depth == 24));
+  i2s = config;
+  is_active = true;
+  bit_depth = depth;
+  nominal_frac = 0;
+  is_primed = false;
+  load_window_start_us = 0;
+  busy_us = 0;
+  busy_packets = 0;
+  stats.slips = 0;
+  stats.empty_packets = 0;
+  // Whatever is left from the previous capture is stale
+  i2s_skip_capture(i2s, i2s_get_capture_available(i2s));
+}
+
+void capture_stop(void) {
+  LOG_DEBUG("Stopping capture");
+  is_active = false;
+  stats.load_permille = 0;
+}
+
+bool capture_is_active(void) { return is_active; }
+
+void capture_on_clock_restart(void) { is_primed = false; }
+
+// Time spent filling packets, summed into stats every window
+static void on_packet(uint32_t start_us) {
+  const uint64_t now = time_us_64();
+  busy_us += (uint32_t)now - start_us;
+  ++busy_packets;
+  if (load_window_start_us == 0) {
+    load_window_start_us = now;
+  } else if (CAPTURE_LOAD_WINDOW_US <= now - load_window_start_us) {
+    stats.cycles_per_packet = (uint32_t)((uint64_t)busy_us *
+                                         (clock_get_hz(clk_sys) / 1000000) /
+                                         busy_packets);
+    stats.load_permille =
+        (uint16_t)((uint64_t)busy_us * 1000 / (now - load_window_start_us));
+    load_window_start_us = now;
+    busy_us = 0;
+    busy_packets = 0;
+  }
+}
+
+// Frames of this packet: the nominal frames per ms (accumulating the
+// fraction of the 44.1kHz family), a frame more or less by the depth
+static uint32_t packet_frames(uint32_t available) {
+  const uint32_t rate = i2s->sample_rate;
+  uint32_t frames = rate / 1000;
+  nominal_frac += rate % 1000;
+  if (1000 <= nominal_frac) {
+    nominal_frac -= 1000;
+    ++frames;
+  }
+
+  const int32_t target =
+      (int32_t)(((uint64_t)rate * CAPTURE_DEPTH_US << CAPTURE_DEPTH_FRAC_BITS) /
+                1000000);
+  const int32_t level = (int32_t)(available << CAPTURE_DEPTH_FRAC_BITS);
+  if (!is_primed) {
+    // Empty packets until the target depth after the clocks start
+    if (level < target) {
+      return 0;
+    }
+    is_primed = true;
+    filtered_depth = level;
+  } else if (available < frames) {
+    // The clocks stopped, or the host stopped asking and the ring wrapped.
+    // Build the depth up again
+    is_primed = false;
+    i2s_skip_capture(i2s, available);
+    return 0;
+  }
+
+  filtered_depth += (level - filtered_depth) >> CAPTURE_SLIP_LPF_SHIFT;
+  const int32_t margin =
+      (int32_t)(((uint64_t)rate * CAPTURE_SLIP_US << CAPTURE_DEPTH_FRAC_BITS) /
+                1000000);
+  int32_t slip = 0;
+  if (target + margin < filtered_depth) {
+    slip = 1;
+  } else if (filtered_depth < target - margin) {
+    slip = -1;
+  }
+  // The filtered depth moves by the frame too, so that it does not slip on
+  // the following packets before the ring catches up
+  filtered_depth -= slip * (1 << CAPTURE_DEPTH_FRAC_BITS);
+  stats.slips += slip != 0;
+  frames += slip;
+  return frames < available ? frames : available;
+}
+
+uint16_t capture_fill(uint8_t *dst, uint16_t max_bytes) {
+  if (!is_active) {
+    return 0;
+  }
+  const uint32_t start_us = time_us_32();
+  uint32_t frames = packet_frames(i2s_get_capture_available(i2s));
+  const uint32_t frame_bytes = bit_depth == 16 ? 4 : 8;
+  if (max_bytes / frame_bytes < frames) {
+    frames = max_bytes / frame_bytes;
+  }
+  if (frames == 0) {
+    ++stats.empty_packets;
+  }
+
+  // Packed in two runs where the frames wrap around the end of the ring
+  const uint32_t shift = 32 - i2s_get_capture_bits(i2s);
+  uint8_t *out = dst;
+  while (frames) {
+    uint32_t run;
+    const int32_t *src = i2s_peek_capture(i2s, &run);
+    if (frames < run) {
+      run = frames;
+    }
+    out += bit_depth == 16
+               ? sample_format_pack_16(src, run * 2, shift, out)
+               : sample_format_pack_24in32(src, run * 2, shift, out);
+    i2s_skip_capture(i2s, run);
+    frames -= run;
+  }
+  on_packet(start_us);
+  return (uint16_t)(out - dst);
+}
+
+void capture_get_stats(capture_stats_t *out) {
+  stats.active = is_active;
+  stats.bit_depth = bit_depth;
+  stats.depth_us = 0;
+  if (is_primed && 0 < filtered_depth) {
+    stats.depth_us = (uint32_t)(((uint64_t)filtered_depth * 1000000 >>
+                                 CAPTURE_DEPTH_FRAC_BITS) /
+                                i2s->sample_rate);
+  }
+  *out = stats;
+}
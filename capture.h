@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "i2s.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  bool active;                 // Between capture_start() and capture_stop()
+  uint8_t bit_depth;           // Of the USB stream, 16 or 24
+  uint16_t load_permille;      // Share of the CPU spent filling packets
+  uint32_t cycles_per_packet;  // Mean over the last second
+  uint32_t depth_us;           // Captured audio waiting, low-pass filtered
+  uint32_t slips;              // Packets a frame longer or shorter than nominal
+  uint32_t empty_packets;      // Sent while the depth builds up after a start
+} capture_stats_t;
+
+/**
+ * @brief Starts sending the ADC input of an I2S output in USB packets.
+ *
+ * Frames captured before the call are discarded. The output's clocks must
+ * run for anything to be captured; starting them is up to the caller.
+ *
+ * @param config The output with capture enabled. Must stay valid until
+ * capture_stop().
+ * @param bit_depth Of the USB stream, 16 (2-byte subslots) or 24 (4-byte).
+ */
+void capture_start(const i2s_config_t *config, uint8_t bit_depth);
+
+/**
+ * @brief Stops filling packets. The statistics remain available.
+ */
+void capture_stop(void);
+
+bool capture_is_active(void);
+
+/**
+ * @brief Notes that the output's clocks restarted, which empties the
+ * capture ring. Packets stay empty until the target depth is captured again.
+ */
+void capture_on_clock_restart(void);
+
+/**
+ * @brief Fills the next packet, at most max_bytes.
+ *
+ * Each packet carries the nominal frames per millisecond at the output's
+ * sample rate, one more or one less whenever the low-pass filtered depth of
+ * the capture ring drifts from its target, so that the host follows the I2S
+ * clock. The samples are packed straight into dst, which must be word
+ * aligned (e.g. the endpoint's USB buffer).
+ *
+ * @return The packet length, 0 while stopped or building up the depth.
+ */
+uint16_t capture_fill(uint8_t *dst, uint16_t max_bytes);
+
+void capture_get_stats(capture_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,181 @@
+#include "clock_monitor.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "clock_monitor.pio.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "pico/assert.h"
+
+// Capture ring written by DMA. Must be a power of two and aligned to its size
+#define CLOCK_MONITOR_BUFFER_WORDS 256
+#define CLOCK_MONITOR_BUFFER_RING_BITS 10  // log2(256 * 4 bytes)
+
+// Restart the DMA transfer before its counter runs out (~9 hours at 96kHz)
+#define CLOCK_MONITOR_TRANSFER_COUNT 0xFFFFFFFFu
+#define CLOCK_MONITOR_REARM_THRESHOLD 0x10000000u
+
+// Module-level state
+static PIO pio_instance = NULL;
+static uint sm = 0;
+static uint pio_offset = 0;
+static uint dma_channel = 0;
+static bool is_running = false;
+
+static uint32_t capture_buffer[CLOCK_MONITOR_BUFFER_WORDS]
+    __attribute__((aligned(CLOCK_MONITOR_BUFFER_WORDS * sizeof(uint32_t))));
+
+static uint32_t nominal_rate_hz = 0;
+static uint32_t window_periods = 0;
+
+// Processing state
+static uint32_t read_total = 0;  // Timestamps consumed
+static bool has_prev = false;
+static uint32_t prev_timestamp = 0;
+
+// Current window accumulators (in counter steps)
+static uint32_t n = 0;
+static uint64_t sum = 0;
+static uint64_t sum_sq = 0;
+static uint32_t min_period = 0;
+static uint32_t max_period = 0;
+
+static clock_monitor_stats_t stats;
+
+static void reset_window() {
+  n = 0;
+  sum = 0;
+  sum_sq = 0;
+  min_period = UINT32_MAX;
+  max_period = 0;
+}
+
+static void dma_restart() {
+  dma_channel_abort(dma_channel);
+  dma_channel_set_write_addr(dma_channel, capture_buffer, false);
+  dma_channel_set_trans_count(dma_channel, CLOCK_MONITOR_TRANSFER_COUNT, true);
+  read_total = 0;
+  has_prev = false;
+}
+
+void clock_monitor_init(PIO pio, uint lrclk_pin) {
+  assert(pio_instance == NULL);
+
+  pio_instance = pio;
+  pio_offset = pio_add_program(pio_instance, &clock_monitor_program);
+  sm = pio_claim_unused_sm(pio_instance, true);
+  clock_monitor_program_init(pio_instance, sm, pio_offset, lrclk_pin);
+
+  dma_channel = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(dma_channel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, CLOCK_MONITOR_BUFFER_RING_BITS);
+  channel_config_set_dreq(&c, pio_get_dreq(pio_instance, sm, false));
+  dma_channel_configure(dma_channel, &c, capture_buffer, &pio_instance->rxf[sm],
+                        CLOCK_MONITOR_TRANSFER_COUNT, false);
+
+  memset(&stats, 0, sizeof(stats));
+}
+
+void clock_monitor_deinit() {
+  assert(pio_instance != NULL);
+
+  clock_monitor_stop();
+  dma_channel_unclaim(dma_channel);
+  pio_sm_unclaim(pio_instance, sm);
+  pio_remove_program(pio_instance, &clock_monitor_program, pio_offset);
+  pio_instance = NULL;
+}
+
+void clock_monitor_start(uint32_t nominal_rate) {
+  assert(pio_instance != NULL);
+  clock_monitor_stop();
+
+  nominal_rate_hz = nominal_rate;
+  // One window per second of audio
+  window_periods = nominal_rate;
+  reset_window();
+
+  pio_sm_clear_fifos(pio_instance, sm);
+  pio_sm_restart(pio_instance, sm);
+  pio_sm_exec(pio_instance, sm, pio_encode_jmp(pio_offset));
+  dma_restart();
+  pio_sm_set_enabled(pio_instance, sm, true);
+  is_running = true;
+}
+
+void clock_monitor_stop() {
+  assert(pio_instance != NULL);
+  if (!is_running) {
+    return;
+  }
+  pio_sm_set_enabled(pio_instance, sm, false);
+  dma_channel_abort(dma_channel);
+  is_running = false;
+}
+
+static void finish_window() {
+  const double sys_hz = clock_get_hz(clk_sys);
+  const double cycles_per_count = CLOCK_MONITOR_CYCLES_PER_COUNT;
+
+  // Each period is (timestamp difference + 1) counter steps
+  double mean = (double)sum / n + 1.0;
+  double rate = sys_hz / (mean * cycles_per_count);
+
+  // Variance in counter steps^2, computed exactly in integers first
+  uint64_t var_num = (uint64_t)n * sum_sq - sum * sum;
+  double rms_cycles = sqrt((double)var_num) / n * cycles_per_count;
+  double pp_cycles = (double)(max_period - min_period) * cycles_per_count;
+
+  stats.rate_mhz = (uint32_t)lround(rate * 1000.0);
+  stats.error_ppb = (int32_t)lround((rate / nominal_rate_hz - 1.0) * 1e9);
+  stats.jitter_rms_ns = (uint16_t)MIN(rms_cycles * 1e9 / sys_hz, UINT16_MAX);
+  stats.jitter_pp_ns = (uint16_t)MIN(pp_cycles * 1e9 / sys_hz, UINT16_MAX);
+  stats.valid = true;
+
+  reset_window();
+}
+
+void clock_monitor_task() {
+  if (!is_running) {
+    return;
+  }
+
+  uint32_t remaining = dma_hw->ch[dma_channel].transfer_count;
+  uint32_t written = CLOCK_MONITOR_TRANSFER_COUNT - remaining;
+
+  if (CLOCK_MONITOR_BUFFER_WORDS < written - read_total) {
+    // The main loop fell behind and the ring was overwritten
+    read_total = written;
+    has_prev = false;
+  }
+
+  while (read_total != written) {
+    uint32_t timestamp =
+        capture_buffer[read_total % CLOCK_MONITOR_BUFFER_WORDS];
+    ++read_total;
+
+    if (has_prev) {
+      // X counts down
+      uint32_t period = prev_timestamp - timestamp;
+      sum += period;
+      sum_sq += (uint64_t)period * period;
+      min_period = MIN(min_period, period);
+      max_period = MAX(max_period, period);
+      if (++n == window_periods) {
+        finish_window();
+      }
+    }
+    prev_timestamp = timestamp;
+    has_prev = true;
+  }
+
+  if (remaining < CLOCK_MONITOR_REARM_THRESHOLD) {
+    dma_restart();
+  }
+}
+
+void clock_monitor_get_stats(clock_monitor_stats_t *s) { *s = stats; }
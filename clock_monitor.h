@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/pio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  bool valid;
+  uint32_t rate_mhz;       // Measured LRCLK rate in millihertz
+  int32_t error_ppb;       // Deviation from the nominal rate
+  uint16_t jitter_rms_ns;  // RMS period jitter
+  uint16_t jitter_pp_ns;   // Peak-to-peak period jitter
+} clock_monitor_stats_t;
+
+/**
+ * @brief Initializes the LRCLK edge capture state machine and its DMA.
+ *
+ * @param pio The PIO instance to use. Any free state machine is claimed.
+ * @param lrclk_pin The LRCLK pin to observe.
+ */
+void clock_monitor_init(PIO pio, uint lrclk_pin);
+
+/**
+ * @brief Deinitializes the capture, releasing hardware resources.
+ */
+void clock_monitor_deinit();
+
+/**
+ * @brief Starts capturing LRCLK edges.
+ *
+ * @param nominal_rate The expected LRCLK rate in Hz, used for the ppm error.
+ */
+void clock_monitor_start(uint32_t nominal_rate);
+
+/**
+ * @brief Stops capturing. The last statistics remain available.
+ */
+void clock_monitor_stop();
+
+/**
+ * @brief Processes the captured timestamps.
+ *
+ * Should be called periodically in the main loop, at least once every
+ * CLOCK_MONITOR_BUFFER_WORDS LRCLK periods.
+ */
+void clock_monitor_task();
+
+/**
+ * @brief Returns the statistics of the last completed measurement window.
+ */
+void clock_monitor_get_stats(clock_monitor_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
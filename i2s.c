@@ -1,161 +1,715 @@
 #include "i2s.h"
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/timer.h"
 #include "i2s.pio.h"
 #include "log.h"
+#include "pdm.h"
+#include "pdm.pio.h"
+#include "pico/multicore.h"
+#include "sample_format.h"
+#include "spdif.h"
+#include "spdif.pio.h"
 
 // --- Hardware Mute Pin ---
 // To enable hardware mute, define I2S_MUTE_PIN to a valid GPIO number.
 // #define I2S_MUTE_PIN 28
 
-#define MAX_I2S_SAMPLE_RATE 96000
+#define MAX_I2S_SAMPLE_RATE 192000
 #define MAX_BUFFER_FRAMES (MAX_I2S_SAMPLE_RATE / 1000)
-#define DMA_IRQ_INDEX 0
-#define DMA_IRQ DMA_IRQ_NUM(DMA_IRQ_INDEX)
+// Words per block: 1ms of stereo at 192kHz, TDM4 at 192kHz or TDM8 at 96kHz
+#define MAX_BLOCK_WORDS (MAX_BUFFER_FRAMES * 4)
+#define MAX_DMA_BLOCKS 8
+// Upper bound of the wait for the state machine to reach a frame boundary.
+// An external master clock may stop at any time in slave mode.
+#define I2S_DRAIN_TIMEOUT_US 1000
+// One output per PIO block. Output n takes DMA_IRQ_n, so that the two
+// interrupt handlers never share a line.
+#define I2S_MAX_OUTPUTS 2
 
-// --- Module-level static variables ---
-static uint pio_sm = 0;
-static uint pio_offset = 0;
-static const pio_program_t *loaded_pio_program = NULL;
+// PDM runs PDM_OSR bits per frame and channel through the modulator on
+// core 1, which has the time for that up to 48kHz
+#define MAX_PDM_SAMPLE_RATE 48000
+#define MAX_PDM_BLOCK_FRAMES (MAX_PDM_SAMPLE_RATE / 1000)
+// Jobs passed to core 1 through the SIO FIFO: the block to modulate, and
+// whether to modulate silence or restart the modulator first
+#define PDM_JOB_BLOCK_MASK 0xFFu
+#define PDM_JOB_SILENCE (1u << 8)
+#define PDM_JOB_RESET (1u << 9)
+// Core 1 load is averaged over this window
+#define PDM_STATS_WINDOW_US 1000000
+// Silence before the modulator starts: both pins toggle every bit, which
+// the RC filter averages to mid-level
+#define PDM_IDLE_PATTERN 0xCC
 
-// Pointers to track which buffer is for writing and which is for DMA
-static int32_t dma_buffer[2][MAX_BUFFER_FRAMES * 2];
-static int32_t *volatile write_buffer = NULL;
-static int32_t *volatile read_buffer = NULL;
-static volatile uint current_dma_channel;
+// Two DMA channels that play the blocks of a buffer in turn
+typedef struct {
+  // Start addresses that the control channel loads into the data channel,
+  // one per block. The control channel wraps around this list with its read
+  // address ring, so the list is aligned to its largest size.
+  int32_t *block_list[MAX_DMA_BLOCKS]
+      __attribute__((aligned(MAX_DMA_BLOCKS * sizeof(int32_t *))));
+  // Audio blocks, played in turn by the data channel. Blocks are spaced by
+  // the largest block size so that the block index follows from the read
+  // address alone. Allocated by dma_chain_init().
+  int32_t (*buffer)[MAX_BLOCK_WORDS];
+  uint data_channel;
+  uint ctrl_channel;
+} dma_chain_t;
 
-// Flag to notify application that a buffer is ready for writing
-static volatile bool buffer_ready = false;
-static bool initialized = false;
+// --- Per-output state ---
+typedef struct {
+  uint pio_sm;
+  uint pio_offset;
+  const pio_program_t *loaded_pio_program;
+  // Offset of the right channel's first instruction, where the state machine
+  // stalls when it runs out of data between the two halves of a frame. TDM
+  // has no such point and leaves it past the end of the instruction memory.
+  uint pio_right_offset;
+
+  // The master program plays DSD instead of PCM
+  bool dsd;
+
+  // MCLK state machine (only when config->mclk_multiplier != 0)
+  bool mclk_enabled;
+  uint mclk_sm;
+  uint mclk_offset;
+
+  // Feeds the state machine above. Its data channel raises the interrupt.
+  dma_chain_t dma;
+  uint32_t dma_blocks;
+  uint32_t dma_block_frames;
+  uint32_t dma_words_per_frame;
+  uint32_t dma_transfer_words;
+  bool dma_running;
+
+  // Block the data channel was reading at the last interrupt, and the
+  // frames of all blocks it had finished by then
+  volatile uint32_t playing_block;
+  volatile uint32_t completed_frames;
+
+  // Hardware underruns, detected from the state machine's TX stall flag
+  PIO dma_pio;
+  uint32_t tx_stall_mask;
+  volatile uint32_t tx_stalls;
+  volatile uint32_t last_stall_frame;
+  volatile uint64_t last_stall_us;
+  // Whether the DMA chain was idle at the previous i2s_get_underrun_stats()
+  bool dma_idle_seen;
+
+  // S/PDIF. On its own it runs on the state machine and DMA chain above;
+  // beside I2S on spdif_sm and spdif_dma, which follow the same blocks.
+  i2s_spdif_mode_t spdif;
+  spdif_encoder_t spdif_encoder;
+  uint spdif_sm;
+  uint spdif_offset;
+  dma_chain_t spdif_dma;
+
+  // PDM. The state machine and DMA chain above play the bitstreams, which
+  // core 1 modulates from pdm_pcm, one copied block per DMA block. The
+  // modulator belongs to core 1 once launched.
+  bool pdm;
+  pdm_modulator_t pdm_modulator;
+  int32_t (*pdm_pcm)[MAX_PDM_BLOCK_FRAMES * 2];
+  bool pdm_reset_pending;
+  volatile uint32_t pdm_queued;  // Jobs pushed by core 0
+  volatile uint32_t pdm_done;    // Jobs finished by core 1
+  volatile uint32_t pdm_late_blocks;
+  volatile uint32_t pdm_cycles_per_block;
+  volatile uint16_t pdm_load_permille;
+
+  // ADC input. Its data channel writes the slots from the RX FIFO around
+  // capture_ring and then triggers the control channel, which points it
+  // back at the start of the ring.
+  bool capture;
+  uint capture_sm;
+  uint capture_offset;
+  int32_t *capture_ring;  // I2S_CAPTURE_RING_FRAMES frames of 2 words
+  uint capture_data_channel;
+  uint capture_ctrl_channel;
+  uint32_t capture_read;  // Frame index of the next unread frame
+
+  // Block last handed to the application by i2s_is_buffer_ready()
+  uint32_t write_block;
+  bool initialized;
+} i2s_output_t;
+
+static i2s_output_t outputs[I2S_MAX_OUTPUTS];
+
+// The output whose blocks core 1 modulates
+static i2s_output_t *pdm_output = NULL;
+
+// The output driven by config->pio_instance
+static i2s_output_t *output_of(const i2s_config_t *config) {
+  const uint index = pio_get_index(config->pio_instance);
+  assert(index < I2S_MAX_OUTPUTS);
+  return &outputs[index];
+}
+
+static uint dma_irq_index(const i2s_output_t *out) {
+  return (uint)(out - outputs);
+}
 
 // #define TRACE_LOG LOG_DEBUG
 #define TRACE_LOG
 
-// DMA interrupt handler
-static void dma_irq_handler() {
-  // Acknowledge the interrupt for our channel
-  dma_irqn_acknowledge_channel(DMA_IRQ_INDEX, current_dma_channel);
+// Index of the block the data channel is reading, and the number of words
+// it has read from it
+static uint32_t dma_current_block(const i2s_output_t *out,
+                                  const dma_chain_t *chain,
+                                  uint32_t *words_read) {
+  const uint32_t offset = dma_hw->ch[chain->data_channel].read_addr -
+                          (uintptr_t)chain->buffer;
+  if (words_read) {
+    *words_read = offset % sizeof(chain->buffer[0]) / sizeof(int32_t);
+  }
+  return offset / sizeof(chain->buffer[0]) % out->dma_blocks;
+}
 
-  // Swap buffers
-  int32_t *volatile temp = write_buffer;
-  write_buffer = read_buffer;
-  read_buffer = temp;
+// DMA interrupt handler. The blocks are chained by the control channel, so
+// this only keeps the frame count; being late by up to dma_blocks - 1 blocks
+// costs nothing.
+static void dma_irq_handle(i2s_output_t *out) {
+  dma_irqn_acknowledge_channel(dma_irq_index(out), out->dma.data_channel);
 
-  // Start DMA on the new read_buffer
-  dma_channel_set_read_addr(current_dma_channel, read_buffer, true);
+  const uint32_t block = dma_current_block(out, &out->dma, NULL);
+  const uint32_t passed =
+      (block + out->dma_blocks - out->playing_block) % out->dma_blocks;
+  out->completed_frames += passed * out->dma_block_frames;
+  out->playing_block = block;
 
-  // Set flag for the application
-  buffer_ready = true;
+  // The FIFO is refilled within a few cycles of each DREQ, so a stall while
+  // running means DMA fell behind (bus contention or a broken chain)
+  if (out->dma_pio->fdebug & out->tx_stall_mask) {
+    out->dma_pio->fdebug = out->tx_stall_mask;
+    ++out->tx_stalls;
+    out->last_stall_frame = out->completed_frames;
+    out->last_stall_us = time_us_64();
+  }
 }
 
-static void dma_init(const i2s_config_t *config) {
-  TRACE_LOG("dma_init begin\n");
-  PIO pio = config->pio_instance;
+static void dma_irq_handler_0() { dma_irq_handle(&outputs[0]); }
+static void dma_irq_handler_1() { dma_irq_handle(&outputs[1]); }
+static const irq_handler_t dma_irq_handlers[I2S_MAX_OUTPUTS] = {
+    dma_irq_handler_0,
+    dma_irq_handler_1,
+};
+
+// Core 1: modulates the blocks pushed by i2s_write_pdm() in turn. Busy time
+// is summed over PDM_STATS_WINDOW_US and published when the window closes.
+static void pdm_core1_entry(void) {
+  static const int32_t silence[2] = {0, 0};
+  i2s_output_t *out = pdm_output;
+  uint32_t window_start_us = time_us_32();
+  uint32_t busy_us = 0;
+  uint32_t blocks = 0;
+  while (true) {
+    const uint32_t job = multicore_fifo_pop_blocking();
+    const uint32_t block = job & PDM_JOB_BLOCK_MASK;
+    const uint32_t start_us = time_us_32();
+    if (job & PDM_JOB_RESET) {
+      const uint32_t resets = out->pdm_modulator.resets;
+      pdm_modulator_init(&out->pdm_modulator);
+      out->pdm_modulator.resets = resets;
+    }
+    const bool silent = job & PDM_JOB_SILENCE;
+    pdm_modulate(&out->pdm_modulator, silent ? silence : out->pdm_pcm[block],
+                 out->dma_block_frames, silent ? 0 : 2,
+                 (uint32_t *)out->dma.buffer[block]);
+    // DMA already reading the block has played some of the previous round
+    if (out->dma_running && dma_current_block(out, &out->dma, NULL) == block) {
+      ++out->pdm_late_blocks;
+    }
+    const uint32_t end_us = time_us_32();
+    busy_us += end_us - start_us;
+    ++blocks;
+    ++out->pdm_done;
+
+    const uint32_t window_us = end_us - window_start_us;
+    if (window_us >= PDM_STATS_WINDOW_US) {
+      const uint64_t cycles =
+          (uint64_t)busy_us * (clock_get_hz(clk_sys) / 1000000);
+      out->pdm_cycles_per_block = (uint32_t)(cycles / blocks);
+      out->pdm_load_permille = (uint16_t)((uint64_t)busy_us * 1000 / window_us);
+      window_start_us = end_us;
+      busy_us = 0;
+      blocks = 0;
+    }
+  }
+}
+
+// Sets the number of blocks the control channel cycles through
+static void dma_chain_set_blocks(dma_chain_t *chain, uint32_t blocks) {
+  for (uint32_t i = 0; i < blocks; ++i) {
+    chain->block_list[i] = chain->buffer[i];
+  }
+  dma_channel_config ctrl_config = dma_get_channel_config(chain->ctrl_channel);
+  channel_config_set_ring(&ctrl_config, false,
+                          __builtin_ctz(blocks * sizeof(int32_t *)));
+  dma_channel_set_config(chain->ctrl_channel, &ctrl_config, false);
+}
+
+static void dma_chain_init(dma_chain_t *chain, PIO pio, uint sm,
+                           uint32_t blocks, uint32_t transfer_words) {
+  chain->buffer = malloc(sizeof(chain->buffer[0]) * MAX_DMA_BLOCKS);
+  assert(chain->buffer);
+
+  const uint data_dma_channel = chain->data_channel =
+      dma_claim_unused_channel(true);
+  const uint ctrl_dma_channel = chain->ctrl_channel =
+      dma_claim_unused_channel(true);
+
+  // Data channel: one block into the PIO TX FIFO, then triggers the control
+  // channel
+  dma_channel_config data_config =
+      dma_channel_get_default_config(data_dma_channel);
+  channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&data_config, true);
+  channel_config_set_write_increment(&data_config, false);
+  channel_config_set_dreq(&data_config, pio_get_dreq(pio, sm, true));
+  channel_config_set_chain_to(&data_config, ctrl_dma_channel);
+  channel_config_set_high_priority(&data_config, true);
+  dma_channel_configure(data_dma_channel, &data_config, &pio->txf[sm],
+                        NULL,  // Read address (loaded by the control channel)
+                        dma_encode_transfer_count(transfer_words),
+                        false  // Don't start yet
+  );
+
+  // Control channel: writes the next block address to the data channel's
+  // read address trigger, which restarts it with the same transfer count
+  dma_channel_config ctrl_config =
+      dma_channel_get_default_config(ctrl_dma_channel);
+  channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&ctrl_config, true);
+  channel_config_set_write_increment(&ctrl_config, false);
+  dma_channel_configure(ctrl_dma_channel, &ctrl_config,
+                        &dma_hw->ch[data_dma_channel].al3_read_addr_trig,
+                        chain->block_list, 1,
+                        false  // Don't start yet
+  );
+  dma_chain_set_blocks(chain, blocks);
+}
+
+static void dma_chain_start(dma_chain_t *chain) {
+  // Chaining is cut by dma_chain_stop()
+  dma_channel_config data_config = dma_get_channel_config(chain->data_channel);
+  channel_config_set_chain_to(&data_config, chain->ctrl_channel);
+  dma_channel_set_config(chain->data_channel, &data_config, false);
+  dma_channel_set_read_addr(chain->ctrl_channel, chain->block_list, true);
+}
+
+static bool dma_chain_idle(const dma_chain_t *chain) {
+  return !dma_channel_is_busy(chain->data_channel) &&
+         !dma_channel_is_busy(chain->ctrl_channel);
+}
+
+// Lets the data channel finish its block until deadline_us, so that the
+// FIFO ends on a frame boundary, and aborts what is left after that
+static void dma_chain_stop(dma_chain_t *chain, uint64_t deadline_us) {
+  const uint data_dma_channel = chain->data_channel;
+  const uint ctrl_dma_channel = chain->ctrl_channel;
+
+  // Chain the data channel to itself first, so that neither finishing nor
+  // aborting it triggers the control channel again
+  dma_channel_config data_config = dma_get_channel_config(data_dma_channel);
+  channel_config_set_chain_to(&data_config, data_dma_channel);
+  dma_channel_set_config(data_dma_channel, &data_config, false);
+  while (!dma_chain_idle(chain) && time_us_64() < deadline_us);
+  dma_channel_abort(ctrl_dma_channel);
+  dma_channel_abort(data_dma_channel);
+  while (dma_channel_is_busy(ctrl_dma_channel) ||
+         dma_channel_is_busy(data_dma_channel));
+}
+
+static void dma_chain_deinit(dma_chain_t *chain) {
+  dma_channel_unclaim(chain->ctrl_channel);
+  dma_channel_unclaim(chain->data_channel);
+  free(chain->buffer);
+  chain->buffer = NULL;
+}
 
-  write_buffer = dma_buffer[0];
-  read_buffer = dma_buffer[1];
-
-  current_dma_channel = dma_claim_unused_channel(true);
-  dma_channel_config dma_config =
-      dma_channel_get_default_config(current_dma_channel);
-  channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
-  channel_config_set_read_increment(&dma_config, true);
-  channel_config_set_write_increment(&dma_config, false);
-  channel_config_set_dreq(&dma_config, pio_get_dreq(pio, pio_sm, true));
-  dma_channel_configure(current_dma_channel, &dma_config, &pio->txf[pio_sm],
-                        NULL,  // Read address (set later)
-                        dma_encode_transfer_count(config->buffer_frames * 2),
+static void capture_dma_init(i2s_output_t *out, PIO pio) {
+  out->capture_ring = malloc(sizeof(int32_t) * 2 * I2S_CAPTURE_RING_FRAMES);
+  assert(out->capture_ring);
+
+  const uint data_dma_channel = out->capture_data_channel =
+      dma_claim_unused_channel(true);
+  const uint ctrl_dma_channel = out->capture_ctrl_channel =
+      dma_claim_unused_channel(true);
+
+  // Data channel: the whole ring from the PIO RX FIFO, then triggers the
+  // control channel. The joined FIFO holds 8 slots, so it runs at high
+  // priority like the output.
+  dma_channel_config data_config =
+      dma_channel_get_default_config(data_dma_channel);
+  channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&data_config, false);
+  channel_config_set_write_increment(&data_config, true);
+  channel_config_set_dreq(&data_config, pio_get_dreq(pio, out->capture_sm,
+                                                      false));
+  channel_config_set_chain_to(&data_config, ctrl_dma_channel);
+  channel_config_set_high_priority(&data_config, true);
+  dma_channel_configure(data_dma_channel, &data_config, out->capture_ring,
+                        &pio->rxf[out->capture_sm],
+                        dma_encode_transfer_count(2 * I2S_CAPTURE_RING_FRAMES),
+                        false  // Don't start yet
+  );
+
+  // Control channel: writes the ring's address to the data channel's write
+  // address trigger, which restarts it with the same transfer count
+  dma_channel_config ctrl_config =
+      dma_channel_get_default_config(ctrl_dma_channel);
+  channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&ctrl_config, false);
+  channel_config_set_write_increment(&ctrl_config, false);
+  dma_channel_configure(ctrl_dma_channel, &ctrl_config,
+                        &dma_hw->ch[data_dma_channel].al2_write_addr_trig,
+                        &out->capture_ring, 1,
                         false  // Don't start yet
   );
+}
+
+static void capture_dma_start(i2s_output_t *out) {
+  // Chaining is cut by capture_dma_stop()
+  dma_channel_config data_config =
+      dma_get_channel_config(out->capture_data_channel);
+  channel_config_set_chain_to(&data_config, out->capture_ctrl_channel);
+  dma_channel_set_config(out->capture_data_channel, &data_config, false);
+  out->capture_read = 0;
+  dma_channel_start(out->capture_ctrl_channel);
+}
+
+// The state machine stops right after this and drops what it holds, so
+// there is no boundary to wait for
+static void capture_dma_stop(i2s_output_t *out) {
+  const uint data_dma_channel = out->capture_data_channel;
+  dma_channel_config data_config = dma_get_channel_config(data_dma_channel);
+  channel_config_set_chain_to(&data_config, data_dma_channel);
+  dma_channel_set_config(data_dma_channel, &data_config, false);
+  dma_channel_abort(out->capture_ctrl_channel);
+  dma_channel_abort(data_dma_channel);
+  while (dma_channel_is_busy(out->capture_ctrl_channel) ||
+         dma_channel_is_busy(data_dma_channel));
+  // The ring reads as empty until the next start
+  dma_channel_set_write_addr(data_dma_channel, out->capture_ring, false);
+  out->capture_read = 0;
+}
+
+static void capture_dma_deinit(i2s_output_t *out) {
+  dma_channel_unclaim(out->capture_ctrl_channel);
+  dma_channel_unclaim(out->capture_data_channel);
+  free(out->capture_ring);
+  out->capture_ring = NULL;
+}
+
+// Frame index the data channel writes next
+static uint32_t capture_write_frame(const i2s_output_t *out) {
+  const uint32_t offset =
+      dma_hw->ch[out->capture_data_channel].write_addr -
+      (uintptr_t)out->capture_ring;
+  // The end of the ring, until the control channel has run, is its start
+  return offset / (2 * sizeof(int32_t)) % I2S_CAPTURE_RING_FRAMES;
+}
+
+static void dma_init(i2s_output_t *out, const i2s_config_t *config) {
+  TRACE_LOG("dma_init begin\n");
+  PIO pio = config->pio_instance;
+
+  out->dma_blocks = config->dma_blocks;
+  out->dma_block_frames = config->buffer_frames;
+  out->dma_words_per_frame = i2s_words_per_frame(config);
+  out->dma_transfer_words = out->dma_block_frames * out->dma_words_per_frame;
+  out->dma_pio = pio;
+  out->tx_stall_mask = 1u << (PIO_FDEBUG_TXSTALL_LSB + out->pio_sm);
+  dma_chain_init(&out->dma, pio, out->pio_sm, out->dma_blocks,
+                 out->dma_transfer_words);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    dma_chain_init(&out->spdif_dma, pio, out->spdif_sm, out->dma_blocks,
+                   out->dma_block_frames * SPDIF_WORDS_PER_FRAME);
+  }
+  if (out->capture) {
+    capture_dma_init(out, pio);
+  }
 
   // --- IRQ setup ---
-  dma_irqn_acknowledge_channel(DMA_IRQ_INDEX, current_dma_channel);
-  irq_set_exclusive_handler(DMA_IRQ, dma_irq_handler);
-  irq_set_enabled(DMA_IRQ, true);
+  // Above USB so that the frame count stays close to the hardware
+  const uint irq_index = dma_irq_index(out);
+  const uint irq = DMA_IRQ_NUM(irq_index);
+  dma_irqn_acknowledge_channel(irq_index, out->dma.data_channel);
+  irq_set_exclusive_handler(irq, dma_irq_handlers[irq_index]);
+  irq_set_priority(irq, PICO_HIGHEST_IRQ_PRIORITY);
+  irq_set_enabled(irq, true);
   TRACE_LOG("dma_init end\n");
 }
 
-static void dma_start() {
+static void dma_start(i2s_output_t *out) {
   TRACE_LOG("dma_start begin\n");
-  int32_t *volatile temp = write_buffer;
-  write_buffer = read_buffer;
-  read_buffer = temp;
-
-  dma_irqn_set_channel_enabled(DMA_IRQ_INDEX, current_dma_channel, true);
-  dma_channel_set_read_addr(current_dma_channel, read_buffer, true);
-  buffer_ready = true;
+  // Block 0 plays first (silence); the application fills the others
+  out->playing_block = 0;
+  out->write_block = 0;
+  out->completed_frames = 0;
+  dma_irqn_set_channel_enabled(dma_irq_index(out), out->dma.data_channel,
+                               true);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    dma_chain_start(&out->spdif_dma);
+  }
+  if (out->capture) {
+    capture_dma_start(out);
+  }
+  dma_chain_start(&out->dma);
+  out->dma_running = true;
   TRACE_LOG("dma_start end\n");
 }
 
-static void dma_stop() {
+static void dma_stop(i2s_output_t *out, uint64_t deadline_us) {
   TRACE_LOG("dma_stop begin\n");
-  dma_irqn_set_channel_enabled(DMA_IRQ_INDEX, current_dma_channel, false);
-  dma_channel_abort(current_dma_channel);
-  while (dma_channel_is_busy(current_dma_channel));
-  dma_irqn_acknowledge_channel(DMA_IRQ_INDEX, current_dma_channel);
-  buffer_ready = true;
+  out->dma_running = false;
+  dma_irqn_set_channel_enabled(dma_irq_index(out), out->dma.data_channel,
+                               false);
+  dma_chain_stop(&out->dma, deadline_us);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    dma_chain_stop(&out->spdif_dma, deadline_us);
+  }
+  if (out->capture) {
+    capture_dma_stop(out);
+  }
+  dma_irqn_acknowledge_channel(dma_irq_index(out), out->dma.data_channel);
   TRACE_LOG("dma_stop end\n");
 }
 
-static void dma_deinit() {
+static void dma_deinit(i2s_output_t *out) {
   TRACE_LOG("dma_deinit begin\n");
-  dma_stop();
+  dma_stop(out, 0);
 
-  irq_remove_handler(DMA_IRQ, dma_irq_handler);
-  irq_set_enabled(DMA_IRQ, false);
-  dma_channel_unclaim(current_dma_channel);
+  const uint irq_index = dma_irq_index(out);
+  irq_remove_handler(DMA_IRQ_NUM(irq_index), dma_irq_handlers[irq_index]);
+  irq_set_enabled(DMA_IRQ_NUM(irq_index), false);
+  dma_chain_deinit(&out->dma);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    dma_chain_deinit(&out->spdif_dma);
+  }
+  if (out->capture) {
+    capture_dma_deinit(out);
+  }
   TRACE_LOG("dma_deinit end\n");
 }
 
-static void pio_init(const i2s_config_t *config) {
+// Loads the master program for config and initializes the state machine:
+// the DSD program, or the program of the configured format widened to the
+// number of data lines
+static void pio_load_master_program(i2s_output_t *out,
+                                    const i2s_config_t *config) {
+  PIO pio = config->pio_instance;
+  const uint sm = out->pio_sm;
+  if (config->dsd) {
+    out->loaded_pio_program = &i2s_dsd_program;
+    out->pio_offset = pio_add_program(pio, &i2s_dsd_program);
+    out->pio_right_offset = PIO_INSTRUCTION_COUNT;
+    i2s_dsd_program_init(pio, sm, out->pio_offset, config);
+    return;
+  }
+  out->loaded_pio_program = i2s_master_program(config);
+  uint16_t instructions[PIO_INSTRUCTION_COUNT];
+  pio_program_t program = *out->loaded_pio_program;
+  i2s_program_patch_lines(out->loaded_pio_program, instructions,
+                          config->data_lines);
+  program.instructions = instructions;
+  out->pio_offset = pio_add_program(pio, &program);
+  if (config->format == I2S_FORMAT_TDM) {
+    out->pio_right_offset = PIO_INSTRUCTION_COUNT;
+  } else if (out->loaded_pio_program == &i2s_left_justified_program) {
+    out->pio_right_offset = out->pio_offset + i2s_left_justified_offset_right;
+  } else {
+    out->pio_right_offset = out->pio_offset + i2s_stereo_offset_right;
+  }
+  i2s_program_init(pio, sm, out->pio_offset, config);
+}
+
+static void pio_init(i2s_output_t *out, const i2s_config_t *config) {
   TRACE_LOG("pio_init begin\n");
   // --- PIO setup ---
+  // One program serves every bit depth, so it stays loaded across format
+  // changes (see i2s_reconfigure())
   PIO pio = config->pio_instance;
-  pio_sm = pio_claim_unused_sm(pio, true);
-
-  if (config->bit_depth == 16) {
-    loaded_pio_program = &i2s_stereo_16bit_program;
-    pio_offset = pio_add_program(pio, loaded_pio_program);
-    i2s_16bit_program_init(pio, pio_sm, pio_offset, config);
-  } else if (config->bit_depth == 24) {
-    loaded_pio_program = &i2s_stereo_24bit_program;
-    pio_offset = pio_add_program(pio, loaded_pio_program);
-    i2s_24bit_program_init(pio, pio_sm, pio_offset, config);
-  } else if (config->bit_depth == 32) {
-    loaded_pio_program = &i2s_stereo_32bit_program;
-    pio_offset = pio_add_program(pio, loaded_pio_program);
-    i2s_32bit_program_init(pio, pio_sm, pio_offset, config);
+  const uint sm = out->pio_sm = pio_claim_unused_sm(pio, true);
+
+  if (out->pdm) {
+    // Every bit period is a whole frame of the program
+    out->loaded_pio_program = &pdm_program;
+    out->pio_offset = pio_add_program(pio, &pdm_program);
+    out->pio_right_offset = PIO_INSTRUCTION_COUNT;
+    pdm_program_init(pio, sm, out->pio_offset, config->pdm_pin,
+                     i2s_pdm_clkdiv_q8(config));
+  } else if (out->spdif == I2S_SPDIF_ONLY) {
+    // Frames end on the idle level, so no frame is ever left half sent
+    out->loaded_pio_program = &spdif_program;
+    out->pio_offset = pio_add_program(pio, &spdif_program);
+    out->pio_right_offset = PIO_INSTRUCTION_COUNT;
+    spdif_program_init(pio, sm, out->pio_offset, config->spdif_pin,
+                       i2s_spdif_clkdiv_q8(config));
+  } else if (config->clock_mode == I2S_CLOCK_SLAVE) {
+    out->loaded_pio_program = &i2s_slave_stereo_program;
+    out->pio_offset = pio_add_program(pio, out->loaded_pio_program);
+    out->pio_right_offset = out->pio_offset + i2s_slave_stereo_offset_right;
+    i2s_slave_program_init(pio, sm, out->pio_offset, config);
   } else {
-    // Should not happen
-    assert(false);
+    // Only the program of the configured format is loaded
+    pio_load_master_program(out, config);
+  }
+
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    out->spdif_sm = pio_claim_unused_sm(pio, true);
+    out->spdif_offset = pio_add_program(pio, &spdif_program);
+    spdif_program_init(pio, out->spdif_sm, out->spdif_offset,
+                       config->spdif_pin, i2s_spdif_clkdiv_q8(config));
+  }
+
+  if (out->capture) {
+    uint16_t instructions[PIO_INSTRUCTION_COUNT];
+    pio_program_t program = i2s_in_program;
+    i2s_in_program_patch_clocks(instructions, config->clock_pin_base);
+    program.instructions = instructions;
+    out->capture_sm = pio_claim_unused_sm(pio, true);
+    out->capture_offset = pio_add_program(pio, &program);
+    i2s_in_program_init(pio, out->capture_sm, out->capture_offset, config);
   }
   TRACE_LOG("pio_init end\n");
 }
 
-static void pio_start(const i2s_config_t *config) {
+static void mclk_init(i2s_output_t *out, const i2s_config_t *config) {
+  if (config->mclk_multiplier == 0 ||
+      config->clock_mode == I2S_CLOCK_SLAVE ||
+      out->spdif == I2S_SPDIF_ONLY || out->pdm) {
+    out->mclk_enabled = false;
+    return;
+  }
+  TRACE_LOG("mclk_init begin\n");
+  PIO pio = config->pio_instance;
+  out->mclk_sm = pio_claim_unused_sm(pio, true);
+  out->mclk_offset = pio_add_program(pio, &i2s_mclk_program);
+  i2s_mclk_program_init(pio, out->mclk_sm, out->mclk_offset, config);
+
+  // Keep MCLK running while idle, since codecs usually need it to lock
+  // before the first frame arrives
+  pio_sm_set_enabled(pio, out->mclk_sm, true);
+  out->mclk_enabled = true;
+  TRACE_LOG("mclk_init end\n");
+}
+
+static void mclk_deinit(i2s_output_t *out, const i2s_config_t *config) {
+  if (!out->mclk_enabled) {
+    return;
+  }
+  TRACE_LOG("mclk_deinit begin\n");
+  PIO pio = config->pio_instance;
+  pio_sm_set_enabled(pio, out->mclk_sm, false);
+  pio_remove_program(pio, &i2s_mclk_program, out->mclk_offset);
+  pio_sm_unclaim(pio, out->mclk_sm);
+  out->mclk_enabled = false;
+  TRACE_LOG("mclk_deinit end\n");
+}
+
+static void pio_start(i2s_output_t *out, const i2s_config_t *config) {
   TRACE_LOG("pio_start begin\n");
-  pio_sm_set_enabled(config->pio_instance, pio_sm, true);
+  // Restart MCLK and S/PDIF together with the I2S state machine so that
+  // their clock dividers share the same phase. The ADC input waits for the
+  // clocks to come out.
+  PIO pio = config->pio_instance;
+  uint32_t mask = 1u << out->pio_sm;
+  if (out->mclk_enabled) {
+    mask |= 1u << out->mclk_sm;
+    pio_sm_set_enabled(pio, out->mclk_sm, false);
+    pio_sm_exec(pio, out->mclk_sm, pio_encode_jmp(out->mclk_offset));
+  }
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    mask |= 1u << out->spdif_sm;
+  }
+  if (out->capture) {
+    mask |= 1u << out->capture_sm;
+  }
+  pio_enable_sm_mask_in_sync(pio, mask);
   TRACE_LOG("pio_start end\n");
 }
 
-static void pio_stop(const i2s_config_t *config) {
-  TRACE_LOG("pio_stop begin\n");
-  pio_sm_set_enabled(config->pio_instance, pio_sm, false);
-  pio_sm_clear_fifos(config->pio_instance, pio_sm);
-  pio_sm_exec(config->pio_instance, pio_sm, pio_encode_jmp(pio_offset));
+// Waits until the state machine has shifted out everything queued for it
+static bool pio_wait_stall(PIO pio, uint sm, uint64_t deadline_us) {
+  const uint32_t stall_mask = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm);
+  pio->fdebug = stall_mask;
+  while (!(pio->fdebug & stall_mask)) {
+    if (time_us_64() > deadline_us) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void pio_stop(i2s_output_t *out, const i2s_config_t *config) {
   TRACE_LOG("pio_stop begin\n");
+  PIO pio = config->pio_instance;
+  const uint sm = out->pio_sm;
+
+  // Let the state machine run dry so that it stops at a frame boundary.
+  // Stopping in the middle of a frame would leave the next start with a
+  // channel swap or a half-length first sample.
+  const bool running = pio->ctrl & (1u << sm);
+  const uint64_t deadline_us = time_us_64() + I2S_DRAIN_TIMEOUT_US;
+  if (running && pio_wait_stall(pio, sm, deadline_us) &&
+      pio_sm_get_pc(pio, sm) == out->pio_right_offset) {
+    // The left half of a frame went out; finish it with a silent right half
+    pio_sm_put(pio, sm, 0);
+    pio_wait_stall(pio, sm, deadline_us);
+  }
+
+  pio_sm_set_enabled(pio, sm, false);
+  pio_sm_clear_fifos(pio, sm);
+  pio_sm_restart(pio, sm);
+  pio_sm_exec(pio, sm, pio_encode_jmp(out->pio_offset));
+  pio_sm_exec(pio, sm, pio_encode_mov(pio_x, pio_y));
+
+  // S/PDIF runs in step and has shifted out the same frames by now
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    pio_sm_set_enabled(pio, out->spdif_sm, false);
+    pio_sm_clear_fifos(pio, out->spdif_sm);
+    pio_sm_restart(pio, out->spdif_sm);
+    pio_sm_exec(pio, out->spdif_sm, pio_encode_jmp(out->spdif_offset));
+  }
+
+  // The ADC input drops its partial slot and syncs to LRCLK again on start
+  if (out->capture) {
+    pio_sm_set_enabled(pio, out->capture_sm, false);
+    pio_sm_clear_fifos(pio, out->capture_sm);
+    pio_sm_restart(pio, out->capture_sm);
+    pio_sm_exec(pio, out->capture_sm, pio_encode_jmp(out->capture_offset));
+  }
+  TRACE_LOG("pio_stop end\n");
 }
 
-static void pio_deinit(const i2s_config_t *config) {
+static void pio_deinit(i2s_output_t *out, const i2s_config_t *config) {
   TRACE_LOG("pio_deinit begin\n");
-  if (loaded_pio_program) {
-    pio_remove_program(config->pio_instance, loaded_pio_program, pio_offset);
-    loaded_pio_program = NULL;
+  if (out->loaded_pio_program) {
+    pio_remove_program(config->pio_instance, out->loaded_pio_program,
+                       out->pio_offset);
+    out->loaded_pio_program = NULL;
+  }
+  pio_sm_unclaim(config->pio_instance, out->pio_sm);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    pio_sm_set_enabled(config->pio_instance, out->spdif_sm, false);
+    pio_remove_program(config->pio_instance, &spdif_program,
+                       out->spdif_offset);
+    pio_sm_unclaim(config->pio_instance, out->spdif_sm);
+  }
+  if (out->capture) {
+    pio_sm_set_enabled(config->pio_instance, out->capture_sm, false);
+    pio_remove_program(config->pio_instance, &i2s_in_program,
+                       out->capture_offset);
+    pio_sm_unclaim(config->pio_instance, out->capture_sm);
   }
-  pio_sm_unclaim(config->pio_instance, pio_sm);
   TRACE_LOG("pio_deinit end\n");
 }
 
@@ -163,87 +717,427 @@ void i2s_init(const i2s_config_t *config) {
   TRACE_LOG("i2s_init begin\n");
   assert(config != NULL);
   assert(config->buffer_frames > 0);
+  assert(config->buffer_frames <= MAX_BUFFER_FRAMES);
+  assert(config->buffer_frames * i2s_words_per_frame(config) <=
+         MAX_BLOCK_WORDS);
+  // The slave program follows Philips I2S framing on one data line only
+  assert(config->clock_mode == I2S_CLOCK_MASTER ||
+         (config->format == I2S_FORMAT_I2S && config->data_lines == 1));
+  // TDM carries its channels on one line
+  assert(1 <= config->data_lines && config->data_lines <= 4 &&
+         (config->format != I2S_FORMAT_TDM || config->data_lines == 1));
+  assert(config->format != I2S_FORMAT_TDM ||
+         (2 <= config->tdm_slots && config->tdm_slots <= 8));
+  // The control channel's address ring needs a power of two
+  assert(2 <= config->dma_blocks && config->dma_blocks <= MAX_DMA_BLOCKS &&
+         (config->dma_blocks & (config->dma_blocks - 1)) == 0);
+  // S/PDIF beside I2S follows the I2S clock, which must be our own
+  assert(config->spdif != I2S_SPDIF_MIRROR ||
+         config->clock_mode == I2S_CLOCK_MASTER);
+  // DSD takes the LRCLK pin and the data pin after it as one out group
+  assert(!config->dsd ||
+         (config->clock_mode == I2S_CLOCK_MASTER && config->data_lines == 1 &&
+          config->data_pin == config->clock_pin_base + 2 &&
+          config->spdif == I2S_SPDIF_OFF && !config->pdm));
+  // PDM has the state machine and core 1 to itself, and no clock input
+  assert(!config->pdm ||
+         (config->spdif == I2S_SPDIF_OFF &&
+          config->clock_mode == I2S_CLOCK_MASTER &&
+          config->sample_rate <= MAX_PDM_SAMPLE_RATE &&
+          config->buffer_frames <= MAX_PDM_BLOCK_FRAMES && !pdm_output));
+  // The ADC input follows Philips framing on one line of BCLK and LRCLK
+  assert(!config->capture ||
+         (config->format == I2S_FORMAT_I2S &&
+          config->spdif != I2S_SPDIF_ONLY && !config->pdm && !config->dsd));
+  i2s_output_t *out = output_of(config);
+  assert(!out->initialized);
+  out->spdif = config->spdif;
+  out->pdm = config->pdm;
+  out->dsd = config->dsd;
+  out->capture = config->capture;
+  if (out->spdif != I2S_SPDIF_OFF) {
+    spdif_encoder_init(&out->spdif_encoder, config->sample_rate,
+                       config->bit_depth);
+  }
 
 #ifdef I2S_MUTE_PIN
-  gpio_init(I2S_MUTE_PIN);
-  gpio_set_dir(I2S_MUTE_PIN, GPIO_OUT);
-  i2s_mute();  // Start in muted state
+  if (out == &outputs[0]) {
+    gpio_init(I2S_MUTE_PIN);
+    gpio_set_dir(I2S_MUTE_PIN, GPIO_OUT);
+    i2s_mute(config);  // Start in muted state
+  }
 #endif
 
   // PIO
-  pio_init(config);
+  pio_init(out, config);
+  mclk_init(out, config);
 
   // DMA
-  dma_init(config);
+  dma_init(out, config);
+
+  // Core 1
+  if (out->pdm) {
+    out->pdm_pcm = malloc(sizeof(out->pdm_pcm[0]) * MAX_DMA_BLOCKS);
+    assert(out->pdm_pcm);
+    pdm_modulator_init(&out->pdm_modulator);
+    out->pdm_queued = out->pdm_done = 0;
+    out->pdm_late_blocks = 0;
+    out->pdm_cycles_per_block = 0;
+    out->pdm_load_permille = 0;
+    pdm_output = out;
+    multicore_launch_core1(pdm_core1_entry);
+  }
 
-  // Initially, one buffer is ready to be filled
-  buffer_ready = true;
-  initialized = true;
+  out->initialized = true;
   TRACE_LOG("i2s_init end\n");
 }
 
 void i2s_deinit(const i2s_config_t *config) {
-  if (!initialized) {
+  i2s_output_t *out = output_of(config);
+  if (!out->initialized) {
     return;
   }
   TRACE_LOG("i2s_deinit begin\n");
 
+  // Core 1, which may be writing to the DMA buffers
+  if (out->pdm) {
+    multicore_reset_core1();
+    pdm_output = NULL;
+    free(out->pdm_pcm);
+    out->pdm_pcm = NULL;
+  }
+
   // DMA
-  dma_deinit();
+  dma_deinit(out);
 
   // PIO
-  pio_deinit(config);
+  mclk_deinit(out, config);
+  pio_deinit(out, config);
 
-  initialized = false;
+  out->initialized = false;
   TRACE_LOG("i2s_deinit end\n");
 }
 
+void i2s_reconfigure(const i2s_config_t *config) {
+  TRACE_LOG("i2s_reconfigure begin\n");
+  i2s_output_t *out = output_of(config);
+  assert(out->initialized && !out->dma_running);
+  assert(config->buffer_frames > 0);
+  assert(config->buffer_frames <= MAX_BUFFER_FRAMES);
+  assert(config->buffer_frames * i2s_words_per_frame(config) <=
+         MAX_BLOCK_WORDS);
+  assert(2 <= config->dma_blocks && config->dma_blocks <= MAX_DMA_BLOCKS &&
+         (config->dma_blocks & (config->dma_blocks - 1)) == 0);
+  assert(!out->pdm || (config->sample_rate <= MAX_PDM_SAMPLE_RATE &&
+                       config->buffer_frames <= MAX_PDM_BLOCK_FRAMES));
+  PIO pio = config->pio_instance;
+
+  // PIO: sample length and clock dividers. The dividers restart in phase
+  // in pio_start(). PCM and DSD each have their own program.
+  if (out->dsd != config->dsd) {
+    // DSD takes the LRCLK pin and the data pin after it as one out group
+    assert(config->clock_mode == I2S_CLOCK_MASTER &&
+           config->data_lines == 1 &&
+           config->data_pin == config->clock_pin_base + 2 &&
+           out->spdif == I2S_SPDIF_OFF && !out->pdm && !out->capture);
+    pio_remove_program(pio, out->loaded_pio_program, out->pio_offset);
+    out->dsd = config->dsd;
+    pio_load_master_program(out, config);
+  } else if (out->spdif == I2S_SPDIF_ONLY) {
+    const uint32_t div_q8 = i2s_spdif_clkdiv_q8(config);
+    pio_sm_set_clkdiv_int_frac(pio, out->pio_sm, div_q8 >> 8, div_q8 & 0xff);
+  } else if (out->pdm) {
+    const uint32_t div_q8 = i2s_pdm_clkdiv_q8(config);
+    pio_sm_set_clkdiv_int_frac(pio, out->pio_sm, div_q8 >> 8, div_q8 & 0xff);
+  } else {
+    i2s_program_set_format(pio, out->pio_sm, config);
+  }
+  if (out->capture) {
+    i2s_in_program_set_format(pio, out->capture_sm, config);
+  }
+  if (out->mclk_enabled) {
+    const uint32_t div_q8 = i2s_mclk_clkdiv_q8(config);
+    pio_sm_set_clkdiv_int_frac(pio, out->mclk_sm, div_q8 >> 8,
+                               div_q8 & 0xff);
+  }
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    const uint32_t div_q8 = i2s_spdif_clkdiv_q8(config);
+    pio_sm_set_clkdiv_int_frac(pio, out->spdif_sm, div_q8 >> 8,
+                               div_q8 & 0xff);
+  }
+  if (out->spdif != I2S_SPDIF_OFF) {
+    spdif_encoder_init(&out->spdif_encoder, config->sample_rate,
+                       config->bit_depth);
+  }
+
+  // DMA: block size and count. Both channels are idle after dma_stop().
+  out->dma_block_frames = config->buffer_frames;
+  out->dma_words_per_frame = i2s_words_per_frame(config);
+  out->dma_transfer_words = out->dma_block_frames * out->dma_words_per_frame;
+  dma_channel_set_trans_count(out->dma.data_channel, out->dma_transfer_words,
+                              false);
+  if (out->spdif == I2S_SPDIF_MIRROR) {
+    dma_channel_set_trans_count(
+        out->spdif_dma.data_channel,
+        out->dma_block_frames * SPDIF_WORDS_PER_FRAME, false);
+  }
+  if (out->dma_blocks != config->dma_blocks) {
+    out->dma_blocks = config->dma_blocks;
+    dma_chain_set_blocks(&out->dma, out->dma_blocks);
+    if (out->spdif == I2S_SPDIF_MIRROR) {
+      dma_chain_set_blocks(&out->spdif_dma, out->dma_blocks);
+    }
+  }
+  TRACE_LOG("i2s_reconfigure end\n");
+}
+
 void i2s_start(const i2s_config_t *config) {
   TRACE_LOG("i2s_start begin\n");
-  i2s_unmute();
+  i2s_arm(config);
+  i2s_fire(config);
+  TRACE_LOG("i2s_start end\n");
+}
 
-  // DMA
-  dma_start();
+void i2s_arm(const i2s_config_t *config) {
+  TRACE_LOG("i2s_arm begin\n");
+  i2s_output_t *out = output_of(config);
+  // Start from silence so that the first block out is deterministic
+  memset(out->dma.buffer, 0, sizeof(out->dma.buffer[0]) * MAX_DMA_BLOCKS);
+  if (out->spdif != I2S_SPDIF_OFF) {
+    // S/PDIF silence still carries preambles and channel status, which
+    // keep the receiver locked. The application's first block is block 1,
+    // so the encoder continues from there.
+    out->spdif_encoder.frame = 0;
+    for (uint32_t i = 0; i < out->dma_blocks; ++i) {
+      out->write_block = i;
+      i2s_write_spdif(config, NULL, 0);
+    }
+    out->spdif_encoder.frame = out->dma_block_frames % SPDIF_BLOCK_FRAMES;
+  }
+  if (out->pdm) {
+    // Core 1 is idle since i2s_stop(). The modulator restarts from rest
+    // with the application's first block.
+    memset(out->dma.buffer, PDM_IDLE_PATTERN,
+           sizeof(out->dma.buffer[0]) * MAX_DMA_BLOCKS);
+    out->pdm_reset_pending = true;
+  }
+  if (out->dsd) {
+    // All-zero DSD is full negative scale; silence is an idle pattern
+    uint32_t *words = (uint32_t *)out->dma.buffer;
+    for (uint32_t i = 0; i < MAX_BLOCK_WORDS * MAX_DMA_BLOCKS; ++i) {
+      words[i] = SAMPLE_FORMAT_DSD_SILENCE;
+    }
+  }
 
-  // PIO
-  pio_start(config);
-  TRACE_LOG("i2s_start end\n");
+  // DMA fills the TX FIFO and then waits for the (still disabled) PIO
+  dma_start(out);
+  TRACE_LOG("i2s_arm end\n");
+}
+
+void i2s_fire(const i2s_config_t *config) {
+  i2s_output_t *out = output_of(config);
+  i2s_unmute(config);
+  // The flag is left set by the drain in the previous i2s_stop()
+  config->pio_instance->fdebug = out->tx_stall_mask;
+  pio_start(out, config);
 }
 
 void i2s_stop(const i2s_config_t *config) {
   TRACE_LOG("i2s_stop begin\n");
-  i2s_mute();
+  i2s_output_t *out = output_of(config);
+  i2s_mute(config);
 
-  // DMA
-  dma_stop();
+  // DMA. Blocks hold whole frames, so a finished block leaves the state
+  // machine at a frame boundary in every format. An external master clock
+  // may have stopped in slave mode, hence the deadline; an armed output that
+  // never fired has nothing to finish.
+  const bool running = config->pio_instance->ctrl & (1u << out->pio_sm);
+  const uint64_t block_us =
+      (uint64_t)config->buffer_frames * 1000000 / config->sample_rate;
+  dma_stop(out,
+           running ? time_us_64() + 2 * block_us + I2S_DRAIN_TIMEOUT_US : 0);
 
   // PIO
-  pio_stop(config);
+  pio_stop(out, config);
+
+  // Core 1 finishes the blocks already handed to it, so that nothing
+  // writes to the buffers once the output is stopped
+  while (out->pdm && out->pdm_done != out->pdm_queued);
   TRACE_LOG("i2s_stop end\n");
 }
 
-void i2s_mute() {
+// The mute pin belongs to the output on pio0
+void i2s_mute(const i2s_config_t *config) {
 #ifdef I2S_MUTE_PIN
-  gpio_put(I2S_MUTE_PIN, 0);  // Active Low Mute
+  if (output_of(config) == &outputs[0]) {
+    gpio_put(I2S_MUTE_PIN, 0);  // Active Low Mute
+  }
 #endif
 }
 
-void i2s_unmute() {
+void i2s_unmute(const i2s_config_t *config) {
 #ifdef I2S_MUTE_PIN
-  gpio_put(I2S_MUTE_PIN, 1);
+  if (output_of(config) == &outputs[0]) {
+    gpio_put(I2S_MUTE_PIN, 1);
+  }
 #endif
 }
 
-bool i2s_is_buffer_ready() {
-  if (buffer_ready) {
-    buffer_ready = false;
-    return true;
+bool i2s_is_buffer_ready(const i2s_config_t *config) {
+  i2s_output_t *out = output_of(config);
+  if (!out->dma_running) {
+    return false;
+  }
+  // The next block is free unless the data channel is still reading it.
+  // The S/PDIF channel beside I2S reads a little behind the I2S one, since
+  // its FIFO holds fewer frames.
+  const uint32_t next = (out->write_block + 1) % out->dma_blocks;
+  if (next == dma_current_block(out, &out->dma, NULL) ||
+      (out->spdif == I2S_SPDIF_MIRROR &&
+       next == dma_current_block(out, &out->spdif_dma, NULL))) {
+    return false;
+  }
+  out->write_block = next;
+  return true;
+}
+
+int32_t *i2s_get_write_buffer(const i2s_config_t *config) {
+  i2s_output_t *out = output_of(config);
+  return out->dma.buffer[out->write_block];
+}
+
+void i2s_write_spdif(const i2s_config_t *config, const int32_t *src,
+                     uint32_t channels) {
+  static const int32_t silence[2] = {0, 0};
+  i2s_output_t *out = output_of(config);
+  assert(out->spdif != I2S_SPDIF_OFF);
+  dma_chain_t *chain =
+      out->spdif == I2S_SPDIF_MIRROR ? &out->spdif_dma : &out->dma;
+  spdif_encode(&out->spdif_encoder, src ? src : silence,
+               out->dma_block_frames, src ? channels : 0,
+               (uint32_t *)chain->buffer[out->write_block]);
+}
+
+void i2s_write_pdm(const i2s_config_t *config, const int32_t *src,
+                   uint32_t channels) {
+  i2s_output_t *out = output_of(config);
+  assert(out->pdm);
+  uint32_t job = out->write_block;
+  if (src) {
+    int32_t *dst = out->pdm_pcm[out->write_block];
+    for (uint32_t i = 0; i < out->dma_block_frames; ++i, src += channels) {
+      dst[2 * i] = src[0];
+      dst[2 * i + 1] = src[1];
+    }
+  } else {
+    job |= PDM_JOB_SILENCE;
+  }
+  if (out->pdm_reset_pending) {
+    job |= PDM_JOB_RESET;
+    out->pdm_reset_pending = false;
   }
-  return false;
+  ++out->pdm_queued;
+  multicore_fifo_push_blocking(job);
 }
 
-int32_t *i2s_get_write_buffer() { return (int32_t *)write_buffer; }
+void i2s_get_pdm_stats(const i2s_config_t *config, i2s_pdm_stats_t *stats) {
+  const i2s_output_t *out = output_of(config);
+  stats->active = out->pdm && out->initialized;
+  if (!stats->active) {
+    memset(stats, 0, sizeof(*stats));
+    return;
+  }
+  stats->load_permille = out->pdm_load_permille;
+  stats->cycles_per_block = out->pdm_cycles_per_block;
+  const uint32_t bits = out->dma_block_frames * PDM_OSR * 2;
+  stats->centicycles_per_bit =
+      (uint32_t)((uint64_t)stats->cycles_per_block * 100 / bits);
+  stats->late_blocks = out->pdm_late_blocks;
+  stats->resets = out->pdm_modulator.resets;
+}
 
 uint32_t i2s_get_buffer_size_frames(const i2s_config_t *config) {
   return config->buffer_frames;
 }
+
+void i2s_get_underrun_stats(const i2s_config_t *config,
+                            i2s_underrun_stats_t *stats) {
+  i2s_output_t *out = output_of(config);
+  uint64_t stall_us;
+  do {
+    stats->tx_stalls = out->tx_stalls;
+    stats->last_stall_frame = out->last_stall_frame;
+    stall_us = out->last_stall_us;
+  } while (stats->tx_stalls != out->tx_stalls);
+
+  const uint64_t age_ms = (time_us_64() - stall_us) / 1000;
+  stats->ms_since_stall =
+      stall_us == 0 ? UINT32_MAX : age_ms < UINT32_MAX ? (uint32_t)age_ms
+                                                       : UINT32_MAX - 1;
+
+  // Between blocks both channels can be idle for a cycle while the control
+  // channel hands over. A stop is only reported when the previous call saw
+  // the chain idle as well, a whole polling interval earlier.
+  const bool idle = out->dma_running && dma_chain_idle(&out->dma);
+  stats->dma_stopped = idle && out->dma_idle_seen;
+  out->dma_idle_seen = idle;
+}
+
+uint32_t i2s_get_words_per_frame(const i2s_config_t *config) {
+  return i2s_words_per_frame(config);
+}
+
+uint32_t i2s_get_sample_shift(const i2s_config_t *config) {
+  return config->format == I2S_FORMAT_RIGHT_JUSTIFIED
+             ? 32u - config->bit_depth
+             : 0;
+}
+
+uint32_t i2s_get_frames_played(const i2s_config_t *config) {
+  const i2s_output_t *out = output_of(config);
+  if (!out->dma_running) {
+    return out->completed_frames;
+  }
+  // Retry if the DMA interrupt ran between the reads. Blocks finished since
+  // the last interrupt are counted from the read address.
+  uint32_t frames;
+  uint32_t block;
+  uint32_t words_read;
+  do {
+    frames = out->completed_frames;
+    block = (dma_current_block(out, &out->dma, &words_read) +
+             out->dma_blocks - out->playing_block) %
+            out->dma_blocks;
+  } while (frames != out->completed_frames);
+  return frames + block * out->dma_block_frames +
+         words_read / out->dma_words_per_frame;
+}
+
+uint32_t i2s_get_capture_available(const i2s_config_t *config) {
+  const i2s_output_t *out = output_of(config);
+  assert(out->capture);
+  return (capture_write_frame(out) + I2S_CAPTURE_RING_FRAMES -
+          out->capture_read) %
+         I2S_CAPTURE_RING_FRAMES;
+}
+
+const int32_t *i2s_peek_capture(const i2s_config_t *config,
+                                uint32_t *frames) {
+  const i2s_output_t *out = output_of(config);
+  assert(out->capture);
+  const uint32_t write = capture_write_frame(out);
+  *frames = write < out->capture_read
+                ? I2S_CAPTURE_RING_FRAMES - out->capture_read
+                : write - out->capture_read;
+  return &out->capture_ring[2 * out->capture_read];
+}
+
+void i2s_skip_capture(const i2s_config_t *config, uint32_t frames) {
+  i2s_output_t *out = output_of(config);
+  assert(out->capture);
+  out->capture_read = (out->capture_read + frames) % I2S_CAPTURE_RING_FRAMES;
+}
+
+uint32_t i2s_get_capture_bits(const i2s_config_t *config) {
+  return i2s_in_slot_bits(config);
+}
@@ -1,22 +1,104 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "hardware/pio.h"
 
+// --- Clock Mode ---
+typedef enum {
+  I2S_CLOCK_MASTER,  // BCLK/LRCLK are generated from the system clock
+  I2S_CLOCK_SLAVE,   // BCLK/LRCLK are inputs driven by an external oscillator
+} i2s_clock_mode_t;
+
+// --- Serial Format ---
+typedef enum {
+  I2S_FORMAT_I2S,              // MSB one BCLK after the LRCLK edge, left: low
+  I2S_FORMAT_LEFT_JUSTIFIED,   // MSB on the LRCLK edge, left: high
+  I2S_FORMAT_RIGHT_JUSTIFIED,  // LSB at the end of a 32-bit slot, left: high
+  I2S_FORMAT_TDM,              // tdm_slots 32-bit slots, 1-BCLK frame sync
+} i2s_format_t;
+
+// --- S/PDIF Output ---
+typedef enum {
+  I2S_SPDIF_OFF,
+  I2S_SPDIF_ONLY,    // S/PDIF on spdif_pin instead of I2S
+  I2S_SPDIF_MIRROR,  // S/PDIF on spdif_pin beside I2S (master mode only)
+} i2s_spdif_mode_t;
+
 // --- Configuration Struct ---
 typedef struct {
-  uint8_t data_pin;        // I2S DATA pin
+  uint8_t data_pin;        // I2S DATA pin, the first of data_lines
+  uint8_t data_lines;      // Adjacent data pins (1~4, master mode only)
   uint8_t clock_pin_base;  // BCLK pin. LRCLK will be clock_pin_base + 1
-  uint8_t bit_depth;       // 16 or 24
+  uint8_t bit_depth;       // 16, 24 or 32
   PIO pio_instance;        // PIO instance to use (pio0 or pio1)
   uint32_t buffer_frames;  // Number of frames (stereo samples) per DMA buffer
-  uint32_t sample_rate;    // sample_rate (44.1kHz ~ 96kHz)
+  uint8_t dma_blocks;      // DMA buffers played in a cycle (2, 4 or 8)
+  uint32_t sample_rate;    // sample_rate (44.1kHz ~ 192kHz)
+  i2s_clock_mode_t clock_mode;  // Master (default) or slave clocking
+  uint16_t mclk_multiplier;     // MCLK = sample_rate * this (128~512), 0: off
+  uint8_t mclk_pin;             // MCLK pin, used when mclk_multiplier != 0
+  i2s_format_t format;          // Framing (master mode only), default I2S
+  uint8_t tdm_slots;            // Slots per TDM frame (2~8), L/R in 0 and 1
+  i2s_spdif_mode_t spdif;       // S/PDIF output, default off
+  uint8_t spdif_pin;            // S/PDIF pin, used when spdif != off
+  bool pdm;         // Sigma-delta bitstreams instead of I2S (up to 48kHz)
+  uint8_t pdm_pin;  // Left channel pin when pdm, right is pdm_pin + 1
+  // Native DSD instead of PCM (master mode, one data line), 32 bits per
+  // channel and frame. The DSD clock is on BCLK, left on the data pin and
+  // right on LRCLK.
+  bool dsd;
+  // I2S input from an ADC on capture_pin, clocked by BCLK and LRCLK (Philips
+  // I2S framing, one data line). The slots are as wide as the output's.
+  bool capture;
+  uint8_t capture_pin;
 } i2s_config_t;
 
+// Underruns seen by the hardware, as opposed to the application's buffer.
+// A TX stall means the state machine ran out of data, i.e. DMA did not keep
+// up; the output repeats the last bit until data arrives.
+typedef struct {
+  uint32_t tx_stalls;         // DMA blocks during which the FIFO ran dry
+  uint32_t last_stall_frame;  // i2s_get_frames_played() when last detected
+  uint32_t ms_since_stall;    // Age of the last detection, UINT32_MAX: none
+  bool dma_stopped;           // DMA idle at this call and the previous one
+} i2s_underrun_stats_t;
+
+// Core 1 running the sigma-delta modulator of a PDM output
+typedef struct {
+  bool active;                   // Core 1 is launched
+  uint16_t load_permille;        // Share of core 1, over the last second
+  uint32_t cycles_per_block;     // Modulating one DMA block
+  uint32_t centicycles_per_bit;  // Per output bit of one channel, x100
+  uint32_t late_blocks;  // Blocks still being modulated when DMA reached them
+  uint32_t resets;       // Modulator loops cleared after going unstable
+} i2s_pdm_stats_t;
+
 /**
  * @brief Initializes the I2S output PIO and DMA systems.
  *
+ * Each PIO block drives at most one output, so pio0 and pio1 give two
+ * independent outputs with their own clocks, DMA channels and DMA_IRQ
+ * (DMA_IRQ_0 for pio0, DMA_IRQ_1 for pio1). The other functions find the
+ * output from config->pio_instance.
+ *
+ * With S/PDIF the output also runs the S/PDIF program (spdif.pio). On its
+ * own it takes the place of the I2S state machine and DMA chain, and the
+ * I2S pins, MCLK and format are unused. Beside I2S it has its own state
+ * machine and DMA chain, started together with the I2S ones; its clock
+ * divider is an exact ratio of the I2S divider, so both play the same
+ * block at the same time.
+ *
+ * With PDM the output runs the PDM program (pdm.pio) on the I2S state
+ * machine and DMA chain instead, and launches core 1, which modulates each
+ * block written with i2s_write_pdm() into its DMA buffer (see pdm.h). One
+ * output at most can use PDM, since it takes the whole core.
+ *
+ * With capture the output also runs the ADC input program on another state
+ * machine, started and stopped together with the output, and a DMA channel
+ * pair that writes its slots around a ring in RAM.
+ *
  * @param config Configuration parameters for the I2S interface.
  */
 void i2s_init(const i2s_config_t* config);
@@ -26,25 +108,56 @@ void i2s_init(const i2s_config_t* config);
  */
 void i2s_deinit(const i2s_config_t* config);
 
+/**
+ * @brief Switches a stopped output to another bit depth, sample rate or
+ * buffer size, or between PCM and DSD.
+ *
+ * The PIO program serves all bit depths and stays loaded, and the DMA
+ * channels stay claimed, so this only rewrites a few registers. Switching
+ * between PCM and DSD swaps the program. Pins, PIO instance, clock mode and
+ * format must be the same as in i2s_init().
+ */
+void i2s_reconfigure(const i2s_config_t* config);
+
 /**
  * @brief Starts the I2S audio output.
  */
 void i2s_start(const i2s_config_t* config);
 
+/**
+ * @brief Prepares the I2S output without starting it.
+ *
+ * Clears the DMA buffers and starts DMA, which fills the PIO TX FIFO while the
+ * state machine is still disabled. i2s_fire() then starts the output with a
+ * fixed, short latency. i2s_start() is equivalent to i2s_arm() + i2s_fire().
+ */
+void i2s_arm(const i2s_config_t* config);
+
+/**
+ * @brief Starts an output prepared by i2s_arm(). Safe to call from an IRQ.
+ */
+void i2s_fire(const i2s_config_t* config);
+
 /**
  * @brief Stops the I2S audio output.
+ *
+ * The output stops at a frame boundary after the queued samples have been
+ * shifted out, which takes a few frames.
  */
 void i2s_stop(const i2s_config_t* config);
 
 /**
  * @brief Mutes the audio output using the hardware mute pin, if configured.
+ *
+ * The mute pin belongs to the output on pio0; for the other output this
+ * does nothing.
  */
-void i2s_mute();
+void i2s_mute(const i2s_config_t* config);
 
 /**
  * @brief Unmutes the audio output using the hardware mute pin, if configured.
  */
-void i2s_unmute();
+void i2s_unmute(const i2s_config_t* config);
 
 /**
  * @brief Checks if a new buffer is ready to be filled by the application.
@@ -53,21 +166,75 @@ void i2s_unmute();
  * a buffer has been fully transferred via DMA and is now free. The application
  * can then call i2s_get_write_buffer() to get its address and fill it.
  *
+ * The buffers are chained by DMA without CPU involvement, so up to
+ * dma_blocks - 1 filled buffers are queued ahead of the one playing. A buffer
+ * that is not refilled in time is played again.
+ *
  * @return True if a new buffer is available for writing, false otherwise.
  */
-bool i2s_is_buffer_ready();
+bool i2s_is_buffer_ready(const i2s_config_t* config);
 
 /**
  * @brief Returns a pointer to the next available buffer for writing audio data.
  *
  * The application should fill this buffer with new audio samples.
- * The data must be formatted as 32-bit words.
+ * The data must be formatted as 32-bit words, left-justified: the upper
+ * bit_depth bits are sent and the rest is ignored.
  *
  * Example: buffer[i] = left_sample; buffer[i+1] = right_sample;
  *
+ * 16-bit frames are packed into one word instead, which halves the DMA and
+ * PIO FIFO traffic (see i2s_get_words_per_frame()):
+ *
+ * Example: buffer[i] = (left_sample << 16) | (uint16_t)right_sample;
+ *
+ * Right-justified samples are shifted right by i2s_get_sample_shift() first.
+ * With several data lines the slots are 32 bits and the words interleave
+ * the lines bit by bit; sample_format_pack_lines() produces that layout.
+ * TDM frames take one word per slot; slots the application does not write
+ * stay silent, since the buffers are cleared when the output starts.
+ * The S/PDIF frames of the block are written with i2s_write_spdif(), and
+ * the bitstreams of a PDM output with i2s_write_pdm().
+ *
  * @return A pointer to the writable buffer (as int32_t*).
  */
-int32_t* i2s_get_write_buffer();
+int32_t* i2s_get_write_buffer(const i2s_config_t* config);
+
+/**
+ * @brief Encodes a block of audio into the S/PDIF buffer of the block
+ * returned by i2s_get_write_buffer().
+ *
+ * The blocks are encoded in the order they are written, so the channel
+ * status block runs on across them. The buffers start with encoded
+ * silence, and a block that is not written again is played again like an
+ * I2S block.
+ *
+ * @param src buffer_frames frames of left-justified samples, of which the
+ * first two channels are sent. NULL encodes silence.
+ * @param channels The number of samples per frame in src.
+ */
+void i2s_write_spdif(const i2s_config_t* config, const int32_t* src,
+                     uint32_t channels);
+
+/**
+ * @brief Hands a block of audio to core 1, which modulates it into the
+ * buffer returned by i2s_get_write_buffer().
+ *
+ * The block is copied, so src can be reused at once. The modulator runs on
+ * across blocks in the order they are written. The buffers start with the
+ * bit pattern of silence, which holds the filtered output at mid-level.
+ *
+ * @param src buffer_frames frames of left-justified samples, of which the
+ * first two channels are sent. NULL modulates silence.
+ * @param channels The number of samples per frame in src.
+ */
+void i2s_write_pdm(const i2s_config_t* config, const int32_t* src,
+                   uint32_t channels);
+
+/**
+ * @brief Returns the modulator load on core 1 and its counters.
+ */
+void i2s_get_pdm_stats(const i2s_config_t* config, i2s_pdm_stats_t* stats);
 
 /**
  * @brief Returns the size of the audio buffers in stereo samples.
@@ -77,3 +244,78 @@ int32_t* i2s_get_write_buffer();
  * @return The number of stereo samples that can be written to the buffer.
  */
 uint32_t i2s_get_buffer_size_frames(const i2s_config_t* config);
+
+/**
+ * @brief Returns the hardware underrun counters.
+ *
+ * The TX stall flag is checked once per DMA block, so stalls within the
+ * same block count once and are timestamped up to one block late. A stopped
+ * DMA chain is reported from the second call in a row that finds it idle.
+ */
+void i2s_get_underrun_stats(const i2s_config_t* config,
+                            i2s_underrun_stats_t* stats);
+
+/**
+ * @brief Returns the number of 32-bit words per frame in the buffers.
+ *
+ * @return 1 for packed 16-bit frames, tdm_slots for TDM, 4 or 8 for
+ * several data lines, 4 for S/PDIF alone, 2 otherwise (PDM included).
+ */
+uint32_t i2s_get_words_per_frame(const i2s_config_t* config);
+
+/**
+ * @brief Returns the arithmetic right shift from a left-justified sample to
+ * a buffer word.
+ *
+ * @return 32 - bit_depth for right-justified output, 0 otherwise.
+ */
+uint32_t i2s_get_sample_shift(const i2s_config_t* config);
+
+/**
+ * @brief Returns the number of frames consumed by the I2S output so far.
+ *
+ * The counter advances by one per LRCLK period while the output is running,
+ * so in slave mode it counts the periods of the external LRCLK. It wraps
+ * around at 2^32 and is safe to call from interrupt context.
+ *
+ * @return The running frame count.
+ */
+uint32_t i2s_get_frames_played(const i2s_config_t* config);
+
+// Frames the capture ring holds, 5ms at 192kHz
+#define I2S_CAPTURE_RING_FRAMES 1024
+
+/**
+ * @brief Returns the number of captured frames not read yet.
+ *
+ * Capture runs while the output runs. Each frame is two words, left and
+ * right, with the i2s_get_capture_bits() bits of a slot in their low bits,
+ * MSB first. DMA writes them around a ring of I2S_CAPTURE_RING_FRAMES frames
+ * that restarts empty with each i2s_start(); frames left unread for longer
+ * than the ring holds are overwritten and cannot be told apart from new ones.
+ */
+uint32_t i2s_get_capture_available(const i2s_config_t* config);
+
+/**
+ * @brief Returns the oldest unread captured frames, in place in the ring.
+ *
+ * @param frames Set to the number of frames at the returned address, which
+ * ends at the end of the ring. i2s_skip_capture() past them gives the rest.
+ */
+const int32_t* i2s_peek_capture(const i2s_config_t* config, uint32_t* frames);
+
+/**
+ * @brief Marks captured frames as read.
+ *
+ * Skipping everything available, i2s_get_capture_available() frames,
+ * discards the backlog.
+ */
+void i2s_skip_capture(const i2s_config_t* config, uint32_t frames);
+
+/**
+ * @brief Returns the number of valid bits in a captured word.
+ *
+ * @return The slot width: bit_depth on one data line, 32 with several or in
+ * slave mode.
+ */
+uint32_t i2s_get_capture_bits(const i2s_config_t* config);
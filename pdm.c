@@ -0,0 +1,120 @@
+#include "pdm.h"
+
+#include <string.h>
+
+// Loop filter: five integrators in a chain with the output fed back into
+// each (CIFB), and two resonators that move four of the noise transfer
+// function's zeros from DC across the audio band. The NTF has its zeros at
+// the roots of the degree-5 Legendre polynomial scaled to pi / PDM_OSR and
+// maximally flat poles with a peak gain of 1.5, which keeps a 1-bit loop
+// stable up to about 0.6 of full density. The feedback coefficients match
+// the loop filter to 1 - 1 / NTF for the update order of modulate_frame().
+//
+// Fixed point: the feedback is +-PDM_UNIT. x1 is kept 64 times larger for
+// resolution and scaled back on the way into x2. The resonators and the
+// scale-down are shifts, so a bit costs adds and shifts only.
+#define PDM_UNIT_SHIFT 26
+#define A1 2945888   // Also the input gain; x1 scale
+#define A2 468688
+#define A3 3134609
+#define A4 12682409
+#define A5 37442026
+#define X1_SHIFT 6  // x1 to x2 scale
+#define G1_SHIFT 8  // x3 into x2, zeros near 0.64 * pi / PDM_OSR
+#define G2_SHIFT 7  // x5 into x4, zeros near 0.90 * pi / PDM_OSR
+
+// A stable loop keeps x5 within about 1.2 units at full scale; an unstable
+// one grows until it wraps around
+#define X5_LIMIT (8 << PDM_UNIT_SHIFT)
+
+// Holding a sample for a frame weighs the band with sinc(f / fs), -2.6dB at
+// 20kHz and 48kHz. y[n] = x[n-1] + c (2 x[n-1] - x[n-2] - x[n]) with
+// c = 5 / 64 rises by 1 + 4c sin^2(pi f / fs) against it, which leaves
+// +0.4 to -0.4dB up to 20kHz at 48kHz (-0.9dB at 44.1kHz). Its gain is at
+// most 1 + 4c = 21 / 16, so the input is scaled down by as much and the
+// output never goes past the full scale of the loop, A1 / 2.
+#define DROOP_MUL 5
+#define DROOP_SHIFT 6
+#define IN_GAIN (A1 * 16 / 21)
+
+void pdm_modulator_init(pdm_modulator_t *mod) {
+  memset(mod, 0, sizeof(*mod));
+}
+
+// One channel for one frame: the sample is held for PDM_OSR bits, the first
+// one in the LSB. x5 is quantized before the update, and each stage takes
+// the new value of the stage before it and the old one of its resonator.
+static inline uint32_t modulate_frame(int32_t *x, int32_t in) {
+  int32_t x1 = x[0], x2 = x[1], x3 = x[2], x4 = x[3], x5 = x[4];
+  const int32_t in_high = in - A1;
+  const int32_t in_low = in + A1;
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < PDM_OSR; ++i) {
+    if (0 <= x5) {
+      bits |= 1u << i;
+      x1 += in_high;
+      x2 += (x1 >> X1_SHIFT) - (x3 >> G1_SHIFT) - A2;
+      x3 += x2 - A3;
+      x4 += x3 - (x5 >> G2_SHIFT) - A4;
+      x5 += x4 - A5;
+    } else {
+      x1 += in_low;
+      x2 += (x1 >> X1_SHIFT) - (x3 >> G1_SHIFT) + A2;
+      x3 += x2 + A3;
+      x4 += x3 - (x5 >> G2_SHIFT) + A4;
+      x5 += x4 + A5;
+    }
+  }
+  x[0] = x1;
+  x[1] = x2;
+  x[2] = x3;
+  x[3] = x4;
+  x[4] = x5;
+  return bits;
+}
+
+// Input scaled to the loop; history holds the last two, newest first
+static inline int32_t compensate_droop(int32_t *history, int32_t in) {
+  const int32_t x1 = history[0];
+  const int32_t x2 = history[1];
+  history[1] = x1;
+  history[0] = in;
+  return x1 + (((2 * x1 - x2 - in) * DROOP_MUL) >> DROOP_SHIFT);
+}
+
+// 16 bits spread to the even bit positions of a word
+static inline uint32_t spread16(uint32_t v) {
+  v = (v | (v << 8)) & 0x00FF00FFu;
+  v = (v | (v << 4)) & 0x0F0F0F0Fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+uint32_t pdm_modulate(pdm_modulator_t *mod, const int32_t *src,
+                      uint32_t frames, uint32_t channels, uint32_t *dst) {
+  for (uint32_t i = 0; i < frames; ++i, src += channels) {
+    // Full scale to half the input range of the loop, A1 / 2, less the
+    // headroom of the droop compensation
+    const uint32_t l = modulate_frame(
+        mod->state[0],
+        compensate_droop(mod->history[0],
+                         (int32_t)(((int64_t)src[0] * IN_GAIN) >> 32)));
+    const uint32_t r = modulate_frame(
+        mod->state[1],
+        compensate_droop(mod->history[1],
+                         (int32_t)(((int64_t)src[1] * IN_GAIN) >> 32)));
+    dst[0] = spread16(l & 0xFFFF) | spread16(r & 0xFFFF) << 1;
+    dst[1] = spread16(l >> 16) | spread16(r >> 16) << 1;
+    dst += PDM_WORDS_PER_FRAME;
+
+    for (uint32_t ch = 0; ch < 2; ++ch) {
+      const int32_t x5 = mod->state[ch][PDM_ORDER - 1];
+      if (x5 < -X5_LIMIT || X5_LIMIT < x5) {
+        memset(mod->state[ch], 0, sizeof(mod->state[ch]));
+        ++mod->resets;
+      }
+    }
+  }
+  return frames * PDM_WORDS_PER_FRAME;
+}
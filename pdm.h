@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sigma-delta modulator for a 1-bit DAC: one GPIO pin per channel followed
+// by an RC low-pass filter. Each channel becomes a bitstream at PDM_OSR
+// times the sample rate whose quantization noise is pushed above the audio
+// band. The two bitstreams are interleaved for a state machine that drives
+// both pins at once: bit 2n of a word is the n-th left bit, bit 2n + 1 the
+// n-th right bit, first in time in the LSB.
+
+// A frame of one channel fills 32 bits
+#define PDM_OSR 32
+#define PDM_WORDS_PER_FRAME 2
+#define PDM_ORDER 5
+
+typedef struct {
+  int32_t state[2][PDM_ORDER];
+  // Last two loop inputs of each channel, newest first, for the droop
+  // compensation
+  int32_t history[2][2];
+  // Times a loop went unstable and was cleared. Any input up to full
+  // scale keeps it stable, so this stays 0 unless something is broken.
+  uint32_t resets;
+} pdm_modulator_t;
+
+void pdm_modulator_init(pdm_modulator_t *mod);
+
+// Modulates frames of left-justified int32 samples, the first two channels
+// of each frame, into PDM_WORDS_PER_FRAME words per frame. channels is the
+// stride between frames in src; 0 repeats the first frame, which modulates
+// silence from a single zero frame. Each sample is held for a frame, and a
+// 3-tap filter ahead of the loop lifts the resulting high-frequency droop
+// back to within 0.5dB up to 20kHz at 48kHz, one frame later. Full scale
+// spans 31 to 69% ones, and the lift takes it to at most 25 to 75%, about
+// as much as a fifth-order 1-bit loop takes without going unstable.
+// Returns the number of words written to dst.
+uint32_t pdm_modulate(pdm_modulator_t *mod, const int32_t *src,
+                      uint32_t frames, uint32_t channels, uint32_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,7 +27,7 @@ void ringbuffer_clear(ringbuffer_t *rb) {
   rb->full = false;
 }
 
-static size_t ringbuffer_count(const ringbuffer_t *rb) {
+size_t ringbuffer_count(const ringbuffer_t *rb) {
   assert(rb != NULL);
 
   if (rb->full) return rb->size;
@@ -79,6 +79,18 @@ size_t ringbuffer_read(ringbuffer_t *rb, uint8_t *data, size_t bytes) {
   return bytes;
 }
 
+size_t ringbuffer_skip(ringbuffer_t *rb, size_t bytes) {
+  assert(rb != NULL);
+
+  size_t count = ringbuffer_count(rb);
+  if (count < bytes) bytes = count;
+  if (bytes == 0) return 0;
+  rb->head += bytes;
+  if (rb->size <= rb->head) rb->head -= rb->size;
+  rb->full = false;
+  return bytes;
+}
+
 float ringbuffer_fill_ratio(const ringbuffer_t *rb) {
   assert(rb != NULL);
   assert(rb->size > 0);
@@ -105,6 +117,42 @@ int ringbuffer_resize(ringbuffer_t *rb, size_t new_size) {
   return 0;
 }
 
+int ringbuffer_resize_keep(ringbuffer_t *rb, size_t new_size) {
+  assert(rb != NULL);
+  assert(new_size > 0);
+
+  size_t count = ringbuffer_count(rb);
+  if (new_size < count) return -1;
+  if (new_size == rb->size) return 0;
+  if (rb->capacity < new_size) {
+    uint8_t *new_buf = (uint8_t *)realloc(rb->buffer, new_size);
+    if (!new_buf) return -1;
+    rb->buffer = new_buf;
+    rb->capacity = new_size;
+  }
+
+  if (count == 0) {
+    rb->head = 0;
+    rb->tail = 0;
+  } else if (rb->head < rb->tail) {
+    // 折り返していない。新しいサイズに収まらなければ先頭へ詰める
+    if (new_size < rb->tail) {
+      memmove(rb->buffer, rb->buffer + rb->head, count);
+      rb->head = 0;
+      rb->tail = count;
+    }
+  } else {
+    // 折り返している（満杯を含む）。[head, size) を新しい末尾へ移す
+    size_t right = rb->size - rb->head;
+    memmove(rb->buffer + new_size - right, rb->buffer + rb->head, right);
+    rb->head = new_size - right;
+  }
+  rb->size = new_size;
+  if (rb->tail == new_size) rb->tail = 0;
+  rb->full = count == new_size;
+  return 0;
+}
+
 void ringbuffer_free(ringbuffer_t *rb) {
   assert(rb != NULL);
 
@@ -25,11 +25,17 @@ void ringbuffer_clear(ringbuffer_t *rb);
 size_t ringbuffer_write(ringbuffer_t *rb, const uint8_t *data, size_t bytes);
 // 読み込み（バイト数指定）
 size_t ringbuffer_read(ringbuffer_t *rb, uint8_t *data, size_t bytes);
+// 読み捨て（バイト数指定）
+size_t ringbuffer_skip(ringbuffer_t *rb, size_t bytes);
+// 格納済みバイト数
+size_t ringbuffer_count(const ringbuffer_t *rb);
 // 充填率
 float ringbuffer_fill_ratio(const ringbuffer_t *rb);
 
 // 再初期化（サイズ変更）
 int ringbuffer_resize(ringbuffer_t *rb, size_t new_size);
+// 内容を保ったままサイズ変更（格納済みバイト数より小さくはできない）
+int ringbuffer_resize_keep(ringbuffer_t *rb, size_t new_size);
 // バッファ解放
 void ringbuffer_free(ringbuffer_t *rb);
 
@@ -0,0 +1,218 @@
+#include "sample_format.h"
+
+#include <string.h>
+
+uint32_t sample_format_unpack_16(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst) {
+  // One word holds a frame: L in the lower and R in the upper half
+  const uint32_t frames = bytes / 4;
+  const uint32_t *words = (const uint32_t *)src;
+  for (uint32_t i = 0; i < frames; ++i) {
+    const uint32_t w = words[i];
+    dst[2 * i] = (int32_t)(w << 16);
+    dst[2 * i + 1] = (int32_t)(w & 0xFFFF0000);
+  }
+  return frames * 2;
+}
+
+uint32_t sample_format_unpack_24in32(const uint8_t *src, uint32_t bytes,
+                                     int32_t *dst) {
+  // Already left-justified; the padding byte is cleared
+  const uint32_t samples = bytes / 4;
+  const uint32_t *words = (const uint32_t *)src;
+  for (uint32_t i = 0; i < samples; ++i) {
+    dst[i] = (int32_t)(words[i] & 0xFFFFFF00);
+  }
+  return samples;
+}
+
+uint32_t sample_format_unpack_24(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst) {
+  const uint32_t samples = bytes / 3;
+  uint32_t i = 0;
+
+  // The M0+ faults on unaligned loads, so the word path needs an aligned
+  // start. Four samples span exactly three words:
+  //   w0 = a0 a1 a2 b0, w1 = b1 b2 c0 c1, w2 = c2 d0 d1 d2
+  if (((uintptr_t)src & 3) == 0) {
+    const uint32_t *words = (const uint32_t *)src;
+    for (; i + 4 <= samples; i += 4, words += 3) {
+      const uint32_t w0 = words[0];
+      const uint32_t w1 = words[1];
+      const uint32_t w2 = words[2];
+      dst[i] = (int32_t)(w0 << 8);
+      dst[i + 1] = (int32_t)(((w0 >> 16) & 0xFF00) | (w1 << 16));
+      dst[i + 2] = (int32_t)(((w1 >> 8) & 0xFFFF00) | (w2 << 24));
+      dst[i + 3] = (int32_t)(w2 & 0xFFFFFF00);
+    }
+  }
+
+  for (; i < samples; ++i) {
+    const uint8_t *p = &src[3 * i];
+    dst[i] = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                       ((uint32_t)p[2] << 24));
+  }
+  return samples;
+}
+
+uint32_t sample_format_unpack_32(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst) {
+  const uint32_t samples = bytes / 4;
+  memcpy(dst, src, samples * sizeof(int32_t));
+  return samples;
+}
+
+uint32_t sample_format_pack_16(const int32_t *src, uint32_t num_samples,
+                               uint32_t shift, uint8_t *dst) {
+  // The mirror of unpack_16: L in the lower and R in the upper half
+  const uint32_t frames = num_samples / 2;
+  uint32_t *words = (uint32_t *)dst;
+  for (uint32_t i = 0; i < frames; ++i) {
+    const uint32_t l = (uint32_t)src[2 * i] << shift;
+    const uint32_t r = (uint32_t)src[2 * i + 1] << shift;
+    words[i] = (l >> 16) | (r & 0xFFFF0000);
+  }
+  return frames * 4;
+}
+
+uint32_t sample_format_pack_24in32(const int32_t *src, uint32_t num_samples,
+                                   uint32_t shift, uint8_t *dst) {
+  uint32_t *words = (uint32_t *)dst;
+  for (uint32_t i = 0; i < num_samples; ++i) {
+    words[i] = ((uint32_t)src[i] << shift) & 0xFFFFFF00;
+  }
+  return num_samples * 4;
+}
+
+// value * 2^31 = 1.mantissa * 2^(exponent - 127 + 31). With the implicit
+// bit the 24-bit mantissa is already scaled by 2^23, so it is shifted left by
+// exponent - 119. Exponent 127 and above means |value| >= 1.0.
+static inline int32_t float32_to_int32(uint32_t u) {
+  const uint32_t exponent = (u >> 23) & 0xFF;
+  uint32_t magnitude;
+  if (127 <= exponent) {
+    if (exponent == 0xFF && (u & 0x7FFFFF)) {
+      return 0;  // NaN
+    }
+    return (u & 0x80000000) ? INT32_MIN : INT32_MAX;
+  } else if (119 <= exponent) {
+    magnitude = ((u & 0x7FFFFF) | 0x800000) << (exponent - 119);
+  } else if (96 <= exponent) {
+    magnitude = ((u & 0x7FFFFF) | 0x800000) >> (119 - exponent);
+  } else {
+    return 0;  // Below one LSB, including zero and denormals
+  }
+  return (u & 0x80000000) ? -(int32_t)magnitude : (int32_t)magnitude;
+}
+
+uint32_t sample_format_unpack_float32(const uint8_t *src, uint32_t bytes,
+                                      int32_t *dst) {
+  const uint32_t samples = bytes / 4;
+  const uint32_t *words = (const uint32_t *)src;
+  for (uint32_t i = 0; i < samples; ++i) {
+    dst[i] = float32_to_int32(words[i]);
+  }
+  return samples;
+}
+
+uint32_t sample_format_unpack_dsd(const uint8_t *src, uint32_t bytes,
+                                  int32_t *dst) {
+  const uint32_t samples = bytes / 4;
+  const uint32_t *words = (const uint32_t *)src;
+  for (uint32_t i = 0; i < samples; ++i) {
+    // One REV instruction on the M0+
+    dst[i] = (int32_t)__builtin_bswap32(words[i]);
+  }
+  return samples;
+}
+
+// spread_lut[b] has bit j of b at bit j * spread_lut_lines. Built on first
+// use in RAM: the M0+ has no bit-deposit instruction, and a table load beats
+// the shift-and-mask sequence per byte.
+static uint32_t spread_lut[256];
+static uint32_t spread_lut_lines = 0;
+
+static void build_spread_lut(uint32_t lines) {
+  for (uint32_t b = 0; b < 256; ++b) {
+    uint32_t v = 0;
+    for (uint32_t j = 0; j < 8; ++j) {
+      v |= ((b >> j) & 1u) << (j * lines);
+    }
+    spread_lut[b] = v;
+  }
+  spread_lut_lines = lines;
+}
+
+// Byte n (0: MSB) of each line's sample, interleaved
+#define SPREAD2(s, n)                                     \
+  ((spread_lut[((s)[1] >> (24 - 8 * (n))) & 0xFF] << 1) | \
+   spread_lut[((s)[0] >> (24 - 8 * (n))) & 0xFF])
+#define SPREAD3(s, n)                                     \
+  ((spread_lut[((s)[2] >> (24 - 8 * (n))) & 0xFF] << 2) | \
+   (spread_lut[((s)[1] >> (24 - 8 * (n))) & 0xFF] << 1) | \
+   spread_lut[((s)[0] >> (24 - 8 * (n))) & 0xFF])
+#define SPREAD4(s, n)                                     \
+  ((spread_lut[((s)[3] >> (24 - 8 * (n))) & 0xFF] << 3) | \
+   (spread_lut[((s)[2] >> (24 - 8 * (n))) & 0xFF] << 2) | \
+   (spread_lut[((s)[1] >> (24 - 8 * (n))) & 0xFF] << 1) | \
+   spread_lut[((s)[0] >> (24 - 8 * (n))) & 0xFF])
+
+uint32_t sample_format_pack_lines(const int32_t *src, uint32_t frames,
+                                  uint32_t channels, uint32_t lines,
+                                  uint32_t *dst) {
+  if (1 < lines && spread_lut_lines != lines) {
+    build_spread_lut(lines);
+  }
+
+  uint32_t *out = dst;
+  for (uint32_t i = 0; i < frames; ++i, src += channels) {
+    for (uint32_t half = 0; half < 2; ++half) {
+      uint32_t s[4] = {0, 0, 0, 0};
+      for (uint32_t k = 0; k < lines; ++k) {
+        const uint32_t ch = 2 * k + half;
+        if (ch < channels) {
+          s[k] = (uint32_t)src[ch];
+        }
+      }
+      switch (lines) {
+        case 2:
+          out[0] = (SPREAD2(s, 0) << 16) | SPREAD2(s, 1);
+          out[1] = (SPREAD2(s, 2) << 16) | SPREAD2(s, 3);
+          out += 2;
+          break;
+        case 3:
+          out[0] = SPREAD3(s, 0) << 8;
+          out[1] = SPREAD3(s, 1) << 8;
+          out[2] = SPREAD3(s, 2) << 8;
+          out[3] = SPREAD3(s, 3) << 8;
+          out += 4;
+          break;
+        case 4:
+          out[0] = SPREAD4(s, 0);
+          out[1] = SPREAD4(s, 1);
+          out[2] = SPREAD4(s, 2);
+          out[3] = SPREAD4(s, 3);
+          out += 4;
+          break;
+        default:
+          *out++ = s[0];
+          break;
+      }
+    }
+  }
+  return (uint32_t)(out - dst);
+}
+
+uint32_t sample_format_pack_dsd(const int32_t *src, uint32_t frames,
+                                uint32_t *dst) {
+  // The two-line spread: right is line 0, left line 1
+  if (spread_lut_lines != 2) {
+    build_spread_lut(2);
+  }
+  for (uint32_t i = 0; i < frames; ++i, src += 2, dst += 2) {
+    const uint32_t s[2] = {(uint32_t)src[1], (uint32_t)src[0]};
+    dst[0] = (SPREAD2(s, 0) << 16) | SPREAD2(s, 1);
+    dst[1] = (SPREAD2(s, 2) << 16) | SPREAD2(s, 3);
+  }
+  return frames * 2;
+}
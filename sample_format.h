@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Conversions from USB audio payloads to the ring buffer format: int32
+// samples, left-justified, interleaved L/R. Each returns the number of
+// samples written to dst, which must hold one int32_t per input sample.
+
+// 16-bit PCM in 2-byte subslots
+uint32_t sample_format_unpack_16(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst);
+
+// 24-bit PCM in the upper bytes of 4-byte subslots
+uint32_t sample_format_unpack_24in32(const uint8_t *src, uint32_t bytes,
+                                     int32_t *dst);
+
+// 24-bit PCM in 3-byte subslots. Whole groups of four samples are read as
+// three aligned words when src is word aligned.
+uint32_t sample_format_unpack_24(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst);
+
+// 32-bit PCM in 4-byte subslots
+uint32_t sample_format_unpack_32(const uint8_t *src, uint32_t bytes,
+                                 int32_t *dst);
+
+// IEEE 754 single precision, full scale at +-1.0. Converted with integer
+// operations only (the M0+ has no FPU) and truncated toward zero. Values at
+// or beyond full scale and infinities clamp; NaNs and denormals become 0.
+uint32_t sample_format_unpack_float32(const uint8_t *src, uint32_t bytes,
+                                      int32_t *dst);
+
+// Native DSD in 4-byte subslots (RAW_DATA, DSD_U32_BE on the host): 32 DSD
+// bits per channel and frame, the first byte on the wire first. Each word is
+// byte-swapped so that the first bit lands in the MSB.
+uint32_t sample_format_unpack_dsd(const uint8_t *src, uint32_t bytes,
+                                  int32_t *dst);
+
+// Conversions the other way, from captured samples to USB audio payloads.
+// Each sample holds its significant bits in the low bits; shift moves them up
+// to the MSB. Each returns the number of bytes written to dst, which must be
+// word aligned.
+
+// Stereo frames to 16-bit PCM in 2-byte subslots. num_samples is even.
+uint32_t sample_format_pack_16(const int32_t *src, uint32_t num_samples,
+                               uint32_t shift, uint8_t *dst);
+
+// To 24-bit PCM in the upper bytes of 4-byte subslots, padding byte cleared
+uint32_t sample_format_pack_24in32(const int32_t *src, uint32_t num_samples,
+                                   uint32_t shift, uint8_t *dst);
+
+// Transposes frames of int32 samples (channels per frame, interleaved) into
+// the words of an I2S state machine that drives `lines` adjacent data pins
+// with `out pins, lines` and 32-bit slots. Channel pair k goes to line k;
+// missing pairs are silent and channels beyond 2 * lines are dropped.
+// Each frame takes the left slots of all lines, then the right slots:
+//   1 line:  1 word per slot, the sample itself
+//   2 lines: 2 words per slot, 16 bit periods each
+//   3 lines: 4 words per slot, 8 bit periods in the upper 24 bits
+//   4 lines: 4 words per slot, 8 bit periods each
+// Within a bit period line k is bit k, the first period in the MSBs.
+// Returns the number of words written to dst.
+uint32_t sample_format_pack_lines(const int32_t *src, uint32_t frames,
+                                  uint32_t channels, uint32_t lines,
+                                  uint32_t *dst);
+
+// The DSD idle pattern, as unpacked by sample_format_unpack_dsd(). Hosts
+// send it for silence; all-zero DSD is full negative scale instead.
+#define SAMPLE_FORMAT_DSD_IDLE 0x69696969u
+// A packed DSD word of silence: the idle pattern on both channels
+#define SAMPLE_FORMAT_DSD_SILENCE 0x3CC33CC3u
+
+// Packs unpacked native DSD stereo frames into two words per frame for a
+// state machine that drives right and left on adjacent pins with
+// `out pins, 2`: bit 2n + 1 of a bit period pair is left, bit 2n right, the
+// first period in the MSBs of the first word.
+// Returns the number of words written to dst.
+uint32_t sample_format_pack_dsd(const int32_t *src, uint32_t frames,
+                                uint32_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
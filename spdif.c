@@ -0,0 +1,212 @@
+#include "spdif.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+// Preambles after a low cell, first cell in the MSB. Each ends low again.
+#define PREAMBLE_B 0xE8u  // Left, first frame of a block
+#define PREAMBLE_M 0xE2u  // Left
+#define PREAMBLE_W 0xE4u  // Right
+
+// Time slot of the channel status bit, counted from the first data slot
+#define SLOT_C 26
+
+// bmc_lut[b] holds the 16 cells of byte b, LSB first, starting after a low
+// cell. Every bit starts with a transition and a 1 has another one in the
+// middle, so the cells of a byte that starts after a high cell are the
+// complement, and the last cell tells how the next byte starts. Built on
+// first use in RAM, which is faster to read than flash.
+static uint16_t bmc_lut[256];
+static bool bmc_lut_ready = false;
+
+static void build_bmc_lut(void) {
+  for (uint32_t b = 0; b < 256; ++b) {
+    uint32_t level = 0;
+    uint32_t cells = 0;
+    for (uint32_t j = 0; j < 8; ++j) {
+      level ^= 1;
+      cells = (cells << 1) | level;
+      level ^= (b >> j) & 1;
+      cells = (cells << 1) | level;
+    }
+    bmc_lut[b] = (uint16_t)cells;
+  }
+  bmc_lut_ready = true;
+}
+
+// 0xFFFF when the last cell of c is high, to complement the next byte
+static inline uint32_t level_mask(uint32_t c) {
+  return (0u - (c & 1)) & 0xFFFF;
+}
+
+// One subframe into two words. d holds the 28 data slots, LSB first: the
+// 24-bit sample, then validity (0), user (0), channel status and parity.
+// The preamble and the first nibble fill the upper half of the first word.
+//
+// Every 0 slot moves the line level and every 1 keeps it, so even parity
+// over the 28 slots is the same as ending on the level the data started
+// on, which is low. Encoding the parity slot as 0 and forcing its last cell
+// low therefore gives the parity without counting bits.
+static inline uint32_t *encode_subframe(uint32_t *dst, uint32_t preamble,
+                                        uint32_t d) {
+  const uint32_t c0 = (preamble << 8) | (bmc_lut[d & 0xF] >> 8);
+  const uint32_t c1 = bmc_lut[(d >> 4) & 0xFF] ^ level_mask(c0);
+  const uint32_t c2 = bmc_lut[(d >> 12) & 0xFF] ^ level_mask(c1);
+  const uint32_t c3 = bmc_lut[d >> 20] ^ level_mask(c2);
+  dst[0] = (c0 << 16) | c1;
+  dst[1] = (c2 << 16) | (c3 & ~1u);
+  return dst + 2;
+}
+
+// Sampling frequency code of channel status byte 3
+static uint8_t rate_code(uint32_t sample_rate) {
+  switch (sample_rate) {
+    case 44100:
+      return 0x00;
+    case 48000:
+      return 0x02;
+    case 32000:
+      return 0x03;
+    case 88200:
+      return 0x08;
+    case 96000:
+      return 0x0A;
+    case 176400:
+      return 0x0C;
+    case 192000:
+      return 0x0E;
+    default:
+      return 0x01;  // Not indicated
+  }
+}
+
+void spdif_encoder_init(spdif_encoder_t *enc, uint32_t sample_rate,
+                        uint32_t bit_depth) {
+  if (!bmc_lut_ready) {
+    build_bmc_lut();
+  }
+  const uint32_t bits = bit_depth < 24 ? bit_depth : 24;
+  enc->sample_mask = ~0u << (32 - bits);
+  enc->frame = 0;
+
+  memset(enc->channel_status, 0, sizeof(enc->channel_status));
+  // Consumer, PCM, copying permitted, no pre-emphasis
+  enc->channel_status[0] = 0x04;
+  // Category general, source and channel numbers not given
+  enc->channel_status[3] = rate_code(sample_rate);
+  // Word length: 24 bits of a 24-bit maximum, or 16 of 20
+  enc->channel_status[4] = bits == 24 ? 0x0B : 0x02;
+}
+
+uint32_t spdif_encode(spdif_encoder_t *enc, const int32_t *src,
+                      uint32_t frames, uint32_t channels, uint32_t *dst) {
+  const uint32_t mask = enc->sample_mask;
+  uint32_t frame = enc->frame;
+  for (uint32_t i = 0; i < frames; ++i, src += channels) {
+    const uint32_t c =
+        ((enc->channel_status[frame >> 3] >> (frame & 7)) & 1u) << SLOT_C;
+    dst = encode_subframe(dst, frame == 0 ? PREAMBLE_B : PREAMBLE_M,
+                          (((uint32_t)src[0] & mask) >> 8) | c);
+    dst = encode_subframe(dst, PREAMBLE_W,
+                          (((uint32_t)src[1] & mask) >> 8) | c);
+    if (++frame == SPDIF_BLOCK_FRAMES) {
+      frame = 0;
+    }
+  }
+  enc->frame = frame;
+  return frames * SPDIF_WORDS_PER_FRAME;
+}
+
+void spdif_decoder_init(spdif_decoder_t *dec) {
+  memset(dec, 0, sizeof(*dec));
+  dec->frame = SPDIF_BLOCK_FRAMES + 1;
+}
+
+static void bad_frame(spdif_decoder_t *dec) {
+  dec->good = 0;
+  if (++dec->bad == SPDIF_UNLOCK_FRAMES) {
+    dec->locked = false;
+  }
+}
+
+// Channel status bit of a left subframe. A block is complete when the next
+// B preamble comes exactly SPDIF_BLOCK_FRAMES frames after the last one.
+static void collect_channel_status(spdif_decoder_t *dec, bool block_start,
+                                   uint32_t c) {
+  if (block_start) {
+    if (dec->frame == SPDIF_BLOCK_FRAMES) {
+      memcpy(dec->channel_status, dec->block, sizeof(dec->block));
+      dec->channel_status_valid = true;
+    }
+    dec->frame = 0;
+  }
+  if (SPDIF_BLOCK_FRAMES <= dec->frame) {
+    dec->frame = SPDIF_BLOCK_FRAMES + 1;
+    return;
+  }
+  const uint8_t bit = 1u << (dec->frame & 7);
+  if (c) {
+    dec->block[dec->frame >> 3] |= bit;
+  } else {
+    dec->block[dec->frame >> 3] &= ~bit;
+  }
+  ++dec->frame;
+}
+
+// A slot edge goes against the level sampled in the slot before, so a slot
+// sampled at the same level as the slot before turned again in its middle:
+// a 1. Slot 0 follows the low end of the preamble. The last level is the
+// level the subframe ends on, low when the parity is even (see
+// encode_subframe()), which is the sign bit of the word.
+uint32_t spdif_decode(spdif_decoder_t *dec, const uint32_t *src,
+                      uint32_t words, int32_t *dst) {
+  uint32_t frames = 0;
+  for (uint32_t i = 0; i < words; ++i) {
+    const uint32_t w = src[i];
+    const uint32_t levels = w >> SPDIF_RX_WORD_DATA_SHIFT;
+    const uint32_t d = ~(levels ^ (levels << 1)) & 0x0FFFFFFF;
+    const bool ok = (int32_t)w >= 0;
+    const int32_t sample = (int32_t)(d << 8);
+    if ((w & SPDIF_RX_WORD_B) && (w & SPDIF_RX_WORD_M)) {
+      ++dec->bad_subframes;
+      dec->left_pending = false;
+      bad_frame(dec);
+    } else if (w & (SPDIF_RX_WORD_B | SPDIF_RX_WORD_M)) {
+      if (dec->left_pending) {
+        ++dec->bad_subframes;  // The right subframe was lost
+        bad_frame(dec);
+      }
+      dec->left = sample;
+      dec->left_ok = ok;
+      dec->left_pending = true;
+      dec->bad_subframes += !ok;
+      collect_channel_status(dec, w & SPDIF_RX_WORD_B, (d >> SLOT_C) & 1);
+    } else if (dec->left_pending) {
+      dec->left_pending = false;
+      dec->bad_subframes += !ok;
+      if (dec->left_ok && ok) {
+        dec->last[0] = dec->left;
+        dec->last[1] = sample;
+        dec->bad = 0;
+        if (++dec->good == SPDIF_LOCK_FRAMES) {
+          dec->locked = true;
+        }
+      } else {
+        bad_frame(dec);
+      }
+      if (dec->locked) {
+        // Byte 0 bit 1: not linear PCM
+        const bool audio =
+            !(dec->channel_status_valid && (dec->channel_status[0] & 0x02));
+        dst[0] = audio ? dec->last[0] : 0;
+        dst[1] = audio ? dec->last[1] : 0;
+        dst += 2;
+        ++frames;
+      }
+    } else {
+      ++dec->bad_subframes;  // A right subframe without a left one
+      bad_frame(dec);
+    }
+  }
+  return frames;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// S/PDIF (IEC 60958, consumer format) encoder and decoder. A frame is two
+// subframes of 32 time slots, each slot two biphase-mark cells: 128 cells,
+// which the encoder packs into 4 words, the first cell in the MSB of the
+// first word. The output line is meant to idle low; every frame starts and
+// ends there.
+
+// Frames per channel status block
+#define SPDIF_BLOCK_FRAMES 192
+#define SPDIF_CELLS_PER_FRAME 128
+#define SPDIF_WORDS_PER_FRAME 4
+
+typedef struct {
+  // Channel status bit n of the block is bit n % 8 of byte n / 8. Both
+  // subframes carry the same bits.
+  uint8_t channel_status[SPDIF_BLOCK_FRAMES / 8];
+  // Position of the next frame in the channel status block. It may be set
+  // to place the next encoded frame elsewhere in the block.
+  uint32_t frame;
+  // Sample bits that are sent, the upper 16 or 24
+  uint32_t sample_mask;
+} spdif_encoder_t;
+
+// Sets up the channel status for the rate and bit depth (16, 24 or 32;
+// 32-bit samples are sent as 24 bits) and starts a new block. The first
+// call also builds the biphase-mark lookup table.
+void spdif_encoder_init(spdif_encoder_t *enc, uint32_t sample_rate,
+                        uint32_t bit_depth);
+
+// Encodes frames of left-justified int32 samples, the first two channels of
+// each frame, into SPDIF_WORDS_PER_FRAME words per frame. channels is the
+// stride between frames in src; 0 repeats the first frame, which encodes
+// silence from a single zero frame. Preambles, channel status and parity
+// are included. Returns the number of words written to dst.
+uint32_t spdif_encode(spdif_encoder_t *enc, const int32_t *src,
+                      uint32_t frames, uint32_t channels, uint32_t *dst);
+
+// --- Decoder ---
+
+// Words of the receiver (spdif_rx.pio), one per subframe. The preamble bits
+// are set for B and M and clear for W. The data bits are the line levels
+// sampled in the 28 data slots, not the slots themselves.
+#define SPDIF_RX_WORD_B (1u << 2)
+#define SPDIF_RX_WORD_M (1u << 3)
+#define SPDIF_RX_WORD_DATA_SHIFT 4
+
+// Good frames in a row before the decoder locks, and bad ones before it
+// lets go. A bad frame has a parity error, a preamble out of order or an
+// invalid preamble.
+#define SPDIF_LOCK_FRAMES 32
+#define SPDIF_UNLOCK_FRAMES 16
+
+typedef struct {
+  bool locked;
+  uint32_t good;  // Good frames in a row
+  uint32_t bad;   // Bad frames in a row
+  // Left subframe waiting for its right one
+  bool left_pending;
+  bool left_ok;
+  int32_t left;
+  // Last good frame, played again in place of a bad one
+  int32_t last[2];
+  // Position in the channel status block being collected, above
+  // SPDIF_BLOCK_FRAMES until a B preamble starts one
+  uint32_t frame;
+  uint8_t block[SPDIF_BLOCK_FRAMES / 8];
+  // Last complete channel status block, laid out as in spdif_encoder_t
+  uint8_t channel_status[SPDIF_BLOCK_FRAMES / 8];
+  bool channel_status_valid;
+  uint32_t bad_subframes;  // Since spdif_decoder_init()
+} spdif_decoder_t;
+
+void spdif_decoder_init(spdif_decoder_t *dec);
+
+// Decodes receiver words into frames of two left-justified int32 samples
+// (24 bits). Nothing is written until the decoder locks; after that every
+// left/right pair gives a frame, the last good one if either half was bad.
+// A stream marked non-audio in its channel status decodes as silence.
+// Returns the number of frames written to dst, at most (words + 1) / 2.
+uint32_t spdif_decode(spdif_decoder_t *dec, const uint32_t *src,
+                      uint32_t words, int32_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
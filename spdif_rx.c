@@ -0,0 +1,247 @@
+#include "spdif_rx.h"
+
+#include <string.h>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "pico/assert.h"
+#include "spdif.h"
+#include "spdif_rx.pio.h"
+
+// Capture ring written by DMA, one word per subframe (5.3ms at 96kHz). Must
+// be a power of two and aligned to its size
+#define SPDIF_RX_BUFFER_WORDS 1024
+#define SPDIF_RX_BUFFER_RING_BITS 12  // log2(1024 * 4 bytes)
+
+// Restart the DMA transfer before its counter runs out (~6 hours at 96kHz)
+#define SPDIF_RX_TRANSFER_COUNT 0xFFFFFFFFu
+#define SPDIF_RX_REARM_THRESHOLD 0x10000000u
+
+// Time given to each clock divider and polarity while searching
+#define SPDIF_RX_SEARCH_US 20000
+// The frame rate is counted over windows of this length
+#define SPDIF_RX_RATE_WINDOW_US 100000
+// Largest deviation of the counted rate from the nominal one it is taken
+// for. 44.1 and 48kHz are 8.8% apart.
+#define SPDIF_RX_RATE_TOLERANCE_PPM 20000
+// The line is lost when the receiver finds no preamble for this long
+#define SPDIF_RX_LOSS_US 5000
+
+// One clock divider receives both rates of a pair: it is set for their
+// geometric mean, and the sampling points stay inside their cells for
+// either. The rate itself is then measured.
+static const uint32_t family_rates[2][2] = {{44100, 48000}, {88200, 96000}};
+static const uint32_t family_center_hz[2] = {46009, 92017};
+
+// Module-level state
+static PIO pio_instance = NULL;
+static uint sm = 0;
+static uint pio_offset = 0;
+static uint dma_channel = 0;
+static uint rx_pin = 0;
+
+static uint32_t capture_buffer[SPDIF_RX_BUFFER_WORDS]
+    __attribute__((aligned(SPDIF_RX_BUFFER_WORDS * sizeof(uint32_t))));
+
+static uint32_t read_total = 0;  // Words consumed
+static spdif_decoder_t decoder;
+static bool decoder_locked = false;  // As of the previous task call
+
+// Search position: bit 0 selects the rate pair, bit 1 the inverted input
+static uint32_t setting = 0;
+static uint64_t setting_start_us = 0;
+static uint64_t last_word_us = 0;
+
+static uint64_t window_start_us = 0;
+static uint32_t window_frames = 0;
+
+static spdif_rx_stats_t stats;
+
+static uint32_t clkdiv_q8(uint32_t family) {
+  const uint32_t div_q8 = (uint32_t)(
+      ((uint64_t)clock_get_hz(clk_sys) << 8) /
+      (SPDIF_RX_CYCLES_PER_CELL * SPDIF_CELLS_PER_FRAME *
+       family_center_hz[family]));
+  assert(256 <= div_q8);
+  return div_q8;
+}
+
+static void dma_restart() {
+  dma_channel_abort(dma_channel);
+  dma_channel_set_write_addr(dma_channel, capture_buffer, false);
+  dma_channel_set_trans_count(dma_channel, SPDIF_RX_TRANSFER_COUNT, true);
+  read_total = 0;
+}
+
+// Restarts the capture with the current search setting
+static void apply_setting() {
+  const uint32_t family = setting & 1;
+  stats.inverted = setting & 2;
+
+  pio_sm_set_enabled(pio_instance, sm, false);
+  gpio_set_inover(rx_pin, stats.inverted ? GPIO_OVERRIDE_INVERT
+                                         : GPIO_OVERRIDE_NORMAL);
+  const uint32_t div_q8 = clkdiv_q8(family);
+  pio_sm_set_clkdiv_int_frac(pio_instance, sm, div_q8 >> 8, div_q8 & 0xff);
+  pio_sm_clear_fifos(pio_instance, sm);
+  pio_sm_restart(pio_instance, sm);
+  pio_sm_clkdiv_restart(pio_instance, sm);
+  pio_sm_exec(pio_instance, sm,
+              pio_encode_jmp(pio_offset + spdif_rx_offset_hunt));
+  dma_restart();
+  pio_sm_set_enabled(pio_instance, sm, true);
+
+  spdif_decoder_init(&decoder);
+  decoder_locked = false;
+  setting_start_us = time_us_64();
+  last_word_us = setting_start_us;
+}
+
+// Nominal rate of the current pair within the tolerance, or 0
+static uint32_t match_rate(uint32_t measured) {
+  for (uint32_t i = 0; i < 2; ++i) {
+    const uint32_t nominal = family_rates[setting & 1][i];
+    const uint32_t diff =
+        measured < nominal ? nominal - measured : measured - nominal;
+    if ((uint64_t)diff * 1000000 <=
+        (uint64_t)nominal * SPDIF_RX_RATE_TOLERANCE_PPM) {
+      return nominal;
+    }
+  }
+  return 0;
+}
+
+static void lose_lock() {
+  stats.locked = false;
+  stats.sample_rate = 0;
+  spdif_decoder_init(&decoder);
+  decoder_locked = false;
+}
+
+void spdif_rx_init(PIO pio, uint pin) {
+  assert(pio_instance == NULL);
+
+  pio_instance = pio;
+  rx_pin = pin;
+  pio_offset = pio_add_program(pio_instance, &spdif_rx_program);
+  sm = pio_claim_unused_sm(pio_instance, true);
+  spdif_rx_program_init(pio_instance, sm, pio_offset, pin, clkdiv_q8(0));
+
+  dma_channel = dma_claim_unused_channel(true);
+  dma_channel_config c = dma_channel_get_default_config(dma_channel);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_ring(&c, true, SPDIF_RX_BUFFER_RING_BITS);
+  channel_config_set_dreq(&c, pio_get_dreq(pio_instance, sm, false));
+  dma_channel_configure(dma_channel, &c, capture_buffer, &pio_instance->rxf[sm],
+                        SPDIF_RX_TRANSFER_COUNT, false);
+
+  memset(&stats, 0, sizeof(stats));
+  setting = 0;
+  apply_setting();
+}
+
+void spdif_rx_deinit() {
+  assert(pio_instance != NULL);
+
+  pio_sm_set_enabled(pio_instance, sm, false);
+  dma_channel_abort(dma_channel);
+  gpio_set_inover(rx_pin, GPIO_OVERRIDE_NORMAL);
+  dma_channel_unclaim(dma_channel);
+  pio_sm_unclaim(pio_instance, sm);
+  pio_remove_program(pio_instance, &spdif_rx_program, pio_offset);
+  pio_instance = NULL;
+  stats.locked = false;
+  stats.sample_rate = 0;
+}
+
+uint32_t spdif_rx_task(int32_t *dst, uint32_t max_frames) {
+  if (pio_instance == NULL) {
+    return 0;
+  }
+
+  const uint64_t now = time_us_64();
+  const uint32_t remaining = dma_hw->ch[dma_channel].transfer_count;
+  const uint32_t written = SPDIF_RX_TRANSFER_COUNT - remaining;
+  if (SPDIF_RX_BUFFER_WORDS < written - read_total) {
+    // The main loop fell behind and the ring was overwritten. The decoder
+    // sees the gap as a lost subframe at most.
+    read_total = written;
+  }
+  if (read_total != written) {
+    last_word_us = now;
+  }
+
+  // Frames from max_frames * 2 words at most, see spdif_decode()
+  uint32_t frames = 0;
+  uint32_t decoded = 0;
+  do {
+    uint32_t words = MIN(written - read_total, 2 * max_frames);
+    frames = 0;
+    while (words) {
+      const uint32_t pos = read_total % SPDIF_RX_BUFFER_WORDS;
+      const uint32_t n = MIN(words, SPDIF_RX_BUFFER_WORDS - pos);
+      frames += spdif_decode(&decoder, &capture_buffer[pos], n,
+                             &dst[frames * 2]);
+      read_total += n;
+      words -= n;
+    }
+    decoded += frames;
+  } while (stats.sample_rate == 0 && read_total != written);
+
+  if (remaining < SPDIF_RX_REARM_THRESHOLD) {
+    // A few subframes are lost, which the decoder conceals
+    dma_restart();
+  }
+
+  if (!decoder.locked) {
+    decoder_locked = false;
+    if (stats.locked) {
+      // Stay on the setting that worked for another search period
+      lose_lock();
+      setting_start_us = now;
+    } else if (SPDIF_RX_SEARCH_US <= now - setting_start_us) {
+      setting = (setting + 1) & 3;
+      apply_setting();
+    }
+    return 0;
+  }
+  if (SPDIF_RX_LOSS_US <= now - last_word_us) {
+    lose_lock();
+    setting_start_us = now;
+    return 0;
+  }
+
+  // The frames of the call that locks came in before the window starts
+  if (!decoder_locked) {
+    decoder_locked = true;
+    decoder.bad_subframes = 0;
+    window_start_us = now;
+    window_frames = 0;
+    return 0;
+  }
+  stats.bad_subframes = decoder.bad_subframes;
+  window_frames += decoded;
+  if (SPDIF_RX_RATE_WINDOW_US <= now - window_start_us) {
+    stats.measured_rate = (uint32_t)((uint64_t)window_frames * 1000000 /
+                                     (now - window_start_us));
+    const uint32_t rate = match_rate(stats.measured_rate);
+    if (rate == 0) {
+      // Locked on something, but not a rate of this divider
+      lose_lock();
+      return 0;
+    }
+    stats.sample_rate = rate;
+    stats.locked = true;
+    window_start_us = now;
+    window_frames = 0;
+  }
+  return stats.sample_rate ? frames : 0;
+}
+
+uint32_t spdif_rx_get_sample_rate() { return stats.sample_rate; }
+
+void spdif_rx_get_stats(spdif_rx_stats_t *s) { *s = stats; }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/pio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  bool locked;             // A stream at a supported rate is received
+  bool inverted;           // The input is read through the GPIO inverter
+  uint32_t sample_rate;    // Nominal rate of the stream, 0 unless locked
+  uint32_t measured_rate;  // Frames per second over the last window
+  uint32_t bad_subframes;  // Parity and preamble errors since the lock
+} spdif_rx_stats_t;
+
+/**
+ * @brief Initializes the S/PDIF receiver state machine and its DMA, and
+ * starts searching for a stream.
+ *
+ * 44.1 to 96kHz are received. The receiver tries each clock divider and
+ * input polarity in turn until the decoder locks, then measures the frame
+ * rate against the system timer and takes the nearest supported rate.
+ *
+ * @param pio The PIO instance to use. Any free state machine is claimed.
+ * @param pin The input pin, a logic-level signal (e.g. from a coaxial
+ *        input through a comparator or an optical receiver).
+ */
+void spdif_rx_init(PIO pio, uint pin);
+
+/**
+ * @brief Deinitializes the receiver, releasing hardware resources.
+ */
+void spdif_rx_deinit();
+
+/**
+ * @brief Decodes the captured subframes.
+ *
+ * Should be called periodically in the main loop, at least once every
+ * SPDIF_RX_BUFFER_WORDS subframes. While the rate is unknown the decoded
+ * frames are discarded and everything captured is used up; afterwards at
+ * most max_frames are decoded per call.
+ *
+ * @param dst Receives interleaved stereo frames of left-justified samples.
+ * @return The number of frames written to dst, fewer than max_frames once
+ *         the captured subframes are used up.
+ */
+uint32_t spdif_rx_task(int32_t *dst, uint32_t max_frames);
+
+/**
+ * @brief Returns the nominal rate of the received stream, 0 unless locked.
+ */
+uint32_t spdif_rx_get_sample_rate();
+
+void spdif_rx_get_stats(spdif_rx_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,345 @@
+// Host benchmark of the USB sample format conversions (sample_format.c).
+//
+// Each kernel converts a full-size 96kHz stereo packet many times over. The
+// output is checked against a byte-wise reference first, so a kernel that
+// is fast but wrong does not get a number. The multi-line transposition is
+// checked bit by bit on a 48kHz 8-channel block in the same way. Times are host nanoseconds per
+// sample. Native DSD is unpacked and packed, checked bit by bit like the
+// transposition and against the idle pattern, and timed per sample. The
+// capture packing, ADC slots back into USB packets, is checked against the
+// byte-wise reference run the other way, and timed per 96kHz packet. The
+// host compiler vectorizes the plain loops, so they are only a
+// rough guide to the relative cost on the RP2040.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sample_format.h"
+
+#define FRAMES 97
+#define SAMPLES (FRAMES * 2)
+#define ROUNDS 200000
+
+typedef uint32_t (*unpack_fn)(const uint8_t *src, uint32_t bytes,
+                              int32_t *dst);
+
+typedef struct {
+  const char *name;
+  unpack_fn fn;
+  uint32_t subslot;    // Bytes per sample in the packet
+  uint32_t offset;     // Misalignment of the packet start
+  uint32_t resolution; // Significant bits per sample, 0 for float
+} bench_case_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Little-endian subslot to a left-justified sample, one byte at a time
+static int32_t reference_sample(const uint8_t *p, uint32_t subslot,
+                                uint32_t resolution) {
+  uint32_t v = 0;
+  for (uint32_t b = 0; b < subslot; ++b) {
+    v |= (uint32_t)p[b] << (8 * (4 - subslot + b));
+  }
+  const uint32_t mask = resolution < 32 ? ~(0xFFFFFFFFu >> resolution) : ~0u;
+  return (int32_t)(v & mask);
+}
+
+// Float sample to int32 in double precision, truncated toward zero
+static int32_t reference_float(const uint8_t *p) {
+  float f;
+  memcpy(&f, p, sizeof(f));
+  if (isnan(f)) {
+    return 0;
+  }
+  const double v = (double)f * 2147483648.0;
+  return v >= 2147483647.0 ? INT32_MAX : v <= -2147483648.0 ? INT32_MIN
+                                                             : (int32_t)v;
+}
+
+// Mostly in-range audio, with full scale, overshoot and special values
+static float random_float(void) {
+  static const float specials[] = {0.0f,  -0.0f, 1.0f,     -1.0f,
+                                   1.5f,  -3.0f, INFINITY, -INFINITY,
+                                   NAN,   1e-12f, 0.99999994f, -4.6566e-10f};
+  const int r = rand();
+  if (r % 16 == 0) {
+    return specials[(r / 16) % (sizeof(specials) / sizeof(specials[0]))];
+  }
+  return (float)(r % 2000001 - 1000000) / 1000000.0f *
+         (float)ldexp(1.0, -(r / 2000001 % 24));
+}
+
+static int run_case(const bench_case_t *bc, double *ns_per_sample) {
+  // Word-aligned storage, shifted by offset bytes
+  static uint32_t storage[(SAMPLES * 4 + 8) / 4];
+  uint8_t *packet = (uint8_t *)storage + bc->offset;
+  const uint32_t bytes = SAMPLES * bc->subslot;
+  if (bc->resolution) {
+    for (uint32_t i = 0; i < bytes; ++i) {
+      packet[i] = (uint8_t)rand();
+    }
+  } else {
+    for (uint32_t i = 0; i < SAMPLES; ++i) {
+      const float f = random_float();
+      memcpy(&packet[i * 4], &f, sizeof(f));
+    }
+  }
+
+  static int32_t out[SAMPLES];
+  if (bc->fn(packet, bytes, out) != SAMPLES) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < SAMPLES; ++i) {
+    const uint8_t *p = &packet[i * bc->subslot];
+    const int32_t expected = bc->resolution
+                                 ? reference_sample(p, bc->subslot, bc->resolution)
+                                 : reference_float(p);
+    if (out[i] != expected) {
+      return 0;
+    }
+  }
+
+  volatile int32_t sink = 0;
+  const double t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    bc->fn(packet, bytes, out);
+    sink += out[r % SAMPLES];
+  }
+  *ns_per_sample = (now_sec() - t0) * 1e9 / ((double)ROUNDS * SAMPLES);
+  return 1;
+}
+
+// Word layout of sample_format_pack_lines, one bit period at a time
+static void reference_pack_lines(const int32_t *src, uint32_t frames,
+                                 uint32_t channels, uint32_t lines,
+                                 uint32_t *dst) {
+  const uint32_t periods_per_word = lines == 2 ? 16 : 8;
+  const uint32_t words_per_slot = 32 / periods_per_word;
+  for (uint32_t i = 0; i < frames; ++i) {
+    for (uint32_t half = 0; half < 2; ++half) {
+      uint32_t *slot = &dst[(2 * i + half) * words_per_slot];
+      memset(slot, 0, words_per_slot * sizeof(uint32_t));
+      for (uint32_t bit = 0; bit < 32; ++bit) {
+        uint32_t period = 0;
+        for (uint32_t k = 0; k < lines; ++k) {
+          const uint32_t ch = 2 * k + half;
+          if (ch < channels) {
+            period |= (((uint32_t)src[channels * i + ch] >> (31 - bit)) & 1)
+                      << k;
+          }
+        }
+        const uint32_t p = bit % periods_per_word;
+        slot[bit / periods_per_word] |= period << (32 - lines * (p + 1));
+      }
+    }
+  }
+}
+
+static int run_pack_lines(uint32_t channels, uint32_t lines,
+                          double *ns_per_sample) {
+  enum { PACK_FRAMES = 48 };
+  static int32_t src[PACK_FRAMES * 8];
+  static uint32_t out[PACK_FRAMES * 8];
+  static uint32_t expected[PACK_FRAMES * 8];
+  for (uint32_t i = 0; i < PACK_FRAMES * channels; ++i) {
+    src[i] = (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand());
+  }
+
+  const uint32_t words = PACK_FRAMES * 2 * (lines == 2 ? 2 : 4);
+  if (sample_format_pack_lines(src, PACK_FRAMES, channels, lines, out) !=
+      words) {
+    return 0;
+  }
+  reference_pack_lines(src, PACK_FRAMES, channels, lines, expected);
+  if (memcmp(out, expected, words * sizeof(uint32_t)) != 0) {
+    return 0;
+  }
+
+  volatile uint32_t sink = 0;
+  const double t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    sample_format_pack_lines(src, PACK_FRAMES, channels, lines, out);
+    sink += out[r % words];
+  }
+  *ns_per_sample =
+      (now_sec() - t0) * 1e9 / ((double)ROUNDS * PACK_FRAMES * channels);
+  return 1;
+}
+
+// Word layout of unpacked and packed native DSD, one DSD clock at a time
+// from the bytes of the packet (first bit in the MSB of the first byte)
+static void reference_dsd(const uint8_t *packet, uint32_t frames,
+                          uint32_t *dst) {
+  for (uint32_t i = 0; i < frames; ++i) {
+    const uint8_t *l = &packet[8 * i];
+    const uint8_t *r = &packet[8 * i + 4];
+    dst[2 * i] = dst[2 * i + 1] = 0;
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+      const uint32_t lb = (l[bit / 8] >> (7 - bit % 8)) & 1;
+      const uint32_t rb = (r[bit / 8] >> (7 - bit % 8)) & 1;
+      dst[2 * i + bit / 16] |= (lb << 1 | rb) << (30 - 2 * (bit % 16));
+    }
+  }
+}
+
+static int run_dsd(double *unpack_ns, double *pack_ns) {
+  static uint32_t storage[FRAMES * 2];
+  uint8_t *packet = (uint8_t *)storage;
+  static int32_t samples[SAMPLES];
+  static uint32_t out[FRAMES * 2];
+  static uint32_t expected[FRAMES * 2];
+
+  // The idle pattern the hosts send packs into the silence word
+  memset(packet, SAMPLE_FORMAT_DSD_IDLE & 0xFF, sizeof(storage));
+  int ok = sample_format_unpack_dsd(packet, sizeof(storage), samples) ==
+           SAMPLES;
+  ok &= sample_format_pack_dsd(samples, FRAMES, out) == FRAMES * 2;
+  for (uint32_t i = 0; i < FRAMES * 2; ++i) {
+    ok &= out[i] == SAMPLE_FORMAT_DSD_SILENCE;
+  }
+
+  for (uint32_t i = 0; i < sizeof(storage); ++i) {
+    packet[i] = (uint8_t)rand();
+  }
+  sample_format_unpack_dsd(packet, sizeof(storage), samples);
+  sample_format_pack_dsd(samples, FRAMES, out);
+  reference_dsd(packet, FRAMES, expected);
+  ok &= memcmp(out, expected, sizeof(out)) == 0;
+  if (!ok) {
+    return 0;
+  }
+
+  volatile uint32_t sink = 0;
+  double t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    sample_format_unpack_dsd(packet, sizeof(storage), samples);
+    sink += (uint32_t)samples[r % SAMPLES];
+  }
+  *unpack_ns = (now_sec() - t0) * 1e9 / ((double)ROUNDS * SAMPLES);
+  t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    sample_format_pack_dsd(samples, FRAMES, out);
+    sink += out[r % FRAMES];
+  }
+  *pack_ns = (now_sec() - t0) * 1e9 / ((double)ROUNDS * SAMPLES);
+  return 1;
+}
+
+typedef uint32_t (*pack_fn)(const int32_t *src, uint32_t num_samples,
+                            uint32_t shift, uint8_t *dst);
+
+// Captured slots of `bits` bits packed into a packet, which the unpacking
+// reference has to read back as the slots left-justified and truncated
+static int run_pack_capture(pack_fn fn, uint32_t subslot, uint32_t bits,
+                            double *ns_per_packet) {
+  static int32_t src[SAMPLES];
+  static uint32_t storage[SAMPLES];
+  uint8_t *packet = (uint8_t *)storage;
+  const uint32_t mask = bits < 32 ? (1u << bits) - 1 : ~0u;
+  for (uint32_t i = 0; i < SAMPLES; ++i) {
+    src[i] = (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) & mask);
+  }
+
+  if (fn(src, SAMPLES, 32 - bits, packet) != SAMPLES * subslot) {
+    return 0;
+  }
+  const uint32_t resolution = subslot == 2 ? 16 : 24;
+  for (uint32_t i = 0; i < SAMPLES; ++i) {
+    const int32_t expected = (int32_t)(((uint32_t)src[i] << (32 - bits)) &
+                                       ~(0xFFFFFFFFu >> resolution));
+    if (reference_sample(&packet[i * subslot], subslot, 32) != expected) {
+      return 0;
+    }
+  }
+
+  volatile uint32_t sink = 0;
+  const double t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    fn(src, SAMPLES, 32 - bits, packet);
+    sink += storage[r % SAMPLES];
+  }
+  *ns_per_packet = (now_sec() - t0) * 1e9 / ROUNDS;
+  return 1;
+}
+
+int main(void) {
+  static const bench_case_t cases[] = {
+      {"16bit", sample_format_unpack_16, 2, 0, 16},
+      {"24bit/4B", sample_format_unpack_24in32, 4, 0, 24},
+      {"24bit/3B", sample_format_unpack_24, 3, 0, 24},
+      {"24bit/3B unaligned", sample_format_unpack_24, 3, 1, 24},
+      {"32bit", sample_format_unpack_32, 4, 0, 32},
+      {"float32", sample_format_unpack_float32, 4, 0, 0},
+  };
+
+  printf("%-20s %7s %9s %10s\n", "format", "bytes", "check", "ns/sample");
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    double ns = 0;
+    const int ok = run_case(&cases[i], &ns);
+    failed |= !ok;
+    printf("%-20s %7u %9s %10.2f\n", cases[i].name,
+           SAMPLES * cases[i].subslot, ok ? "ok" : "MISMATCH", ns);
+  }
+
+  static const struct {
+    const char *name;
+    uint32_t channels;
+    uint32_t lines;
+  } pack_cases[] = {
+      {"4ch/2 lines", 4, 2},
+      {"6ch/3 lines", 6, 3},
+      {"8ch/4 lines", 8, 4},
+      {"6ch/4 lines", 6, 4},
+  };
+  printf("\n%-20s %7s %9s %10s\n", "transpose", "words", "check",
+         "ns/sample");
+  for (size_t i = 0; i < sizeof(pack_cases) / sizeof(pack_cases[0]); ++i) {
+    double ns = 0;
+    const int ok =
+        run_pack_lines(pack_cases[i].channels, pack_cases[i].lines, &ns);
+    failed |= !ok;
+    printf("%-20s %7u %9s %10.2f\n", pack_cases[i].name,
+           48 * 2 * (pack_cases[i].lines == 2 ? 2 : 4), ok ? "ok" : "MISMATCH",
+           ns);
+  }
+
+  double unpack_ns = 0, pack_ns = 0;
+  const int dsd_ok = run_dsd(&unpack_ns, &pack_ns);
+  failed |= !dsd_ok;
+  printf("\n%-20s %9s %10s %10s\n", "DSD", "check", "unpack", "pack");
+  printf("%-20s %9s %10.2f %10.2f\n", "ns/sample",
+         dsd_ok ? "ok" : "MISMATCH", unpack_ns, pack_ns);
+
+  static const struct {
+    const char *name;
+    pack_fn fn;
+    uint32_t subslot;
+    uint32_t bits;  // Of a captured slot
+  } capture_cases[] = {
+      {"16bit/16 slots", sample_format_pack_16, 2, 16},
+      {"16bit/32 slots", sample_format_pack_16, 2, 32},
+      {"24bit/4B/24 slots", sample_format_pack_24in32, 4, 24},
+      {"24bit/4B/32 slots", sample_format_pack_24in32, 4, 32},
+  };
+  printf("\n%-20s %7s %9s %10s\n", "capture", "bytes", "check",
+         "ns/packet");
+  for (size_t i = 0; i < sizeof(capture_cases) / sizeof(capture_cases[0]);
+       ++i) {
+    double ns = 0;
+    const int ok = run_pack_capture(capture_cases[i].fn,
+                                    capture_cases[i].subslot,
+                                    capture_cases[i].bits, &ns);
+    failed |= !ok;
+    printf("%-20s %7u %9s %10.2f\n", capture_cases[i].name,
+           SAMPLES * capture_cases[i].subslot, ok ? "ok" : "MISMATCH", ns);
+  }
+  return failed;
+}
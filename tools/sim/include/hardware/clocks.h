@@ -0,0 +1,12 @@
+#pragma once
+
+// Host simulator stand-in for the pico-sdk clocks header.
+
+#include <stdint.h>
+
+enum clock_index { clk_sys };
+
+static inline uint32_t clock_get_hz(enum clock_index clk) {
+  (void)clk;
+  return 125000000;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+// Host simulator stand-in for the pico-sdk PIO header.
+// Only the types referenced by the firmware headers are provided.
+
+typedef unsigned int uint;
+
+typedef struct sim_pio *PIO;
+
+#define pio0 ((struct sim_pio *)0)
+#define pio1 ((struct sim_pio *)1)
@@ -0,0 +1,607 @@
+// Host-side simulator for the USB feedback loop and the ring buffer control.
+//
+// audio_device.c, usb_audio.c and ringbuffer.c are built unmodified against
+// the simulated drivers in sim_hw.c and sim_usb.c. The event loop below
+// plays the host (1ms SOF, packet sizes from the feedback endpoint) and the
+// DAC (DMA block completion at a clock that may be offset and drifting),
+// and calls the firmware entry points the same way main.c does.
+//
+// Every sample carries its own index so that the latency from the SOF that
+// scheduled a packet to the DMA block that plays it can be measured exactly.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "audio_device.h"
+#include "sim.h"
+#include "usb_audio.h"
+#include "usb_config.h"
+
+#define NS_PER_MS 1000000ull
+#define MAX_PACKET_BYTES AUDIO_MAX_PACKET_SIZE_ANY  // Of any alt
+#define PACKET_QUEUE_SIZE 64
+#define PACKET_LOG_SIZE 1024
+#define MAX_REACTION_MS 1000
+// The simulated output has 4 TDM slots, which takes alt 6 (16bit 4ch)
+#define MAX_ALT (5 + (AUDIO_MAX_CHANNELS - 2) / 2)
+
+typedef struct {
+  const char *name;
+  uint32_t sample_rate;
+  uint8_t alt;  // 1: 16bit, 2: 24bit, 3: 32bit, 4: 24bit in 3 bytes, 5: float,
+                // 6/7/8: 16bit 4/6/8ch
+  double ppm;   // DAC clock error against the host (SOF) clock
+  double drift_ppm_per_hour;
+  double jitter_us;      // packet processing delay, uniform in [0, jitter)
+  uint32_t reaction_ms;  // delay until the host applies a feedback value
+  bool ignore_feedback;  // host always sends the nominal rate
+  double seconds;
+  uint64_t seed;
+  sim_tuning_t tuning;
+} sim_config_t;
+
+typedef struct {
+  uint32_t underruns;
+  double concealed_ms;  // silence played during underruns, in total
+  uint32_t overruns;
+  uint32_t overrun_bytes;
+  double fill_mean_ms;
+  double fill_sd_ms;
+  double latency_mean_ms;
+  double latency_min_ms;
+  double latency_max_ms;
+  double feedback_error_ppm;  // mean feedback against the DAC rate
+  double first_sample_ms;     // SET_INTERFACE to the first sample
+} sim_result_t;
+
+sim_tuning_t sim_tuning;
+
+static uint64_t now_ns;
+
+uint64_t sim_now_ns(void) { return now_ns; }
+
+static uint64_t rng_state;
+
+static double rng_uniform(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (double)((rng_state * 0x2545F4914F6CDD1Dull) >> 11) / (1ull << 53);
+}
+
+// --- Host side ---
+
+typedef struct {
+  uint64_t arrival_ns;
+  uint16_t len;
+  uint8_t data[MAX_PACKET_BYTES];
+} packet_t;
+
+static packet_t packet_queue[PACKET_QUEUE_SIZE];
+static uint32_t packet_head, packet_tail;
+
+// First sample index of each packet and the SOF time it was scheduled at
+static uint32_t packet_log_first[PACKET_LOG_SIZE];
+static uint64_t packet_log_sof_ns[PACKET_LOG_SIZE];
+static uint32_t packet_log_count;
+
+static uint32_t next_sample_index = 1;
+
+static void put_sample(uint8_t *p, uint8_t alt, int16_t v) {
+  uint32_t word;
+  if (alt == 1 || 5 < alt) {
+    p[0] = (uint16_t)v;
+    p[1] = (uint16_t)v >> 8;
+    return;
+  } else if (alt == 4) {
+    // 24 bits in 3 bytes
+    p[0] = 0;
+    p[1] = (uint16_t)v;
+    p[2] = (uint16_t)v >> 8;
+    return;
+  } else if (alt == 5) {
+    // Float with the same value as the index in the upper 16 bits (exact)
+    const float f = (float)(int32_t)((uint32_t)(uint16_t)v << 16) / 2147483648.0f;
+    memcpy(&word, &f, sizeof(word));
+  } else {
+    // 24 bits in the MSBs of 32 (alt 2) or 32 bits (alt 3); the index lands
+    // in the upper 16 bits either way
+    word = (uint32_t)(uint16_t)v << 16;
+  }
+  memcpy(p, &word, sizeof(word));
+}
+
+// wMaxPacketSize of the alt's endpoint, as in usb_descriptor.h
+static uint32_t alt_max_packet_bytes(uint8_t alt) {
+  if (alt == 4) {
+    return AUDIO_MAX_PACKET_SIZE_24_PACKED;
+  }
+  if (5 < alt) {
+    return AUDIO_MAX_PACKET_SIZE_MULTICHANNEL((alt - 4) * 2);
+  }
+  return AUDIO_MAX_PACKET_SIZE;
+}
+
+static void host_send_packet(const sim_config_t *cfg, uint32_t frames) {
+  const uint32_t bytes_per_sample =
+      cfg->alt == 1 || 5 < cfg->alt ? 2 : cfg->alt == 4 ? 3 : 4;
+  // The index goes to the front pair, the other channels are silent
+  const uint32_t channels = 5 < cfg->alt ? (cfg->alt - 4) * 2 : 2;
+  const uint32_t frame_bytes = channels * bytes_per_sample;
+  packet_t *pkt = &packet_queue[packet_tail % PACKET_QUEUE_SIZE];
+  if (PACKET_QUEUE_SIZE <= packet_tail - packet_head) {
+    fprintf(stderr, "packet queue overflow\n");
+    exit(1);
+  }
+  // The feedback must not ask for more than the endpoint takes
+  if (alt_max_packet_bytes(cfg->alt) < frames * frame_bytes) {
+    fprintf(stderr, "%s: %u-byte packet exceeds wMaxPacketSize %u of alt %u\n",
+            cfg->name, frames * frame_bytes, alt_max_packet_bytes(cfg->alt),
+            cfg->alt);
+    exit(1);
+  }
+
+  packet_log_first[packet_log_count % PACKET_LOG_SIZE] = next_sample_index;
+  packet_log_sof_ns[packet_log_count % PACKET_LOG_SIZE] = now_ns;
+  ++packet_log_count;
+
+  for (uint32_t i = 0; i < frames; ++i, ++next_sample_index) {
+    uint8_t *p = &pkt->data[i * frame_bytes];
+    memset(p, 0, frame_bytes);
+    put_sample(p, cfg->alt, (int16_t)(next_sample_index & 0xFFFF));
+    put_sample(p + bytes_per_sample, cfg->alt,
+               (int16_t)(next_sample_index >> 16));
+  }
+  pkt->len = frames * frame_bytes;
+
+  // The processing delay jitters, but packets are never reordered
+  uint64_t arrival = now_ns + (uint64_t)(rng_uniform() * cfg->jitter_us * 1e3);
+  if (packet_head != packet_tail) {
+    const packet_t *last =
+        &packet_queue[(packet_tail - 1) % PACKET_QUEUE_SIZE];
+    if (arrival < last->arrival_ns) {
+      arrival = last->arrival_ns;
+    }
+  }
+  pkt->arrival_ns = arrival;
+  ++packet_tail;
+}
+
+static bool lookup_sof_ns(uint32_t sample_index, uint64_t *sof_ns) {
+  uint32_t n = packet_log_count < PACKET_LOG_SIZE ? packet_log_count
+                                                  : PACKET_LOG_SIZE;
+  for (uint32_t i = 1; i <= n; ++i) {
+    uint32_t slot = (packet_log_count - i) % PACKET_LOG_SIZE;
+    if (packet_log_first[slot] <= sample_index) {
+      *sof_ns = packet_log_sof_ns[slot];
+      return true;
+    }
+  }
+  return false;
+}
+
+// --- Simulation ---
+
+static double dac_ppm(const sim_config_t *cfg) {
+  return cfg->ppm + cfg->drift_ppm_per_hour * (now_ns / 1e9) / 3600.0;
+}
+
+static double dac_block_ns(const sim_config_t *cfg, uint32_t frames) {
+  return frames * 1e9 / (cfg->sample_rate * (1 + dac_ppm(cfg) * 1e-6));
+}
+
+static void main_loop(void) {
+  while (packet_head != packet_tail &&
+         packet_queue[packet_head % PACKET_QUEUE_SIZE].arrival_ns <= now_ns) {
+    const packet_t *pkt = &packet_queue[packet_head % PACKET_QUEUE_SIZE];
+    sim_usb_deliver_out(pkt->data, pkt->len);
+    ++packet_head;
+  }
+  audio_device_task();
+}
+
+static void run(const sim_config_t *cfg, sim_result_t *result) {
+  sim_tuning = cfg->tuning;
+  rng_state = cfg->seed ? cfg->seed : 1;
+
+  audio_device_init();
+  usb_audio_init();
+  if (cfg->tuning.spdif_in) {
+    // The host stays idle and output 0 plays the S/PDIF input
+    sim_spdif_in_start(cfg->sample_rate);
+  } else {
+    sim_usb_set_sampling_freq(cfg->sample_rate);
+    sim_usb_set_interface(INTERFACE_AUDIO_STREAM, cfg->alt);
+  }
+
+  const uint32_t nominal_q16 =
+      (uint32_t)(((uint64_t)cfg->sample_rate << 16) / 1000);
+  static uint32_t feedback_delay[MAX_REACTION_MS + 1];
+  for (uint32_t i = 0; i <= cfg->reaction_ms; ++i) {
+    feedback_delay[i] = nominal_q16;
+  }
+  uint32_t host_feedback = nominal_q16;
+  uint32_t host_acc_q16 = 0;
+  // Feedback against the DAC rate, both summed over the second half. The
+  // loop settles into a slow limit cycle, so shorter windows are misleading.
+  const uint64_t tail_ns = (uint64_t)(cfg->seconds * 1e9 / 2);
+  double tail_feedback_sum = 0;
+  double tail_dac_sum = 0;
+
+  const uint64_t end_ns = (uint64_t)(cfg->seconds * 1e9);
+  uint64_t next_sof_ns = 0;
+  uint32_t sof_count = 0;
+  bool dac_running = false;
+  double next_dac_ns = 0;
+
+  double fill_sum = 0, fill_sum2 = 0;
+  uint64_t fill_n = 0;
+  double latency_sum = 0, latency_min = INFINITY, latency_max = 0;
+  uint64_t latency_n = 0;
+
+  while (now_ns < end_ns) {
+    uint64_t t = next_sof_ns;
+    if (dac_running && (uint64_t)next_dac_ns < t) {
+      t = (uint64_t)next_dac_ns;
+    }
+    if (packet_head != packet_tail &&
+        packet_queue[packet_head % PACKET_QUEUE_SIZE].arrival_ns < t) {
+      t = packet_queue[packet_head % PACKET_QUEUE_SIZE].arrival_ns;
+    }
+    if (sim_alarm_next_ns() < t) {
+      t = sim_alarm_next_ns();
+    }
+    now_ns = t;
+
+    sim_alarm_poll();
+
+    if (dac_running && (uint64_t)next_dac_ns <= now_ns) {
+      const uint32_t frames = sim_i2s_block_frames();
+      const int32_t *block = sim_i2s_block_done();
+      next_dac_ns += dac_block_ns(cfg, frames);
+
+      if (audio_device_is_playing(0)) {
+        audio_device_depth_stats_t depth;
+        audio_device_get_depth_stats(0, &depth);
+        const double fill_ms =
+            audio_device_get_steady_buffer_fill_ratio(0) * depth.ring_ms;
+        fill_sum += fill_ms;
+        fill_sum2 += fill_ms * fill_ms;
+        ++fill_n;
+      }
+
+      uint64_t sof_ns;
+      // The index is in the upper halves of L and R, which the simulated
+      // TDM output puts in slots 0 and 1 at every bit depth
+      const uint32_t index =
+          ((uint32_t)block[0] >> 16) | ((uint32_t)block[1] & 0xFFFF0000);
+      // Interpolated samples no longer carry an index
+      if (!cfg->tuning.asrc && index != 0 && lookup_sof_ns(index, &sof_ns)) {
+        const double latency_ms = (now_ns - sof_ns) / 1e6;
+        latency_sum += latency_ms;
+        latency_min = fmin(latency_min, latency_ms);
+        latency_max = fmax(latency_max, latency_ms);
+        ++latency_n;
+      }
+    }
+
+    if (next_sof_ns <= now_ns) {
+      sim_usb_sof(sof_count & 0x7FF);
+
+      uint32_t value;
+      if (sim_usb_take_feedback(&value)) {
+        feedback_delay[sof_count % (cfg->reaction_ms + 1)] = value;
+      }
+      if (!cfg->ignore_feedback) {
+        host_feedback =
+            feedback_delay[(sof_count + 1) % (cfg->reaction_ms + 1)];
+      }
+
+      if (tail_ns <= now_ns) {
+        tail_feedback_sum += host_feedback;
+        tail_dac_sum += nominal_q16 * (1 + dac_ppm(cfg) * 1e-6);
+      }
+
+      if (!cfg->tuning.spdif_in) {
+        host_acc_q16 += host_feedback;
+        host_send_packet(cfg, host_acc_q16 >> 16);
+        host_acc_q16 &= 0xFFFF;
+      }
+
+      ++sof_count;
+      next_sof_ns += NS_PER_MS;
+    }
+
+    main_loop();
+
+    if (sim_i2s_is_running() && !dac_running) {
+      next_dac_ns = now_ns + dac_block_ns(cfg, sim_i2s_block_frames());
+    }
+    dac_running = sim_i2s_is_running();
+  }
+
+  audio_device_start_stats_t start_stats;
+  audio_device_get_start_stats(0, &start_stats);
+  if (start_stats.valid) {
+    result->first_sample_ms = start_stats.stream_start_to_first_sample_us / 1e3;
+  }
+
+  audio_device_stats_t stats;
+  audio_device_get_stats(0, &stats);
+  result->underruns = stats.underruns;
+  result->overruns = stats.overruns;
+  result->overrun_bytes = stats.overrun_bytes;
+  audio_device_underrun_stats_t underrun_stats;
+  audio_device_get_underrun_stats(0, &underrun_stats);
+  result->concealed_ms = underrun_stats.concealed_frames * 1e3 / cfg->sample_rate;
+  if (fill_n) {
+    result->fill_mean_ms = fill_sum / fill_n;
+    result->fill_sd_ms =
+        sqrt(fmax(0, fill_sum2 / fill_n - result->fill_mean_ms *
+                                              result->fill_mean_ms));
+  }
+  if (latency_n) {
+    result->latency_mean_ms = latency_sum / latency_n;
+    result->latency_min_ms = latency_min;
+    result->latency_max_ms = latency_max;
+  }
+  if (tail_dac_sum) {
+    result->feedback_error_ppm = (tail_feedback_sum / tail_dac_sum - 1) * 1e6;
+  }
+}
+
+// Runs in a child process so that the firmware statics start fresh each time
+static bool run_isolated(const sim_config_t *cfg, sim_result_t *result) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    sim_result_t r = {0};
+    run(cfg, &r);
+    ssize_t written = write(fds[1], &r, sizeof(r));
+    _exit(written == sizeof(r) ? 0 : 1);
+  }
+  close(fds[1]);
+  ssize_t n = read(fds[0], result, sizeof(*result));
+  close(fds[0]);
+  int status;
+  waitpid(pid, &status, 0);
+  return n == sizeof(*result) && WIFEXITED(status) &&
+         WEXITSTATUS(status) == 0;
+}
+
+static void print_header(void) {
+  printf(
+      "%-12s %8s %8s %8s %5s | %6s %8s %6s %8s | %13s | %20s | %9s | %7s\n",
+      "config", "ppm", "ppm/h", "jit(us)", "react", "under", "gap(ms)",
+      "over", "ovr(B)", "fill(ms)", "latency(ms) avg/min/max", "fb(ppm)", "tfs(ms)");
+}
+
+static void print_row(const sim_config_t *cfg, const sim_result_t *r) {
+  printf(
+      "%-12s %8.1f %8.1f %8.0f %5u | %6u %8.2f %6u %8u | %6.2f+-%5.2f | "
+      "%6.2f/%6.2f/%6.2f | %9.1f | %7.2f\n",
+      cfg->name, cfg->ppm, cfg->drift_ppm_per_hour, cfg->jitter_us,
+      cfg->reaction_ms, r->underruns, r->concealed_ms, r->overruns, r->overrun_bytes,
+      r->fill_mean_ms, r->fill_sd_ms, r->latency_mean_ms, r->latency_min_ms,
+      r->latency_max_ms, r->feedback_error_ppm, r->first_sample_ms);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  without options, runs the built-in sweep\n"
+          "  --seconds S    simulated duration (default 60)\n"
+          "  --rate HZ      sample rate (default 48000)\n"
+          "  --alt N        1: 16bit, 2: 24bit, 3: 32bit, 4: 24bit in 3 bytes,\n"
+          "                 5: float32, 6: 16bit 4ch (default 1)\n"
+          "  --ppm X        DAC clock offset against the host\n"
+          "  --drift X      DAC clock drift in ppm/hour\n"
+          "  --jitter US    packet processing jitter\n"
+          "  --reaction MS  host feedback reaction latency\n"
+          "  --ignore-feedback 1\n"
+          "                 host always sends the nominal rate\n"
+          "  --low-latency N\n"
+          "                 DMA block profile (PICODAC_LOW_LATENCY)\n"
+          "  --fast-start 1 start at a low level (PICODAC_FAST_START)\n"
+          "  --adaptive 1   adapt the ring depth (PICODAC_ADAPTIVE_DEPTH)\n"
+          "  --asrc 1       steer the ASRC instead of the host (PICODAC_ASRC)\n"
+          "  --spdif-in 1   play an S/PDIF source at --rate instead of USB,\n"
+          "                 --ppm is then the DAC against the source\n"
+          "  --seed N       random seed\n"
+          "  --safe X --underrun X --recovery X\n"
+          "                 ring buffer water levels (0..1)\n"
+          "  --alpha X --gain X\n"
+          "                 feedback LPF alpha and loop gain\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  const sim_config_t defaults = {
+      .name = "custom",
+      .sample_rate = 48000,
+      .alt = 1,
+      .reaction_ms = 1,
+      .seconds = 60,
+      .seed = 1,
+      .tuning =
+          {
+              .safe_water_level = 0.5f,
+              .underrun_water_level = 0.16f,
+              .recovery_water_level = 0.22f,
+              .lpf_alpha = 0.01f,
+              .feedback_rate = 0.01f,
+          },
+  };
+
+  sim_config_t custom = defaults;
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 == argc) {
+      usage(argv[0]);
+      return 1;
+    }
+    const char *key = argv[i];
+    const double v = strtod(argv[++i], NULL);
+    if (!strcmp(key, "--seconds")) {
+      custom.seconds = v;
+    } else if (!strcmp(key, "--rate")) {
+      custom.sample_rate = (uint32_t)v;
+    } else if (!strcmp(key, "--alt")) {
+      custom.alt = (uint8_t)v;
+    } else if (!strcmp(key, "--ppm")) {
+      custom.ppm = v;
+    } else if (!strcmp(key, "--drift")) {
+      custom.drift_ppm_per_hour = v;
+    } else if (!strcmp(key, "--jitter")) {
+      custom.jitter_us = v;
+    } else if (!strcmp(key, "--reaction")) {
+      custom.reaction_ms = (uint32_t)v;
+    } else if (!strcmp(key, "--ignore-feedback")) {
+      custom.ignore_feedback = v != 0;
+    } else if (!strcmp(key, "--low-latency")) {
+      custom.tuning.low_latency = (int)v;
+    } else if (!strcmp(key, "--fast-start")) {
+      custom.tuning.fast_start = v != 0;
+    } else if (!strcmp(key, "--adaptive")) {
+      custom.tuning.adaptive_depth = v != 0;
+    } else if (!strcmp(key, "--asrc")) {
+      custom.tuning.asrc = v != 0;
+    } else if (!strcmp(key, "--spdif-in")) {
+      custom.tuning.spdif_in = v != 0;
+    } else if (!strcmp(key, "--seed")) {
+      custom.seed = (uint64_t)v;
+    } else if (!strcmp(key, "--safe")) {
+      custom.tuning.safe_water_level = (float)v;
+    } else if (!strcmp(key, "--underrun")) {
+      custom.tuning.underrun_water_level = (float)v;
+    } else if (!strcmp(key, "--recovery")) {
+      custom.tuning.recovery_water_level = (float)v;
+    } else if (!strcmp(key, "--alpha")) {
+      custom.tuning.lpf_alpha = (float)v;
+    } else if (!strcmp(key, "--gain")) {
+      custom.tuning.feedback_rate = (float)v;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (custom.reaction_ms > MAX_REACTION_MS || custom.seconds < 2 ||
+      custom.alt < 1 || custom.alt > MAX_ALT || custom.tuning.low_latency < 0 ||
+      custom.tuning.low_latency > 2) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  sim_config_t sweep[] = {
+      defaults, defaults, defaults, defaults, defaults,
+      defaults, defaults, defaults, defaults, defaults,
+      defaults, defaults, defaults, defaults, defaults,
+      defaults, defaults, defaults, defaults, defaults,
+      defaults, defaults, defaults, defaults, defaults,
+  };
+  sweep[0].name = "nominal";
+  sweep[1].name = "fast-dac";
+  sweep[1].ppm = 100;
+  sweep[2].name = "slow-dac";
+  sweep[2].ppm = -100;
+  sweep[3].name = "drift";
+  sweep[3].ppm = -30;
+  sweep[3].drift_ppm_per_hour = 3600;  // 1 ppm/s
+  sweep[4].name = "jitter";
+  sweep[4].jitter_us = 500;
+  sweep[5].name = "slow-host";
+  sweep[5].ppm = 100;
+  sweep[5].reaction_ms = 32;
+  sweep[6].name = "worst";
+  sweep[6].ppm = 300;
+  sweep[6].jitter_us = 900;
+  sweep[6].reaction_ms = 32;
+  sweep[7].name = "96k-32bit";
+  sweep[7].sample_rate = 96000;
+  sweep[7].alt = 3;
+  sweep[7].ppm = 100;
+  sweep[8].name = "no-feedback";
+  sweep[8].ppm = 100;
+  sweep[8].ignore_feedback = true;
+  sweep[9].name = "asrc";
+  sweep[9].ppm = 100;
+  sweep[9].ignore_feedback = true;
+  sweep[9].tuning.asrc = true;
+  sweep[10].name = "fast-start";
+  sweep[10].tuning.fast_start = true;
+  sweep[11].name = "fast-jitter";
+  sweep[11].ppm = 100;
+  sweep[11].jitter_us = 900;
+  sweep[11].reaction_ms = 32;
+  sweep[11].tuning.fast_start = true;
+  sweep[12].name = "adaptive";
+  sweep[12].ppm = 100;
+  sweep[12].tuning.adaptive_depth = true;
+  sweep[13].name = "adapt-jitter";
+  sweep[13].ppm = 100;
+  sweep[13].jitter_us = 3000;
+  sweep[13].tuning.adaptive_depth = true;
+  sweep[14].name = "low-latency";
+  sweep[14].ppm = 100;
+  sweep[14].tuning.low_latency = 1;
+  sweep[15].name = "ultra-low";
+  sweep[15].ppm = 100;
+  sweep[15].tuning.low_latency = 2;
+  sweep[16].name = "ultra-jitter";
+  sweep[16].ppm = 100;
+  sweep[16].jitter_us = 500;
+  sweep[16].tuning.low_latency = 2;
+  sweep[17].name = "192k-16bit";
+  sweep[17].sample_rate = 192000;
+  sweep[17].ppm = 100;
+  sweep[18].name = "96k-24bit-3B";
+  sweep[18].sample_rate = 96000;
+  sweep[18].alt = 4;
+  sweep[18].ppm = 100;
+  sweep[19].name = "float32";
+  sweep[19].alt = 5;
+  sweep[19].ppm = 100;
+  sweep[20].name = "48k-4ch";
+  sweep[20].alt = 6;
+  sweep[20].ppm = 100;
+  sweep[21].name = "spdif-in";
+  sweep[21].ppm = 100;
+  sweep[21].tuning.spdif_in = true;
+  sweep[22].name = "spdif-slow";
+  sweep[22].sample_rate = 44100;
+  sweep[22].ppm = -100;
+  sweep[22].tuning.spdif_in = true;
+  sweep[23].name = "spdif-asrc";
+  sweep[23].sample_rate = 96000;
+  sweep[23].ppm = 100;
+  sweep[23].tuning.asrc = true;
+  sweep[23].tuning.spdif_in = true;
+  sweep[24].name = "fast-96k";
+  sweep[24].sample_rate = 96000;
+  sweep[24].alt = 3;
+  sweep[24].ppm = 100;
+  sweep[24].tuning.fast_start = true;
+
+  const sim_config_t *configs = argc > 1 ? &custom : sweep;
+  const size_t n = argc > 1 ? 1 : sizeof(sweep) / sizeof(sweep[0]);
+
+  print_header();
+  for (size_t i = 0; i < n; ++i) {
+    sim_result_t result;
+    if (!run_isolated(&configs[i], &result)) {
+      fprintf(stderr, "%s: simulation failed\n", configs[i].name);
+      return 1;
+    }
+    print_row(&configs[i], &result);
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Loop constants that the firmware takes from these variables when it is
+// built for the simulator (see CMakeLists.txt).
+typedef struct {
+  float safe_water_level;
+  float underrun_water_level;
+  float recovery_water_level;
+  float lpf_alpha;
+  float feedback_rate;
+  int low_latency;
+  bool fast_start;
+  bool adaptive_depth;
+  bool asrc;
+  bool spdif_in;
+} sim_tuning_t;
+
+extern sim_tuning_t sim_tuning;
+
+// --- Simulated time (sim.c) ---
+uint64_t sim_now_ns(void);
+
+// --- Simulated I2S (sim_hw.c) ---
+bool sim_i2s_is_running(void);
+uint32_t sim_i2s_block_frames(void);
+// Called at every DMA block boundary. Returns the block that starts playing.
+const int32_t *sim_i2s_block_done(void);
+void sim_alarm_poll(void);
+uint64_t sim_alarm_next_ns(void);
+
+// --- Simulated S/PDIF input (sim_hw.c) ---
+// Starts a source at exactly sample_rate on the simulated (host) clock.
+void sim_spdif_in_start(uint32_t sample_rate);
+
+// --- Simulated USB (sim_usb.c) ---
+void sim_usb_sof(uint16_t frame_number);
+void sim_usb_deliver_out(const uint8_t *buf, uint16_t len);
+// Completes the pending feedback IN transfer, if any.
+bool sim_usb_take_feedback(uint32_t *value);
+bool sim_usb_set_interface(uint8_t itf, uint8_t alt);
+bool sim_usb_set_sampling_freq(uint32_t freq);
@@ -0,0 +1,279 @@
+// Host-side replacements for the hardware drivers used by audio_device.c.
+// The I2S DMA is reduced to the block queue; the block timing itself is
+// driven by the event loop in sim.c. Only the output on pio0 is simulated.
+// The S/PDIF receiver hands over frames as they fall due on the simulated
+// clock, already locked.
+
+#include <string.h>
+
+#include "blink.h"
+#include "clock_monitor.h"
+#include "hardware/timer.h"
+#include "i2s.h"
+#include "sim.h"
+#include "spdif_rx.h"
+
+// 192kHz, 1ms block
+#define MAX_BUFFER_FRAMES 192
+// 4 TDM slots
+#define MAX_WORDS_PER_FRAME 4
+#define MAX_DMA_BLOCKS 8
+
+static int32_t dma_buffer[MAX_DMA_BLOCKS][MAX_BUFFER_FRAMES * MAX_WORDS_PER_FRAME];
+static uint32_t dma_blocks = 2;
+static uint32_t playing_block;
+static uint32_t write_block;
+static bool armed;
+static bool running;
+static uint32_t buffer_frames;
+static uint32_t completed_frames;
+
+// --- I2S ---
+
+void i2s_init(const i2s_config_t *config) {
+  buffer_frames = config->buffer_frames;
+  dma_blocks = config->dma_blocks;
+  armed = false;
+  running = false;
+}
+
+void i2s_deinit(const i2s_config_t *config) {
+  (void)config;
+  armed = false;
+  running = false;
+}
+
+void i2s_reconfigure(const i2s_config_t *config) {
+  buffer_frames = config->buffer_frames;
+  dma_blocks = config->dma_blocks;
+}
+
+void i2s_arm(const i2s_config_t *config) {
+  (void)config;
+  memset(dma_buffer, 0, sizeof(dma_buffer));
+  playing_block = 0;
+  write_block = 0;
+  armed = true;
+}
+
+void i2s_fire(const i2s_config_t *config) {
+  (void)config;
+  running = true;
+}
+
+void i2s_start(const i2s_config_t *config) {
+  i2s_arm(config);
+  i2s_fire(config);
+}
+
+void i2s_stop(const i2s_config_t *config) {
+  (void)config;
+  armed = false;
+  running = false;
+}
+
+void i2s_mute(const i2s_config_t *config) { (void)config; }
+void i2s_unmute(const i2s_config_t *config) { (void)config; }
+
+bool i2s_is_buffer_ready(const i2s_config_t *config) {
+  (void)config;
+  const uint32_t next = (write_block + 1) % dma_blocks;
+  if (!armed || next == playing_block) {
+    return false;
+  }
+  write_block = next;
+  return true;
+}
+
+int32_t *i2s_get_write_buffer(const i2s_config_t *config) {
+  (void)config;
+  return dma_buffer[write_block];
+}
+
+// S/PDIF is off in the simulation
+void i2s_write_spdif(const i2s_config_t *config, const int32_t *src,
+                     uint32_t channels) {
+  (void)config;
+  (void)src;
+  (void)channels;
+}
+
+void i2s_write_pdm(const i2s_config_t *config, const int32_t *src,
+                   uint32_t channels) {
+  (void)config;
+  (void)src;
+  (void)channels;
+}
+
+void i2s_get_pdm_stats(const i2s_config_t *config, i2s_pdm_stats_t *stats) {
+  (void)config;
+  memset(stats, 0, sizeof(*stats));
+}
+
+uint32_t i2s_get_buffer_size_frames(const i2s_config_t *config) {
+  return config->buffer_frames;
+}
+
+// DMA never falls behind in the simulation
+void i2s_get_underrun_stats(const i2s_config_t *config,
+                            i2s_underrun_stats_t *stats) {
+  (void)config;
+  memset(stats, 0, sizeof(*stats));
+  stats->ms_since_stall = UINT32_MAX;
+}
+
+// TDM puts every channel in its own 32-bit slot
+uint32_t i2s_get_words_per_frame(const i2s_config_t *config) {
+  if (config->format == I2S_FORMAT_TDM) {
+    return config->tdm_slots;
+  }
+  return config->bit_depth == 16 ? 1 : 2;
+}
+
+// Slots are as wide as the samples, or 32 bits with TDM
+uint32_t i2s_get_sample_shift(const i2s_config_t *config) { return 0; }
+
+uint32_t i2s_get_frames_played(const i2s_config_t *config) {
+  (void)config;
+  return completed_frames;
+}
+
+// The simulation has no ADC; capture is built with PICODAC_ADC=0 and never
+// reads the ring
+uint32_t i2s_get_capture_available(const i2s_config_t *config) {
+  (void)config;
+  return 0;
+}
+
+const int32_t *i2s_peek_capture(const i2s_config_t *config,
+                                uint32_t *frames) {
+  (void)config;
+  *frames = 0;
+  return NULL;
+}
+
+void i2s_skip_capture(const i2s_config_t *config, uint32_t frames) {
+  (void)config;
+  (void)frames;
+}
+
+uint32_t i2s_get_capture_bits(const i2s_config_t *config) {
+  return config->bit_depth;
+}
+
+bool sim_i2s_is_running(void) { return running; }
+
+uint32_t sim_i2s_block_frames(void) { return buffer_frames; }
+
+const int32_t *sim_i2s_block_done(void) {
+  playing_block = (playing_block + 1) % dma_blocks;
+  completed_frames += buffer_frames;
+  return dma_buffer[playing_block];
+}
+
+// --- Hardware alarm (one is enough for audio_device.c) ---
+
+static hardware_alarm_callback_t alarm_callback;
+static uint64_t alarm_target_us;
+static bool alarm_armed;
+
+int hardware_alarm_claim_unused(bool required) {
+  (void)required;
+  return 0;
+}
+
+void hardware_alarm_set_callback(uint alarm_num,
+                                 hardware_alarm_callback_t callback) {
+  (void)alarm_num;
+  alarm_callback = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t target) {
+  (void)alarm_num;
+  alarm_target_us = target;
+  alarm_armed = true;
+  return false;
+}
+
+void hardware_alarm_cancel(uint alarm_num) {
+  (void)alarm_num;
+  alarm_armed = false;
+}
+
+uint64_t sim_alarm_next_ns(void) {
+  return alarm_armed ? alarm_target_us * 1000 : UINT64_MAX;
+}
+
+void sim_alarm_poll(void) {
+  if (alarm_armed && alarm_target_us * 1000 <= sim_now_ns()) {
+    alarm_armed = false;
+    if (alarm_callback) {
+      alarm_callback(0);
+    }
+  }
+}
+
+uint64_t time_us_64(void) { return sim_now_ns() / 1000; }
+
+// --- S/PDIF receiver ---
+
+static uint32_t spdif_in_rate;
+static uint64_t spdif_in_start_ns;
+static uint64_t spdif_in_frames;
+
+void sim_spdif_in_start(uint32_t sample_rate) {
+  spdif_in_rate = sample_rate;
+  spdif_in_start_ns = sim_now_ns();
+  spdif_in_frames = 0;
+}
+
+void spdif_rx_init(PIO pio, uint pin) {
+  (void)pio;
+  (void)pin;
+}
+void spdif_rx_deinit() {}
+
+// Each frame carries its index like the USB packets do (sim.c)
+uint32_t spdif_rx_task(int32_t *dst, uint32_t max_frames) {
+  if (spdif_in_rate == 0) {
+    return 0;
+  }
+  const uint64_t due =
+      (sim_now_ns() - spdif_in_start_ns) * spdif_in_rate / 1000000000ull;
+  const uint32_t frames = due - spdif_in_frames < max_frames
+                              ? (uint32_t)(due - spdif_in_frames)
+                              : max_frames;
+  for (uint32_t i = 0; i < frames; ++i) {
+    const uint32_t index = (uint32_t)++spdif_in_frames;
+    dst[i * 2] = (int32_t)(index << 16);
+    dst[i * 2 + 1] = (int32_t)(index & 0xFFFF0000);
+  }
+  return frames;
+}
+
+uint32_t spdif_rx_get_sample_rate() { return spdif_in_rate; }
+
+void spdif_rx_get_stats(spdif_rx_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  stats->locked = spdif_in_rate != 0;
+  stats->sample_rate = spdif_in_rate;
+  stats->measured_rate = spdif_in_rate;
+}
+
+// --- LED and clock monitor: no-ops ---
+
+void blink_set_period_us(uint32_t period_us) { (void)period_us; }
+void blink_led_on() {}
+void blink_led_off() {}
+
+void clock_monitor_init(PIO pio, uint lrclk_pin) {
+  (void)pio;
+  (void)lrclk_pin;
+}
+void clock_monitor_deinit() {}
+void clock_monitor_start(uint32_t nominal_rate) { (void)nominal_rate; }
+void clock_monitor_stop() {}
+void clock_monitor_task() {}
+void clock_monitor_get_stats(clock_monitor_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+}
@@ -0,0 +1,105 @@
+// Host-side replacement for usb.c. Requests that the real stack would take
+// from the controller are injected by sim.c through the sim_usb_* calls.
+
+#include <string.h>
+
+#include "sim.h"
+#include "usb.h"
+#include "usb_config.h"
+
+static usb_ep_out_handler ep_out_handlers[16];
+static usb_ep_in_handler ep_in_handlers[16];
+static usb_control_interface_out_handler control_out_handlers[8];
+static usb_device_set_interfacec_handler set_interface_handlers[8];
+static usb_sof_handler sof_handler;
+
+static uint32_t feedback_value;
+static bool feedback_pending;
+
+void usb_device_init() {}
+void usb_device_task() {}
+
+void usb_device_set_ep_in_handler(uint8_t ep_num, usb_ep_in_handler handler) {
+  ep_in_handlers[ep_num] = handler;
+}
+
+void usb_device_set_ep_out_handler(uint8_t ep_num, usb_ep_out_handler handler) {
+  ep_out_handlers[ep_num] = handler;
+}
+
+void usb_device_set_control_in_handler(
+    uint8_t interface_num, usb_control_interface_in_handler handler) {
+  (void)interface_num;
+  (void)handler;
+}
+
+void usb_device_set_control_out_handler(
+    uint8_t interface_num, usb_control_interface_out_handler handler) {
+  control_out_handlers[interface_num] = handler;
+}
+
+void usb_device_set_set_interface_handler(
+    uint8_t interface_num, usb_device_set_interfacec_handler handler) {
+  set_interface_handlers[interface_num] = handler;
+}
+
+void usb_device_set_sof_handler(usb_sof_handler handler) {
+  sof_handler = handler;
+}
+
+void usb_ep_n_start_transfer(uint8_t ep_num, bool in, const uint8_t *buf,
+                             uint16_t len) {
+  // OUT transfers are always ready to receive
+  if (in && ep_num == (EP_AUDIO_FEEDBACK_IN & 0x7F) &&
+      len == sizeof(feedback_value)) {
+    memcpy(&feedback_value, buf, sizeof(feedback_value));
+    feedback_pending = true;
+  }
+}
+
+void usb_ep0_start_transfer(const uint8_t *buf, uint16_t len) {
+  (void)buf;
+  (void)len;
+}
+
+void sim_usb_sof(uint16_t frame_number) {
+  if (sof_handler) {
+    sof_handler(frame_number);
+  }
+}
+
+void sim_usb_deliver_out(const uint8_t *buf, uint16_t len) {
+  if (ep_out_handlers[EP_AUDIO_STREAM_OUT]) {
+    ep_out_handlers[EP_AUDIO_STREAM_OUT](buf, len);
+  }
+}
+
+bool sim_usb_take_feedback(uint32_t *value) {
+  if (!feedback_pending) {
+    return false;
+  }
+  feedback_pending = false;
+  *value = feedback_value;
+  // The completion handler queues the next feedback value
+  if (ep_in_handlers[EP_AUDIO_FEEDBACK_IN & 0x7F]) {
+    ep_in_handlers[EP_AUDIO_FEEDBACK_IN & 0x7F]();
+  }
+  return true;
+}
+
+bool sim_usb_set_interface(uint8_t itf, uint8_t alt) {
+  return set_interface_handlers[itf] && set_interface_handlers[itf](alt);
+}
+
+bool sim_usb_set_sampling_freq(uint32_t freq) {
+  const struct usb_setup_packet_t pkt = {
+      .bmRequestType = 0x21,
+      .bRequest = 0x01,  // CUR
+      .wValue = 0x01 << 8,  // SAM_FREQ_CONTROL
+      .wIndex = (AUDIO_CONTROL_ID_CLOCK << 8) | INTERFACE_AUDIO_CONTROL,
+      .wLength = 4,
+  };
+  const uint8_t buf[4] = {freq, freq >> 8, freq >> 16, freq >> 24};
+  return control_out_handlers[INTERFACE_AUDIO_CONTROL] &&
+         control_out_handlers[INTERFACE_AUDIO_CONTROL](&pkt, buf, sizeof(buf));
+}
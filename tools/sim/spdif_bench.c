@@ -0,0 +1,182 @@
+// Host benchmark of the S/PDIF encoder (spdif.c).
+//
+// The output is checked first against a reference that emits one cell at a
+// time, with its own preamble polarity, channel status and parity logic, so
+// an encoder that is fast but wrong does not get a number. The blocks are
+// encoded in pieces of 1ms, which cross the 192-frame channel status block.
+// Times are host nanoseconds per stereo frame; the device reports the cost
+// of a whole block, S/PDIF included, over HID telemetry page 0x07.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spdif.h"
+
+#define MAX_CHANNELS 8
+#define TEST_FRAMES (3 * SPDIF_BLOCK_FRAMES + 17)
+#define ROUNDS 20000
+
+typedef struct {
+  uint32_t sample_rate;
+  uint32_t bit_depth;
+  uint32_t channels;  // Stride of the source frames, 0: silence
+} bench_case_t;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// --- Reference encoder ---
+
+typedef struct {
+  uint32_t *dst;
+  uint32_t word;
+  uint32_t bits;
+  uint32_t level;
+} cell_writer_t;
+
+static void put_cell(cell_writer_t *w, uint32_t cell) {
+  w->word = (w->word << 1) | cell;
+  w->level = cell;
+  if (++w->bits == 32) {
+    *w->dst++ = w->word;
+    w->word = 0;
+    w->bits = 0;
+  }
+}
+
+// A transition at the start of every bit, another in the middle of a 1
+static void put_bit(cell_writer_t *w, uint32_t bit) {
+  put_cell(w, !w->level);
+  put_cell(w, bit ? !w->level : w->level);
+}
+
+// Preambles as given for a preceding low cell, complemented after a high one
+static void put_preamble(cell_writer_t *w, uint8_t pattern) {
+  const uint32_t invert = w->level;
+  for (int i = 7; 0 <= i; --i) {
+    put_cell(w, ((pattern >> i) & 1) ^ invert);
+  }
+}
+
+static uint8_t reference_channel_status_bit(uint32_t frame,
+                                            uint32_t sample_rate,
+                                            uint32_t bit_depth) {
+  uint8_t cs[SPDIF_BLOCK_FRAMES / 8] = {0};
+  cs[0] = 1 << 2;  // Copying permitted
+  switch (sample_rate) {
+    case 44100:
+      cs[3] = 0x0;
+      break;
+    case 48000:
+      cs[3] = 0x2;
+      break;
+    case 88200:
+      cs[3] = 0x8;
+      break;
+    case 96000:
+      cs[3] = 0xA;
+      break;
+  }
+  // Maximum 24 bits (bit 32) and 24 (bits 33 and 35), or 16 of 20 (bit 33)
+  cs[4] = bit_depth == 16 ? 0x2 : 0x1 | 0x2 | 0x8;
+  return (cs[frame / 8] >> (frame % 8)) & 1;
+}
+
+static void reference_subframe(cell_writer_t *w, uint8_t preamble,
+                               int32_t sample, uint32_t bit_depth,
+                               uint32_t c) {
+  const uint32_t bits = bit_depth == 16 ? 16 : 24;
+  const uint32_t audio = ((uint32_t)sample >> (32 - bits)) << (24 - bits);
+  put_preamble(w, preamble);
+  uint32_t ones = 0;
+  for (uint32_t i = 0; i < 24; ++i) {
+    const uint32_t bit = (audio >> i) & 1;
+    ones += bit;
+    put_bit(w, bit);
+  }
+  put_bit(w, 0);  // Validity
+  put_bit(w, 0);  // User
+  put_bit(w, c);
+  ones += c;
+  put_bit(w, ones & 1);  // Even parity
+}
+
+static void reference_encode(const int32_t *src, uint32_t frames,
+                             uint32_t channels, uint32_t sample_rate,
+                             uint32_t bit_depth, uint32_t *dst) {
+  cell_writer_t w = {dst, 0, 0, 0};
+  for (uint32_t i = 0; i < frames; ++i, src += channels) {
+    const uint32_t frame = i % SPDIF_BLOCK_FRAMES;
+    const uint32_t c =
+        reference_channel_status_bit(frame, sample_rate, bit_depth);
+    reference_subframe(&w, frame == 0 ? 0xE8 : 0xE2, src[0], bit_depth, c);
+    reference_subframe(&w, 0xE4, src[1], bit_depth, c);
+  }
+}
+
+// --- Benchmark ---
+
+static int run_case(const bench_case_t *bc, double *ns_per_frame) {
+  static int32_t src[TEST_FRAMES * MAX_CHANNELS];
+  static uint32_t out[TEST_FRAMES * SPDIF_WORDS_PER_FRAME];
+  static uint32_t expected[TEST_FRAMES * SPDIF_WORDS_PER_FRAME];
+  for (uint32_t i = 0; i < TEST_FRAMES * MAX_CHANNELS; ++i) {
+    src[i] = bc->channels
+                 ? (int32_t)(((uint32_t)rand() << 16) ^ (uint32_t)rand())
+                 : 0;
+  }
+  const uint32_t block_frames = bc->sample_rate / 1000;
+
+  spdif_encoder_t enc;
+  spdif_encoder_init(&enc, bc->sample_rate, bc->bit_depth);
+  uint32_t words = 0;
+  for (uint32_t done = 0; done < TEST_FRAMES;) {
+    const uint32_t n =
+        TEST_FRAMES - done < block_frames ? TEST_FRAMES - done : block_frames;
+    words += spdif_encode(&enc, &src[done * bc->channels], n, bc->channels,
+                          &out[words]);
+    done += n;
+  }
+  if (words != TEST_FRAMES * SPDIF_WORDS_PER_FRAME) {
+    return 0;
+  }
+  reference_encode(src, TEST_FRAMES, bc->channels, bc->sample_rate,
+                   bc->bit_depth, expected);
+  if (memcmp(out, expected, sizeof(out)) != 0) {
+    return 0;
+  }
+
+  volatile uint32_t sink = 0;
+  const double t0 = now_sec();
+  for (int r = 0; r < ROUNDS; ++r) {
+    spdif_encode(&enc, src, block_frames, bc->channels, out);
+    sink += out[r % (block_frames * SPDIF_WORDS_PER_FRAME)];
+  }
+  *ns_per_frame = (now_sec() - t0) * 1e9 / ((double)ROUNDS * block_frames);
+  return 1;
+}
+
+int main(void) {
+  static const bench_case_t cases[] = {
+      {48000, 16, 2}, {44100, 16, 2}, {48000, 24, 2},
+      {96000, 24, 2}, {96000, 32, 2}, {48000, 16, 8},
+      {96000, 24, 0},
+  };
+
+  printf("%6s %5s %8s %9s %10s\n", "rate", "bits", "channels", "check",
+         "ns/frame");
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    double ns = 0;
+    const int ok = run_case(&cases[i], &ns);
+    failed |= !ok;
+    printf("%6u %5u %8u %9s %10.2f\n", cases[i].sample_rate,
+           cases[i].bit_depth, cases[i].channels, ok ? "ok" : "MISMATCH", ns);
+  }
+  return failed;
+}
@@ -0,0 +1,533 @@
+// Host test bench of the S/PDIF receiver (spdif_rx.pio and the decoder in
+// spdif.c).
+//
+// The PIO program is read from spdif_rx.pio itself and run on a cycle model
+// of one state machine: the fractional clock divider, the two-flop input
+// synchronizer, instruction delays, wrap and autopush. The line is the
+// output of the real encoder, with the cell edges moved by random jitter
+// and the source clock offset from nominal, so the sampling points are
+// tested where they are tight. The pushed words go through spdif_decode()
+// and must give back the source frames exactly once the decoder locks.
+// Streams the current clock divider is not meant for must not lock.
+//
+// With a file argument, a recorded line is decoded instead: one bit per
+// line sample, LSB first, at the sample rate given after the file name
+// (e.g. a raw logic analyzer export). Sampling below 100MHz adds more edge
+// jitter than the receiver tolerates. Every divider and polarity is tried,
+// as the receiver does, and the subframe rate found is printed.
+//
+// Times are host nanoseconds per stereo frame of spdif_decode().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "spdif.h"
+
+#define CLK_SYS_HZ 92160000.0
+#define INPUT_SYNC_CYCLES 2
+#define AUTOPUSH_BITS 30
+#define MAX_INSTRUCTIONS 32
+#define TEST_FRAMES (2 * SPDIF_BLOCK_FRAMES + 100)
+// The decoder needs SPDIF_LOCK_FRAMES good frames, plus the one the state
+// machine starts in
+#define MAX_LOCK_FRAMES (SPDIF_LOCK_FRAMES + 4)
+#define DECODE_CHUNK_WORDS 64
+#define ROUNDS 2000
+
+// Clock divider centers of the two rate pairs, as in spdif_rx.c
+static const uint32_t family_center_hz[2] = {46009, 92017};
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 1;
+
+static double rng_uniform(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (double)((rng_state * 0x2545F4914F6CDD1Dull) >> 11) / (1ull << 53);
+}
+
+// --- PIO program ---
+
+typedef enum {
+  OP_WAIT,
+  OP_JMP,
+  OP_IN,
+  OP_SET,
+} op_t;
+
+typedef enum {
+  COND_ALWAYS,
+  COND_X_DEC,
+  COND_PIN,
+} cond_t;
+
+typedef enum {
+  SRC_PINS,
+  SRC_Y,
+  SRC_NULL,
+} src_t;
+
+typedef struct {
+  op_t op;
+  uint32_t arg;  // wait polarity, in bit count, set value
+  cond_t cond;
+  src_t src;
+  char target[32];
+  uint32_t address;
+  uint32_t delay;
+} instruction_t;
+
+typedef struct {
+  instruction_t code[MAX_INSTRUCTIONS];
+  uint32_t length;
+  uint32_t wrap_target;
+  uint32_t wrap;
+  uint32_t hunt;  // Entry point
+  uint32_t cycles_per_cell;
+} program_t;
+
+typedef struct {
+  char name[32];
+  uint32_t address;
+} label_t;
+
+static void parse_error(const char *line) {
+  fprintf(stderr, "spdif_rx.pio: cannot model \"%s\"\n", line);
+  exit(1);
+}
+
+// Reads the subset of pioasm spdif_rx.pio uses
+static void load_program(const char *path, program_t *prog) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    exit(1);
+  }
+  memset(prog, 0, sizeof(*prog));
+  label_t labels[MAX_INSTRUCTIONS];
+  uint32_t n_labels = 0;
+  bool in_sdk = false;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    if (in_sdk) {
+      sscanf(line, " #define SPDIF_RX_CYCLES_PER_CELL %u",
+             &prog->cycles_per_cell);
+      continue;
+    }
+    char *comment = strchr(line, ';');
+    if (comment) {
+      *comment = '\0';
+    }
+    for (char *p = line; *p; ++p) {
+      if (*p == ',' || *p == '\n') {
+        *p = ' ';
+      }
+    }
+    char tok[4][32];
+    const int n = sscanf(line, "%31s %31s %31s %31s", tok[0], tok[1], tok[2],
+                         tok[3]);
+    if (n <= 0) {
+      continue;
+    }
+    if (!strcmp(tok[0], "%")) {
+      in_sdk = true;
+      continue;
+    }
+    if (!strcmp(tok[0], ".program")) {
+      continue;
+    }
+    if (!strcmp(tok[0], ".wrap_target")) {
+      prog->wrap_target = prog->length;
+      continue;
+    }
+    if (!strcmp(tok[0], ".wrap")) {
+      prog->wrap = prog->length - 1;
+      continue;
+    }
+    const char *label = !strcmp(tok[0], "public") ? tok[1] : tok[0];
+    const size_t len = strlen(label);
+    if (label[len - 1] == ':') {
+      snprintf(labels[n_labels].name, sizeof(labels[0].name), "%.*s",
+               (int)(len - 1), label);
+      labels[n_labels++].address = prog->length;
+      if (!strncmp(label, "hunt:", 5)) {
+        prog->hunt = prog->length;
+      }
+      continue;
+    }
+
+    if (MAX_INSTRUCTIONS <= prog->length) {
+      parse_error(line);
+    }
+    instruction_t *ins = &prog->code[prog->length++];
+    const char *delay = strchr(line, '[');
+    ins->delay = delay ? (uint32_t)atoi(delay + 1) : 0;
+    if (!strcmp(tok[0], "wait") && 4 <= n && !strcmp(tok[2], "pin") &&
+        !strcmp(tok[3], "0")) {
+      ins->op = OP_WAIT;
+      ins->arg = (uint32_t)atoi(tok[1]);
+    } else if (!strcmp(tok[0], "jmp") && 2 <= n) {
+      ins->op = OP_JMP;
+      const char *target = tok[1];
+      if (3 <= n && tok[2][0] != '[') {
+        target = tok[2];
+        if (!strcmp(tok[1], "pin")) {
+          ins->cond = COND_PIN;
+        } else if (!strcmp(tok[1], "x--")) {
+          ins->cond = COND_X_DEC;
+        } else {
+          parse_error(line);
+        }
+      }
+      snprintf(ins->target, sizeof(ins->target), "%s", target);
+    } else if (!strcmp(tok[0], "in") && 3 <= n) {
+      ins->op = OP_IN;
+      ins->arg = (uint32_t)atoi(tok[2]);
+      if (!strcmp(tok[1], "pins")) {
+        ins->src = SRC_PINS;
+      } else if (!strcmp(tok[1], "y")) {
+        ins->src = SRC_Y;
+      } else if (!strcmp(tok[1], "null")) {
+        ins->src = SRC_NULL;
+      } else {
+        parse_error(line);
+      }
+    } else if (!strcmp(tok[0], "set") && 3 <= n && !strcmp(tok[1], "x")) {
+      ins->op = OP_SET;
+      ins->arg = (uint32_t)atoi(tok[2]);
+    } else {
+      parse_error(line);
+    }
+  }
+  fclose(f);
+
+  for (uint32_t i = 0; i < prog->length; ++i) {
+    instruction_t *ins = &prog->code[i];
+    if (ins->op != OP_JMP) {
+      continue;
+    }
+    uint32_t j = 0;
+    while (j < n_labels && strcmp(labels[j].name, ins->target)) {
+      ++j;
+    }
+    if (j == n_labels) {
+      parse_error(ins->target);
+    }
+    ins->address = labels[j].address;
+  }
+  if (prog->length == 0 || prog->cycles_per_cell == 0) {
+    parse_error(path);
+  }
+}
+
+// --- Line ---
+
+// Edge times in clk_sys cycles
+typedef struct {
+  double *edges;
+  size_t count;
+  uint32_t initial;  // Level before the first edge
+  double end;
+} line_t;
+
+static void line_add_edge(line_t *line, size_t *capacity, double t) {
+  if (line->count == *capacity) {
+    *capacity = *capacity ? *capacity * 2 : 4096;
+    line->edges = realloc(line->edges, *capacity * sizeof(double));
+  }
+  line->edges[line->count++] = t;
+}
+
+// Cells of the encoder output, first cell in the MSB of each word
+static void line_from_cells(line_t *line, const uint32_t *words,
+                            uint32_t n_words, double cell_cycles,
+                            double jitter_cycles) {
+  size_t capacity = 0;
+  memset(line, 0, sizeof(*line));
+  uint32_t level = 0;
+  double t = cell_cycles * rng_uniform();
+  for (uint32_t i = 0; i < n_words; ++i) {
+    for (int b = 31; 0 <= b; --b, t += cell_cycles) {
+      const uint32_t cell = (words[i] >> b) & 1;
+      if (cell != level) {
+        line_add_edge(line, &capacity,
+                      t + jitter_cycles * (2 * rng_uniform() - 1));
+        level = cell;
+      }
+    }
+  }
+  line->end = t;
+}
+
+// --- State machine model ---
+
+typedef struct {
+  const program_t *prog;
+  const line_t *line;
+  uint32_t invert;  // GPIO input override
+  double div;       // clk_sys cycles per state machine cycle
+} run_t;
+
+// Runs the line through the state machine and returns the pushed words
+static uint32_t run_state_machine(const run_t *r, uint32_t *out,
+                                  uint32_t max_words) {
+  const program_t *prog = r->prog;
+  const line_t *line = r->line;
+  uint32_t pc = prog->hunt;
+  uint32_t x = 0;
+  const uint32_t y = ~0u;  // mov y, ~null in spdif_rx_program_init()
+  uint32_t isr = 0;
+  uint32_t isr_count = 0;
+  uint32_t delay = 0;
+  size_t edge = 0;
+  uint32_t words = 0;
+
+  for (uint64_t k = 0; words < max_words; ++k) {
+    // A divider of n + f/256 runs the state machine on clk_sys cycles
+    // floor(k * div), and the input reaches it two cycles late
+    const double t = (double)(uint64_t)(k * r->div) - INPUT_SYNC_CYCLES;
+    if (line->end <= t) {
+      break;
+    }
+    while (edge < line->count && line->edges[edge] <= t) {
+      ++edge;
+    }
+    const uint32_t pin = (line->initial ^ (edge & 1) ^ r->invert) & 1;
+
+    if (delay) {
+      --delay;
+      continue;
+    }
+    const instruction_t *ins = &prog->code[pc];
+    bool jump = false;
+    switch (ins->op) {
+      case OP_WAIT:
+        if (pin != ins->arg) {
+          continue;  // Stalls without the delay
+        }
+        break;
+      case OP_JMP:
+        if (ins->cond == COND_ALWAYS) {
+          jump = true;
+        } else if (ins->cond == COND_PIN) {
+          jump = pin;
+        } else {
+          jump = x != 0;
+          --x;
+        }
+        break;
+      case OP_IN: {
+        const uint32_t src =
+            ins->src == SRC_PINS ? pin : ins->src == SRC_Y ? y : 0;
+        const uint32_t n = ins->arg;
+        isr = (isr >> n) | (src << (32 - n));
+        isr_count += n;
+        if (AUTOPUSH_BITS <= isr_count) {
+          out[words++] = isr;
+          isr = 0;
+          isr_count = 0;
+        }
+      } break;
+      case OP_SET:
+        x = ins->arg;
+        break;
+    }
+    pc = jump ? ins->address : pc == prog->wrap ? prog->wrap_target : pc + 1;
+    delay = ins->delay;
+  }
+  return words;
+}
+
+static double clkdiv(const program_t *prog, uint32_t family) {
+  const uint32_t div_q8 = (uint32_t)(
+      ((uint64_t)CLK_SYS_HZ << 8) /
+      (prog->cycles_per_cell * SPDIF_CELLS_PER_FRAME *
+       family_center_hz[family]));
+  return div_q8 / 256.0;
+}
+
+static uint32_t decode_words(const uint32_t *words, uint32_t n_words,
+                             int32_t *frames) {
+  spdif_decoder_t dec;
+  spdif_decoder_init(&dec);
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < n_words; i += DECODE_CHUNK_WORDS) {
+    const uint32_t chunk = n_words - i < DECODE_CHUNK_WORDS
+                               ? n_words - i
+                               : DECODE_CHUNK_WORDS;
+    n += spdif_decode(&dec, &words[i], chunk, &frames[n * 2]);
+  }
+  return n;
+}
+
+// --- Generated streams ---
+
+typedef struct {
+  uint32_t sample_rate;
+  uint32_t family;     // Clock divider the receiver is set to
+  double ppm;          // Source clock against nominal
+  double jitter_ns;    // Peak edge displacement
+  bool inverted;       // Line polarity
+  bool invert_input;   // GPIO input override
+  bool expect_lock;
+} rx_case_t;
+
+// 0: failed, 1: passed
+static int run_case(const program_t *prog, const rx_case_t *c,
+                    uint32_t *frames_out, double *ns_per_frame) {
+  static int32_t src[TEST_FRAMES * 2];
+  static uint32_t cells[TEST_FRAMES * SPDIF_WORDS_PER_FRAME];
+  static uint32_t words[TEST_FRAMES * 2 + 16];
+  static int32_t out[(TEST_FRAMES + 8) * 2];
+  for (uint32_t i = 0; i < TEST_FRAMES * 2; ++i) {
+    src[i] = (int32_t)((((uint32_t)rand() << 16) ^ (uint32_t)rand()) << 8);
+  }
+  spdif_encoder_t enc;
+  spdif_encoder_init(&enc, c->sample_rate, 24);
+  spdif_encode(&enc, src, TEST_FRAMES, 2, cells);
+  if (c->inverted) {
+    for (uint32_t i = 0; i < TEST_FRAMES * SPDIF_WORDS_PER_FRAME; ++i) {
+      cells[i] = ~cells[i];
+    }
+  }
+
+  line_t line;
+  const double cell_cycles = CLK_SYS_HZ / (SPDIF_CELLS_PER_FRAME *
+                                           c->sample_rate *
+                                           (1 + c->ppm * 1e-6));
+  line_from_cells(&line, cells, TEST_FRAMES * SPDIF_WORDS_PER_FRAME,
+                  cell_cycles, c->jitter_ns * 1e-9 * CLK_SYS_HZ);
+  const run_t r = {prog, &line, c->invert_input, clkdiv(prog, c->family)};
+  const uint32_t n_words =
+      run_state_machine(&r, words, sizeof(words) / sizeof(words[0]));
+  free(line.edges);
+  const uint32_t n = decode_words(words, n_words, out);
+  *frames_out = n;
+
+  if (!c->expect_lock) {
+    return n == 0;
+  }
+  // The first frame out is the one the decoder locked on
+  uint32_t first = 0;
+  while (first < MAX_LOCK_FRAMES &&
+         (src[first * 2] != out[0] || src[first * 2 + 1] != out[1])) {
+    ++first;
+  }
+  if (first == MAX_LOCK_FRAMES || n + first + 1 < TEST_FRAMES ||
+      TEST_FRAMES < n + first ||
+      memcmp(&src[first * 2], out, n * 2 * sizeof(int32_t)) != 0) {
+    return 0;
+  }
+
+  const double t0 = now_sec();
+  for (int i = 0; i < ROUNDS; ++i) {
+    decode_words(words, n_words, out);
+  }
+  *ns_per_frame = (now_sec() - t0) * 1e9 / ((double)ROUNDS * n);
+  return 1;
+}
+
+// --- Recorded line ---
+
+static int decode_capture(const program_t *prog, const char *path,
+                          double capture_hz) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+  line_t line = {0};
+  size_t capacity = 0;
+  const double cycles_per_sample = CLK_SYS_HZ / capture_hz;
+  uint64_t index = 0;
+  uint32_t level = 0;
+  int byte;
+  while ((byte = fgetc(f)) != EOF) {
+    for (int b = 0; b < 8; ++b, ++index) {
+      const uint32_t v = (byte >> b) & 1;
+      if (index == 0) {
+        line.initial = level = v;
+      } else if (v != level) {
+        line_add_edge(&line, &capacity, index * cycles_per_sample);
+        level = v;
+      }
+    }
+  }
+  fclose(f);
+  line.end = index * cycles_per_sample;
+  const double seconds = index / capture_hz;
+
+  const uint32_t max_words = (uint32_t)(seconds * 2 * 200000) + 16;
+  uint32_t *words = malloc(max_words * sizeof(uint32_t));
+  int32_t *out = malloc((max_words / 2 + 8) * 2 * sizeof(int32_t));
+  printf("%s: %.3f s at %.0f Hz\n", path, seconds, capture_hz);
+  printf("%6s %8s %8s %10s\n", "pair", "invert", "frames", "rate(Hz)");
+  int locked = 0;
+  for (uint32_t setting = 0; setting < 4; ++setting) {
+    const run_t r = {prog, &line, setting >> 1, clkdiv(prog, setting & 1)};
+    const uint32_t n_words = run_state_machine(&r, words, max_words);
+    const uint32_t n = decode_words(words, n_words, out);
+    locked |= n != 0;
+    printf("%6s %8s %8u %10.0f\n", setting & 1 ? "88/96" : "44/48",
+           setting >> 1 ? "yes" : "no", n, n ? n_words / 2 / seconds : 0);
+  }
+  free(words);
+  free(out);
+  free(line.edges);
+  return !locked;
+}
+
+int main(int argc, char **argv) {
+  program_t prog;
+  load_program(SPDIF_RX_PIO_PATH, &prog);
+  if (argc == 3) {
+    return decode_capture(&prog, argv[1], strtod(argv[2], NULL));
+  }
+  if (argc != 1) {
+    fprintf(stderr, "usage: %s [capture.bin capture_rate_hz]\n", argv[0]);
+    return 1;
+  }
+
+  // Source clocks of consumer equipment are within 1000 ppm (IEC 60958-3
+  // level II); the jitter is far beyond what a receiver sees in practice
+  static const rx_case_t cases[] = {
+      {44100, 0, 0, 5, false, false, true},
+      {44100, 0, -1000, 10, false, false, true},
+      {48000, 0, 0, 5, false, false, true},
+      {48000, 0, 1000, 10, false, false, true},
+      {88200, 1, -1000, 5, false, false, true},
+      {96000, 1, 0, 5, false, false, true},
+      {96000, 1, 1000, 5, false, false, true},
+      {48000, 1, 0, 5, false, false, false},
+      {96000, 0, 0, 5, false, false, false},
+      {44100, 1, 0, 5, false, false, false},
+      {48000, 0, 0, 5, true, false, false},
+      {48000, 0, 0, 5, true, true, true},
+      {96000, 1, 0, 5, true, true, true},
+  };
+
+  printf("%6s %6s %6s %7s %8s %6s %9s %8s %10s\n", "rate", "pair", "ppm",
+         "jit(ns)", "inverted", "lock", "check", "frames", "ns/frame");
+  int failed = 0;
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+    const rx_case_t *c = &cases[i];
+    uint32_t frames = 0;
+    double ns = 0;
+    const int ok = run_case(&prog, c, &frames, &ns);
+    failed |= !ok;
+    printf("%6u %6s %6.0f %7.0f %8s %6s %9s %8u %10.2f\n", c->sample_rate,
+           c->family ? "88/96" : "44/48", c->ppm, c->jitter_ns,
+           c->inverted ? (c->invert_input ? "fixed" : "yes") : "no",
+           c->expect_lock ? "yes" : "no", ok ? "ok" : "MISMATCH", frames, ns);
+  }
+  return failed;
+}
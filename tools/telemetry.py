@@ -0,0 +1,207 @@
+# /// script
+# requires-python = ">=3.13"
+# dependencies = [
+#     "hidapi",
+# ]
+# ///
+import struct
+import sys
+
+import hid
+
+VID = 0xCAFE
+PID = 0xBABE
+
+PAGE_SYNC_START = 0x01
+PAGE_CLOCK_MONITOR = 0x02
+PAGE_BUFFER = 0x03
+PAGE_ASRC = 0x04
+PAGE_START = 0x05
+PAGE_DEPTH = 0x06
+PAGE_CPU = 0x07
+PAGE_UNDERRUN = 0x08
+PAGE_HW_UNDERRUN = 0x09
+PAGE_HEADROOM = 0x0A
+PAGE_SPDIF_IN = 0x0B
+PAGE_PDM = 0x0C
+PAGE_CAPTURE = 0x0D
+
+# Selects the second output (PICODAC_DUAL_OUTPUT=1) in the page number
+PAGE_OUTPUT_1 = 0x80
+
+
+def decode_sync_start(report):
+    valid, frame, sof_to_start, error = struct.unpack_from("<?HHh", report, 1)
+    if not valid:
+        return "sync start: none"
+    return (
+        f"sync start: frame {frame}, {sof_to_start} us after SOF "
+        f"(error {error} us)"
+    )
+
+
+def decode_clock_monitor(report):
+    valid, rate_mhz, error_ppb, rms_ns, pp_ns = struct.unpack_from(
+        "<?IiHH", report, 1
+    )
+    if not valid:
+        return "clock monitor: no measurement"
+    return (
+        f"LRCLK: {rate_mhz / 1000:.3f} Hz ({error_ppb / 1000:+.3f} ppm), "
+        f"period jitter {rms_ns} ns rms / {pp_ns} ns p-p"
+    )
+
+
+def decode_buffer(report):
+    underruns, overruns, overrun_bytes = struct.unpack_from("<III", report, 1)
+    return (
+        f"buffer: {underruns} underruns, {overruns} overruns "
+        f"({overrun_bytes} bytes dropped)"
+    )
+
+
+def decode_asrc(report):
+    active, ratio_ppb, cycles = struct.unpack_from("<?iI", report, 1)
+    if not active:
+        return "asrc: inactive"
+    return f"asrc: ratio {ratio_ppb / 1000:+.3f} ppm, {cycles} cycles/frame"
+
+
+def decode_start(report):
+    flags, from_start, from_packet, switch, gap = struct.unpack_from(
+        "<BIIHI", report, 1
+    )
+    if not flags & 1:
+        return "start: no measurement"
+    text = (
+        f"start: first sample {from_start} us after SET_INTERFACE, "
+        f"{from_packet} us after the first packet, reconfigured in {switch} us"
+    )
+    if flags & 2:
+        text += f", buffer kept, output gap {gap / 1000:.1f} ms"
+    return text
+
+
+def decode_depth(report):
+    adaptive, target, jitter, min_fill, ring_ms = struct.unpack_from(
+        "<?IIIH", report, 1
+    )
+    mode = "adaptive" if adaptive else "fixed"
+    return (
+        f"depth ({mode}): target {target / 1000:.1f} ms of {ring_ms} ms ring, "
+        f"packet jitter {jitter} us, lowest fill {min_fill / 1000:.2f} ms"
+    )
+
+
+def decode_cpu(report):
+    block_us, load, cycles, rate, spare = struct.unpack_from("<HHIIH", report, 1)
+    return (
+        f"cpu: {block_us} us blocks, {cycles} cycles/block, "
+        f"load {load / 10:.1f}%, {spare} spare cycles/frame at {rate} Hz"
+    )
+
+
+def decode_underrun(report):
+    duration, frames, total = struct.unpack_from("<III", report, 1)
+    return (
+        f"underrun: last {duration} us, {frames} frames concealed "
+        f"({total} since boot)"
+    )
+
+
+def decode_hw_underrun(report):
+    stalls, frame, age_ms, dma_stopped = struct.unpack_from("<III?", report, 1)
+    text = f"hw underrun: {stalls} PIO TX stalls"
+    if age_ms != 0xFFFFFFFF:
+        text += f", last {age_ms} ms ago at frame {frame}"
+    if dma_stopped:
+        text += ", DMA chain stopped"
+    return text
+
+
+def decode_headroom(report):
+    dpram_used, dpram_size, load, outputs = struct.unpack_from("<HHHB", report, 1)
+    return (
+        f"headroom: DPRAM {dpram_used} of {dpram_size} bytes "
+        f"({dpram_size - dpram_used} free), {outputs} output(s) "
+        f"using {load / 10:.1f}% of the CPU"
+    )
+
+
+def decode_spdif_in(report):
+    flags, rate, bad, slips = struct.unpack_from("<BIII", report, 1)
+    if not flags & 1:
+        return "spdif in: no lock"
+    state = "playing" if flags & 2 else "idle"
+    return (
+        f"spdif in: {rate} Hz, {state}, {bad} bad subframes, "
+        f"{slips} frames slipped"
+    )
+
+
+def decode_pdm(report):
+    active, load, cycles, centicycles, late, resets = struct.unpack_from(
+        "<?HIHIH", report, 1
+    )
+    if not active:
+        return "pdm: inactive"
+    return (
+        f"pdm: core 1 load {load / 10:.1f}%, {cycles} cycles/block "
+        f"({centicycles / 100:.2f}/bit), {late} late blocks, "
+        f"{resets} modulator resets"
+    )
+
+
+def decode_capture(report):
+    flags, bits, load, cycles, depth, slips, empty = struct.unpack_from(
+        "<BBHIHHH", report, 1
+    )
+    if not flags & 1:
+        return "capture: stopped"
+    clocks = ", clocks for capture only" if flags & 2 else ""
+    return (
+        f"capture: {bits} bit{clocks}, load {load / 10:.1f}%, "
+        f"{cycles} cycles/packet, depth {depth} us, {slips} slipped and "
+        f"{empty} empty packets"
+    )
+
+
+DECODERS = {
+    PAGE_SYNC_START: decode_sync_start,
+    PAGE_CLOCK_MONITOR: decode_clock_monitor,
+    PAGE_BUFFER: decode_buffer,
+    PAGE_ASRC: decode_asrc,
+    PAGE_START: decode_start,
+    PAGE_DEPTH: decode_depth,
+    PAGE_CPU: decode_cpu,
+    PAGE_UNDERRUN: decode_underrun,
+    PAGE_HW_UNDERRUN: decode_hw_underrun,
+    PAGE_HEADROOM: decode_headroom,
+    PAGE_SPDIF_IN: decode_spdif_in,
+    PAGE_PDM: decode_pdm,
+    PAGE_CAPTURE: decode_capture,
+}
+
+
+def main():
+    page = int(sys.argv[1], 0) if len(sys.argv) > 1 else PAGE_SYNC_START
+    # telemetry.py <page> [output]
+    if len(sys.argv) > 2 and int(sys.argv[2]) == 1:
+        page |= PAGE_OUTPUT_1
+
+    device = hid.device()
+    device.open(VID, PID)
+
+    # select page, then skip the report queued before the selection
+    device.write(bytes([page]))
+    device.read(16, 1000)
+    report = bytes(device.read(16, 1000))
+    if not report or report[0] != page:
+        print(f"unexpected report: {list(report)}")
+        return
+    prefix = "output 1 " if page & PAGE_OUTPUT_1 else ""
+    print(prefix + DECODERS[page & ~PAGE_OUTPUT_1](report))
+
+
+if __name__ == "__main__":
+    main()
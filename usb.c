@@ -35,6 +35,9 @@ struct control_handler_config {
   usb_device_set_interfacec_handler set[MUSB_MAX_INTERFACES];
 } static interface_handler;
 
+// SOF はタイミングが重要なため、キューを経由せず ISR から直接呼び出す
+static volatile usb_sof_handler sof_handler = NULL;
+
 #define MUSB_WEAK __attribute__((weak))
 
 static queue_t queue;
@@ -133,6 +136,16 @@ static void isr_usbctrl_handler() {
 
   struct usb_event_t event;
 
+  // SOF の時刻を利用する処理のため、最初に処理する
+  if (status & USB_INTS_DEV_SOF_BITS) {
+    handled |= USB_INTS_DEV_SOF_BITS;
+    // SOF_RD の読み出しで割り込みがクリアされる
+    uint16_t frame_number = usb_hw->sof_rd & USB_SOF_RD_BITS;
+    if (sof_handler) {
+      sof_handler(frame_number);
+    }
+  }
+
   if (status & USB_INTS_SETUP_REQ_BITS) {
     handled |= USB_INTS_SETUP_REQ_BITS;
     usb_hw_clear->sie_status = USB_SIE_STATUS_SETUP_REC_BITS;
@@ -583,7 +596,10 @@ static void usb_start_transfer(struct endpoint_config* ep, bool in,
 
   // TX なら
   if (in) {
-    memcpy((void*)ep->buf, buf, len);
+    // buf が NULL なら usb_ep_n_get_in_buffer() に直接書き込み済み
+    if (buf) {
+      memcpy((void*)ep->buf, buf, len);
+    }
     // バッファ充填済みフラグをセット
     val |= USB_BUF_CTRL_FULL;
   }
@@ -604,6 +620,10 @@ void usb_ep_n_start_transfer(uint8_t ep_num, bool in, const uint8_t* buf,
   usb_start_transfer(in ? &ep_in[ep_num] : &ep_out[ep_num], in, buf, len);
 }
 
+uint8_t* usb_ep_n_get_in_buffer(uint8_t ep_num) {
+  return (uint8_t*)ep_in[ep_num].buf;
+}
+
 static void usb_ep0_continue_transfer() {
   uint16_t remaining =
       transfer_state_ep0_out.total_len - transfer_state_ep0_out.sent_len;
@@ -841,6 +861,15 @@ void usb_device_set_set_interface_handler(
   interface_handler.set[interface_num] = handler;
 }
 
+void usb_device_set_sof_handler(usb_sof_handler handler) {
+  sof_handler = handler;
+  if (handler) {
+    usb_hw_set->inte = USB_INTS_DEV_SOF_BITS;
+  } else {
+    usb_hw_clear->inte = USB_INTS_DEV_SOF_BITS;
+  }
+}
+
 void walk_descriptor(
     void* descriptor, uint16_t len, uint8_t itf, uint8_t alt,
     void (*callback)(const struct usb_interface_descriptor_t* itf,
@@ -877,6 +906,8 @@ void walk_descriptor(
 static uint8_t alt_settings[MUSB_MAX_INTERFACES];
 static uint16_t max_packet_size_in[16];
 static uint16_t max_packet_size_out[16];
+// usb_layout_buffers() が割り当てた DPRAM のバイト数 (64 バイト境界の詰め物を含む)
+static uint16_t dpram_used = 0;
 
 static void change_ep(const struct usb_interface_descriptor_t* itf,
                       const struct usb_endpoint_descriptor_t* edp,
@@ -948,8 +979,13 @@ static void usb_layout_buffers() {
     }
   }
   assert(dpram_pos <= sizeof(usb_dpram->epx_data));
+  dpram_used = dpram_pos;
 }
 
+uint16_t usb_device_get_dpram_used() { return dpram_used; }
+
+uint16_t usb_device_get_dpram_size() { return sizeof(usb_dpram->epx_data); }
+
 uint8_t current_config = 0;
 static bool usb_set_configuration(uint8_t config) {
   // 既存のエンドポイントを初期化
@@ -32,6 +32,9 @@ typedef bool (*usb_control_interface_out_handler)(
 
 typedef bool (*usb_device_set_interfacec_handler)(uint8_t alt);
 
+// SOF 受信時に割り込みコンテキストから呼ばれる
+typedef void (*usb_sof_handler)(uint16_t frame_number);
+
 void usb_device_init();
 void usb_device_task();
 
@@ -46,6 +49,16 @@ void usb_device_set_control_out_handler(
 void usb_device_set_set_interface_handler(
     uint8_t interface_num, usb_device_set_interfacec_handler handler);
 
+void usb_device_set_sof_handler(usb_sof_handler handler);
+
+// エンドポイントバッファに割り当てた DPRAM のバイト数と、割り当て可能な全体
+// SET_CONFIGURATION までは 0
+uint16_t usb_device_get_dpram_used();
+uint16_t usb_device_get_dpram_size();
+
+// IN の buf に NULL を渡すと usb_ep_n_get_in_buffer() の内容をそのまま送る
 void usb_ep_n_start_transfer(uint8_t ep_num, bool in, const uint8_t* buf,
                              uint16_t len);
+// IN エンドポイントの DPRAM バッファ。前の転送が完了してから書き込む
+uint8_t* usb_ep_n_get_in_buffer(uint8_t ep_num);
 void usb_ep0_start_transfer(const uint8_t* buf, uint16_t len);
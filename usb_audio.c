@@ -4,126 +4,314 @@
 
 #include "audio_device.h"
 #include "log.h"
+#include "sample_format.h"
 #include "usb.h"
 #include "usb_config.h"
 
 #define MIN(a, b) (a < b ? a : b)
 
+// フィードバックのループ定数。ホスト側シミュレータ (tools/sim) から上書きできる
+#ifndef FEEDBACK_LPF_ALPHA
+#define FEEDBACK_LPF_ALPHA 0.01f
+#endif
+#ifndef FEEDBACK_RATE
+#define FEEDBACK_RATE 0.01f
+#endif
+
 typedef enum {
   USB_SAMPLE_FORMAT_16,
-  USB_SAMPLE_FORMAT_24,
+  USB_SAMPLE_FORMAT_24,         // 4 バイトのサブスロット
   USB_SAMPLE_FORMAT_32,
+  USB_SAMPLE_FORMAT_24_PACKED,  // 3 バイトのサブスロット
+  USB_SAMPLE_FORMAT_FLOAT32,    // IEEE 754 単精度
+  USB_SAMPLE_FORMAT_DSD,        // ネイティブ DSD (RAW_DATA, 32 ビットのサブスロット)
 } usb_sample_format_t;
 
-static usb_sample_format_t g_format = USB_SAMPLE_FORMAT_16;
+// UAC2 ファンクションごとの状態。ファンクション n は audio_device の出力 n に流す
+typedef struct {
+  uint8_t id;
+  uint8_t itf_control;
+  uint8_t itf_stream;
+  uint8_t ep_out;
+  uint8_t ep_feedback;
+  uint8_t max_alt;  // 2 つ目のファンクションはステレオの alt 5 まで
+  usb_sample_format_t format;
+  // 現在の alt の wMaxPacketSize。受信の再開はこの長さで行う
+  uint16_t max_packet_size;
+  uint8_t frame_bytes;  // 現在の alt の 1 フレームのバイト数
+  uint8_t current_alt;
+  float filtered_buffer_ratio;
+} usb_audio_function_t;
+
+static usb_audio_function_t functions[AUDIO_DEVICE_NUM] = {
+    {
+        .id = 0,
+        .itf_control = INTERFACE_AUDIO_CONTROL,
+        .itf_stream = INTERFACE_AUDIO_STREAM,
+        .ep_out = EP_AUDIO_STREAM_OUT,
+        .ep_feedback = EP_AUDIO_FEEDBACK_IN,
+        // 4/6/8ch の alt 6〜8 は出力できるチャンネル数まで。DSD はその次
+        .max_alt = PICODAC_DSD ? AUDIO_ALT_DSD : AUDIO_ALT_MULTICHANNEL_LAST,
+        .format = USB_SAMPLE_FORMAT_16,
+        .max_packet_size = AUDIO_MAX_PACKET_SIZE,
+        .frame_bytes = 4,
+        .filtered_buffer_ratio = 0.5,
+    },
+#if PICODAC_DUAL_OUTPUT
+    {
+        .id = 1,
+        .itf_control = INTERFACE_AUDIO2_CONTROL,
+        .itf_stream = INTERFACE_AUDIO2_STREAM,
+        .ep_out = EP_AUDIO2_STREAM_OUT,
+        .ep_feedback = EP_AUDIO2_FEEDBACK_IN,
+        .max_alt = 5,
+        .format = USB_SAMPLE_FORMAT_16,
+        .max_packet_size = AUDIO_MAX_PACKET_SIZE,
+        .frame_bytes = 4,
+        .filtered_buffer_ratio = 0.5,
+    },
+#endif
+};
+
+// AC インターフェース番号からファンクションを探す
+static usb_audio_function_t* function_of_control(uint8_t itf) {
+  for (uint32_t i = 0; i < AUDIO_DEVICE_NUM; ++i) {
+    if (functions[i].itf_control == itf) {
+      return &functions[i];
+    }
+  }
+  return NULL;
+}
 
-static void ep_audio_out_handler(const uint8_t* buf, uint16_t len) {
+static void audio_out(usb_audio_function_t* fn, const uint8_t* buf,
+                      uint16_t len) {
   // LOG_DEBUG("ep_audio_out_handler: %d bytes received", len);
 
-  const uint32_t* usb_buf = (const uint32_t*)buf;
-
-  // samples は usb_buf の 2 倍(16bit時)もしくは同数(24bit時)
-  // ここでは多めに 2 倍取っておく
-  static int32_t samples[512 * 2];
-
-  if (g_format == USB_SAMPLE_FORMAT_16) {
-    // 1 frame = 2 samples (L+R) = 4 bytes.
-    // usb_buf[i] contains one frame (L in lower 16 bits, R in upper 16 bits).
-    const int num_frames = len / sizeof(usb_buf[0]);
-    const int num_samples = num_frames * 2;
-    for (int i = 0; i < num_frames; ++i) {
-      // Unpack L and R samples from the frame.
-      samples[2 * i] = (int16_t)(usb_buf[i] & 0xFFFF);
-      samples[2 * i + 1] = (int16_t)(usb_buf[i] >> 16);
-    }
-    audio_device_on_usb_rx(samples, num_samples);
-  } else if (g_format == USB_SAMPLE_FORMAT_24) {
-    // 1 sample (L or R) = 4 bytes. 1 frame = 2 samples = 8 bytes.
-    // usb_buf contains a flat stream of samples (L, R, L, R, ...).
-    const int num_samples = len / sizeof(usb_buf[0]);
-    for (int i = 0; i < num_samples; ++i) {
-      // The 24-bit sample is in the MSBs of the 32-bit container.
-      // We do an arithmetic right shift by 8 to get the top 24 bits.
-      samples[i] = ((int32_t)usb_buf[i]) >> 8;
-    }
-    audio_device_on_usb_rx(samples, num_samples);
-  } else if (g_format == USB_SAMPLE_FORMAT_32) {
-    // 1 sample (L or R) = 4 bytes. 1 frame = 2 samples = 8 bytes.
-    // usb_buf contains a flat stream of samples (L, R, L, R, ...).
-    const int num_samples = len / sizeof(usb_buf[0]);
-    for (int i = 0; i < num_samples; ++i) {
-      samples[i] = (int32_t)usb_buf[i];
-    }
-    audio_device_on_usb_rx(samples, num_samples);
+  // samples は 16bit 時が最も多く、最大パケットの 1/2 個
+  // マルチチャネルでも 1 フレームのサンプルが続けて並ぶだけなので、変換は共通
+  // どのフォーマットでもサンプルは 32bit に左詰めする (I2S 側は上位
+  // bit_depth ビットを送る) ので、フォーマット切り替えでリングバッファの
+  // 中身を捨てずに済む
+  static int32_t samples[AUDIO_MAX_PACKET_SIZE_ANY / 2];
+
+  uint32_t num_samples = 0;
+  if (fn->format == USB_SAMPLE_FORMAT_16) {
+    num_samples = sample_format_unpack_16(buf, len, samples);
+  } else if (fn->format == USB_SAMPLE_FORMAT_24) {
+    num_samples = sample_format_unpack_24in32(buf, len, samples);
+  } else if (fn->format == USB_SAMPLE_FORMAT_24_PACKED) {
+    num_samples = sample_format_unpack_24(buf, len, samples);
+  } else if (fn->format == USB_SAMPLE_FORMAT_32) {
+    num_samples = sample_format_unpack_32(buf, len, samples);
+  } else if (fn->format == USB_SAMPLE_FORMAT_FLOAT32) {
+    // FPU がないため整数演算だけで 32bit に変換する
+    num_samples = sample_format_unpack_float32(buf, len, samples);
+  } else if (fn->format == USB_SAMPLE_FORMAT_DSD) {
+    num_samples = sample_format_unpack_dsd(buf, len, samples);
   }
+  audio_device_on_usb_rx(fn->id, samples, num_samples);
   // 次の転送準備
-  usb_ep_n_start_transfer(EP_AUDIO_STREAM_OUT, false, NULL, (96 + 1) * 4 * 2);
+  usb_ep_n_start_transfer(fn->ep_out, false, NULL, fn->max_packet_size);
 }
 
-static void feedback() {
-  static float filtered_buffer_ratio = 0.5;
-  static const float lpf_alpha = 0.01;
-  static const float feedback_rate = 0.01;
+static void feedback(usb_audio_function_t* fn) {
+  const float lpf_alpha = FEEDBACK_LPF_ALPHA;
+  const float feedback_rate = FEEDBACK_RATE;
+
+  uint32_t sample_rate = audio_device_get_sampling_freq(fn->id);
+  float rate_per_ms = sample_rate / 1000.0f;
+
+  // 外部クロック時は SOF 基準で数えた LRCLK 周期を基準レートとする
+  uint32_t measured_rate_q16;
+  if (audio_device_get_measured_rate(fn->id, &measured_rate_q16)) {
+    rate_per_ms = measured_rate_q16 / 65536.0f;
+  }
 
-  uint32_t sample_rate = audio_device_get_sampling_freq();
+  // 高速開始中は一定の割合で多めに要求してバッファを溜める
+  // ASRC 使用時はデバイス側で水位を保つため、公称レートをそのまま返す
   float adjusted_rate_per_ms;
-  if (audio_device_is_playing()) {
+  const float boost = audio_device_get_rate_boost(fn->id);
+  if (boost != 0) {
+    // wMaxPacketSize は最高レートの公称 + 1 フレーム分なので、上乗せは
+    // 1 フレームの余裕を残して抑える。96kHz の 24/32bit や 192kHz では
+    // 上乗せできず、公称レートのまま溜める
+    const float max_rate_per_ms = fn->max_packet_size / fn->frame_bytes - 1;
+    adjusted_rate_per_ms = rate_per_ms * (1 + boost);
+    if (max_rate_per_ms < adjusted_rate_per_ms) {
+      adjusted_rate_per_ms =
+          max_rate_per_ms < rate_per_ms ? rate_per_ms : max_rate_per_ms;
+    }
+    fn->filtered_buffer_ratio = 0.5;
+  } else if (audio_device_is_playing(fn->id) && !audio_device_uses_asrc()) {
     float steady_buffer_fill_ratio =
-        audio_device_get_steady_buffer_fill_ratio();
-    filtered_buffer_ratio = steady_buffer_fill_ratio * lpf_alpha +
-                            filtered_buffer_ratio * (1 - lpf_alpha);
-    float error = filtered_buffer_ratio - 0.5;
-    adjusted_rate_per_ms =
-        (sample_rate / 1000.0f) * (1 - error * feedback_rate);
+        audio_device_get_steady_buffer_fill_ratio(fn->id);
+    fn->filtered_buffer_ratio = steady_buffer_fill_ratio * lpf_alpha +
+                                fn->filtered_buffer_ratio * (1 - lpf_alpha);
+    float error = fn->filtered_buffer_ratio - 0.5;
+    adjusted_rate_per_ms = rate_per_ms * (1 - error * feedback_rate);
   } else {
-    adjusted_rate_per_ms = sample_rate / 1000.0f;
-    filtered_buffer_ratio = 0.5;
+    adjusted_rate_per_ms = rate_per_ms;
+    fn->filtered_buffer_ratio = 0.5;
   }
   uint32_t feedback_value = (uint32_t)(adjusted_rate_per_ms * (1 << 16));
-  usb_ep_n_start_transfer(EP_AUDIO_FEEDBACK_IN & 0x7F, true,
+  usb_ep_n_start_transfer(fn->ep_feedback & 0x7F, true,
                           (void*)&feedback_value, sizeof(feedback_value));
 }
 
-static void ep_audio_in_handler() {
-  //  feedback
-  // LOG_DEBUG("ep_audio_in_handler");
-  // 次の feedback を予約
-  feedback();
-}
-
 bool usb_audio_control_set_interface(uint8_t alt) { return alt == 0; }
 
-static uint8_t audio_stream_current_alt = 0;
-bool usb_audio_stream_set_interface(uint8_t alt) {
+static bool stream_set_interface(usb_audio_function_t* fn, uint8_t alt) {
   // 新しい alt を設定する
-  LOG_INFO("Set interface AUDIO_STREAM alt %d\r", alt);
-  if (3 < alt) {
+  LOG_INFO("Set interface AUDIO_STREAM %u alt %d\r", fn->id, alt);
+  const uint32_t rate = audio_device_get_sampling_freq(fn->id);
+  if (fn->max_alt < alt) {
     LOG_ERROR("unknown alt: %d", alt);
     return false;
   }
+  if (1 < alt && MAX_WIDE_FORMAT_SAMPLE_RATE < rate) {
+    // 176.4/192kHz では 24/32bit のパケットが入りきらない
+    LOG_ERROR("alt %d is not supported at %lu Hz", alt, rate);
+    return false;
+  }
+  if (5 < alt && alt <= AUDIO_ALT_MULTICHANNEL_LAST &&
+      (MAX_MULTICHANNEL_SAMPLE_RATE < rate || audio_device_uses_asrc())) {
+    // 4/6/8ch は 48kHz まで。ASRC はステレオのみ
+    LOG_ERROR("alt %d is not supported at %lu Hz", alt, rate);
+    return false;
+  }
+  if (alt == AUDIO_ALT_DSD && rate != AUDIO_DSD_SAMPLE_RATE) {
+    // DSD64 のフレームレートは 88.2kHz だけ
+    LOG_ERROR("alt %d is not supported at %lu Hz", alt, rate);
+    return false;
+  }
+  if (alt != 0 && !audio_device_is_rate_playable(fn->id, rate)) {
+    // 外部クロックは別のレートで動いている
+    LOG_ERROR("%lu Hz does not match the external clock", rate);
+    return false;
+  }
 
-  audio_stream_current_alt = alt;
+  fn->current_alt = alt;
 
-  audio_device_stream_stop();
+  audio_device_stream_stop(fn->id);
 
   if (alt == 1) {
-    audio_device_stream_start(16);
-    g_format = USB_SAMPLE_FORMAT_16;
+    audio_device_stream_start(fn->id, 16, 2);
+    fn->format = USB_SAMPLE_FORMAT_16;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE;
+    fn->frame_bytes = 4;
   } else if (alt == 2) {
-    audio_device_stream_start(24);
-    g_format = USB_SAMPLE_FORMAT_24;
+    audio_device_stream_start(fn->id, 24, 2);
+    fn->format = USB_SAMPLE_FORMAT_24;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE;
+    fn->frame_bytes = 8;
   } else if (alt == 3) {
-    audio_device_stream_start(32);
-    g_format = USB_SAMPLE_FORMAT_32;
+    audio_device_stream_start(fn->id, 32, 2);
+    fn->format = USB_SAMPLE_FORMAT_32;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE;
+    fn->frame_bytes = 8;
+  } else if (alt == 4) {
+    audio_device_stream_start(fn->id, 24, 2);
+    fn->format = USB_SAMPLE_FORMAT_24_PACKED;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE_24_PACKED;
+    fn->frame_bytes = 6;
+  } else if (alt == 5) {
+    audio_device_stream_start(fn->id, 32, 2);
+    fn->format = USB_SAMPLE_FORMAT_FLOAT32;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE;
+    fn->frame_bytes = 8;
+  } else if (alt == AUDIO_ALT_DSD) {
+    audio_device_stream_start_dsd(fn->id);
+    fn->format = USB_SAMPLE_FORMAT_DSD;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE_DSD;
+    fn->frame_bytes = 8;
+  } else if (5 < alt) {
+    // alt 6, 7, 8: 16bit の 4, 6, 8ch
+    const uint8_t channels = (alt - 4) * 2;
+    audio_device_stream_start(fn->id, 16, channels);
+    fn->format = USB_SAMPLE_FORMAT_16;
+    fn->max_packet_size = AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(channels);
+    fn->frame_bytes = channels * 2;
   }
 
   if (alt != 0) {
     // フィードバックをトリガ
-    feedback();
+    feedback(fn);
+  }
+
+  return true;
+}
+
+// USB スタックのハンドラは引数でファンクションを区別しないため、
+// ファンクションごとに薄いハンドラを用意する
+static void ep_audio_out_handler(const uint8_t* buf, uint16_t len) {
+  // LOG_DEBUG("ep_audio_out_handler: %d bytes received", len);
+  audio_out(&functions[0], buf, len);
+}
+
+static void ep_audio_in_handler() {
+  //  feedback
+  // LOG_DEBUG("ep_audio_in_handler");
+  // 次の feedback を予約
+  feedback(&functions[0]);
+}
+
+bool usb_audio_stream_set_interface(uint8_t alt) {
+  return stream_set_interface(&functions[0], alt);
+}
+
+#if PICODAC_ADC
+// 録音の IN ストリーム (1 つ目のファンクション)。alt 1: 16bit, alt 2: 24bit
+// パケットは audio_device が DPRAM のバッファへ直接詰める
+static uint8_t capture_alt = 0;
+
+static void capture_in() {
+  uint8_t* buf = usb_ep_n_get_in_buffer(EP_AUDIO_CAPTURE_IN & 0x7F);
+  const uint16_t len = audio_device_capture_fill(buf, AUDIO_MAX_PACKET_SIZE);
+  usb_ep_n_start_transfer(EP_AUDIO_CAPTURE_IN & 0x7F, true, NULL, len);
+}
+
+static void ep_audio_capture_in_handler() {
+  // 次のパケットを予約。alt 0 に戻ったら止める
+  if (capture_alt != 0) {
+    capture_in();
+  }
+}
+
+bool usb_audio_capture_set_interface(uint8_t alt) {
+  LOG_INFO("Set interface AUDIO_CAPTURE alt %d\r", alt);
+  const uint32_t rate = audio_device_get_sampling_freq(0);
+  if (2 < alt) {
+    LOG_ERROR("unknown alt: %d", alt);
+    return false;
+  }
+  if (alt == 2 && MAX_WIDE_FORMAT_SAMPLE_RATE < rate) {
+    // 24bit は再生と同じく 96kHz まで
+    LOG_ERROR("alt %d is not supported at %lu Hz", alt, rate);
+    return false;
   }
 
+  capture_alt = alt;
+  audio_device_capture_stop();
+  if (alt != 0) {
+    audio_device_capture_start(alt == 1 ? 16 : 24);
+    // 最初のパケットは溜まるまで空になる
+    capture_in();
+  }
   return true;
 }
+#endif
+
+#if PICODAC_DUAL_OUTPUT
+static void ep_audio2_out_handler(const uint8_t* buf, uint16_t len) {
+  audio_out(&functions[1], buf, len);
+}
+
+static void ep_audio2_in_handler() { feedback(&functions[1]); }
+
+bool usb_audio2_stream_set_interface(uint8_t alt) {
+  return stream_set_interface(&functions[1], alt);
+}
+#endif
 
 #define UAC2_CS_REQ_CUR 0x01
 #define UAC2_CS_REQ_RANGE 0x02
@@ -135,7 +323,8 @@ bool usb_audio_stream_set_interface(uint8_t alt) {
 
 bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
   uint8_t itf = pkt->wIndex & 0xFF;
-  if (itf != INTERFACE_AUDIO_CONTROL) {
+  const usb_audio_function_t* fn = function_of_control(itf);
+  if (fn == NULL) {
     LOG_ERROR("unhandled class in request for iff: %d", itf);
     return false;
   }
@@ -146,7 +335,7 @@ bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
       // GET Cur (Volume)
       static int16_t vol;
       uint8_t ch = pkt->wValue & 0xFF;
-      vol = audio_device_get_volume(ch);
+      vol = audio_device_get_volume(fn->id, ch);
       usb_ep0_start_transfer((void*)&vol, MIN(pkt->wLength, sizeof(vol)));
       // static const uint16_t zero = 0;
       // usb_ep0_start_transfer((void *)&zero, MIN(pkt->wLength, sizeof(zero)));
@@ -155,7 +344,7 @@ bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
       // Mute
       static uint8_t mute;
       uint8_t ch = pkt->wValue & 0xFF;
-      mute = audio_device_get_mute(ch);
+      mute = audio_device_get_mute(fn->id, ch);
       usb_ep0_start_transfer((void*)&mute, MIN(pkt->wLength, sizeof(mute)));
       // static const uint8_t zero = 0;
       // usb_ep0_start_transfer((void *)&zero, MIN(pkt->wLength, sizeof(zero)));
@@ -167,7 +356,7 @@ bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
       // GET RANGE (Volume)
       int16_t min, max, res;
       uint8_t ch = pkt->wValue & 0xFF;
-      audio_device_get_volume_range(ch, &min, &max, &res);
+      audio_device_get_volume_range(fn->id, ch, &min, &max, &res);
 
       struct range2b {
         uint16_t wNumSubRanges;
@@ -194,37 +383,33 @@ bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
           uint32_t dMIN;
           uint32_t dMAX;
           uint32_t dRES;
-        } subranges[4];
+        } subranges[N_SAMPLE_RATES];
       } __attribute__((packed));
 
-      static struct range4b ret = {
-          .wNumSubRages = 4,
-          .subranges[0] =
-              {
-                  .dMIN = 44100,
-                  .dMAX = 44100,
-                  .dRES = 0,
-              },
-          .subranges[1] =
-              {
-                  .dMIN = 48000,
-                  .dMAX = 48000,
-                  .dRES = 0,
-              },
-          .subranges[2] =
-              {
-                  .dMIN = 88200,
-                  .dMAX = 88200,
-                  .dRES = 0,
-              },
-          .subranges[3] =
-              {
-                  .dMIN = 96000,
-                  .dMAX = 96000,
-                  .dRES = 0,
-              },
-      };
-      usb_ep0_start_transfer((void*)&ret, MIN(pkt->wLength, sizeof(ret)));
+      // 176.4/192kHz は 16bit (alt 1) のみ
+      // 外部クロックのレートを測った後は、それに合うレートだけを返す
+      static struct range4b ret;
+      uint16_t n = 0;
+      for (uint32_t i = 0; i < N_SAMPLE_RATES; ++i) {
+        if (audio_device_is_rate_playable(fn->id, SAMPLE_RATES[i])) {
+          ret.subranges[n].dMIN = SAMPLE_RATES[i];
+          ret.subranges[n].dMAX = SAMPLE_RATES[i];
+          ret.subranges[n].dRES = 0;
+          ++n;
+        }
+      }
+      if (n == 0) {
+        // どのレートにも合わない場合も、列挙は通るように全レートを返す
+        for (n = 0; n < N_SAMPLE_RATES; ++n) {
+          ret.subranges[n].dMIN = SAMPLE_RATES[n];
+          ret.subranges[n].dMAX = SAMPLE_RATES[n];
+          ret.subranges[n].dRES = 0;
+        }
+      }
+      ret.wNumSubRages = n;
+      const uint16_t size =
+          sizeof(ret.wNumSubRages) + n * sizeof(ret.subranges[0]);
+      usb_ep0_start_transfer((void*)&ret, MIN(pkt->wLength, size));
       return true;
     }
   }
@@ -235,35 +420,72 @@ bool usb_audio_control_in_request(const struct usb_setup_packet_t* pkt) {
 
 bool usb_audio_control_ouot_request(const struct usb_setup_packet_t* pkt,
                                     const uint8_t* buf, uint16_t len) {
+  usb_audio_function_t* fn = function_of_control(pkt->wIndex & 0xFF);
+  if (fn == NULL) {
+    LOG_ERROR("unhandled class out request for iff: %d", pkt->wIndex & 0xFF);
+    return false;
+  }
   if (pkt->bmRequestType == 0x21 && pkt->bRequest == UAC2_CS_REQ_CUR &&
       (pkt->wValue >> 8) == UAC2_CS_SAM_FREQ_CONTROL &&
-      (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_CLOCK &&
-      (pkt->wIndex & 0xFF) == INTERFACE_AUDIO_CONTROL) {
+      (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_CLOCK) {
     // 周波数設定
     assert(pkt->wLength == 4);
     uint32_t freq = ((uint32_t)buf[0]) | ((uint32_t)buf[1] << 8) |
                     ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
-    audio_device_set_sampling_freq(freq);
+    bool supported = false;
+    for (uint32_t i = 0; i < N_SAMPLE_RATES; ++i) {
+      supported |= SAMPLE_RATES[i] == freq;
+    }
+    if (!supported) {
+      // TDM のスロット数によっては高いレートを出力できない
+      LOG_ERROR("%lu Hz is not supported", freq);
+      return false;
+    }
+    if (MAX_WIDE_FORMAT_SAMPLE_RATE < freq && 1 < fn->current_alt) {
+      // 24/32bit のパケットは 96kHz を超えると入りきらない
+      LOG_ERROR("%lu Hz is not supported with alt %d", freq, fn->current_alt);
+      return false;
+    }
+    if (MAX_MULTICHANNEL_SAMPLE_RATE < freq && 5 < fn->current_alt &&
+        fn->current_alt <= AUDIO_ALT_MULTICHANNEL_LAST) {
+      LOG_ERROR("%lu Hz is not supported with alt %d", freq, fn->current_alt);
+      return false;
+    }
+    if (fn->current_alt == AUDIO_ALT_DSD && freq != AUDIO_DSD_SAMPLE_RATE) {
+      LOG_ERROR("%lu Hz is not supported with alt %d", freq, fn->current_alt);
+      return false;
+    }
+#if PICODAC_ADC
+    // 録音は 1 つ目のファンクションのクロックを共有する
+    if (MAX_WIDE_FORMAT_SAMPLE_RATE < freq && fn->id == 0 && capture_alt == 2) {
+      LOG_ERROR("%lu Hz is not supported with capture alt 2", freq);
+      return false;
+    }
+#endif
+    if (!audio_device_is_rate_playable(fn->id, freq)) {
+      // 外部クロックは別のレートで動いている
+      LOG_ERROR("%lu Hz does not match the external clock", freq);
+      return false;
+    }
+    audio_device_set_sampling_freq(fn->id, freq);
     return true;
   } else if (pkt->bmRequestType == 0x21 && pkt->bRequest == UAC2_CS_REQ_CUR &&
              (pkt->wValue >> 8) == UAC2_FU_MUTE_CONTROL &&
-             (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_FEATURE_UNIT &&
-             (pkt->wIndex & 0xFF) == INTERFACE_AUDIO_CONTROL) {
+             (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_FEATURE_UNIT) {
     // mute 設定
     assert(pkt->wLength == 1);
     uint8_t ch = pkt->wValue & 0xFF;
-    audio_device_set_mute(ch, buf[0]);
+    audio_device_set_mute(fn->id, ch, buf[0]);
     LOG_DEBUG("set %s, ch(%d)", buf[0] ? "mute" : "unmute", ch);
     return true;
   } else if (pkt->bmRequestType == 0x21 && pkt->bRequest == UAC2_CS_REQ_CUR &&
              (pkt->wValue >> 8) == UAC2_FU_VOLUME_CONTROL &&
-             (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_FEATURE_UNIT &&
-             (pkt->wIndex & 0xFF) == INTERFACE_AUDIO_CONTROL) {
+             (pkt->wIndex >> 8) == AUDIO_CONTROL_ID_FEATURE_UNIT) {
     // 音量設定
     assert(pkt->wLength == 0x02);
     int16_t vol = (uint16_t)buf[0] | ((uint16_t)buf[1] << 8);
     uint8_t ch = pkt->wValue & 0xFF;
-    audio_device_set_volume(ch, vol);
+    audio_device_set_volume(fn->id, ch, vol);
     LOG_DEBUG("set volume %d dB, ch(%d)", vol / 256, ch);
     return true;
   }
@@ -291,4 +513,29 @@ void usb_audio_init() {
                                        usb_audio_control_set_interface);
   usb_device_set_set_interface_handler(INTERFACE_AUDIO_STREAM,
                                        usb_audio_stream_set_interface);
+
+#if PICODAC_ADC
+  usb_device_set_ep_in_handler(EP_AUDIO_CAPTURE_IN & 0x7F,
+                               ep_audio_capture_in_handler);
+  usb_device_set_set_interface_handler(INTERFACE_AUDIO_CAPTURE,
+                                       usb_audio_capture_set_interface);
+#endif
+
+#if PICODAC_DUAL_OUTPUT
+  usb_device_set_ep_out_handler(EP_AUDIO2_STREAM_OUT, ep_audio2_out_handler);
+  usb_device_set_ep_in_handler(EP_AUDIO2_FEEDBACK_IN & 0x7F,
+                               ep_audio2_in_handler);
+
+  usb_device_set_control_in_handler(INTERFACE_AUDIO2_CONTROL,
+                                    usb_audio_control_in_request);
+  usb_device_set_control_out_handler(INTERFACE_AUDIO2_CONTROL,
+                                     usb_audio_control_ouot_request);
+
+  usb_device_set_set_interface_handler(INTERFACE_AUDIO2_CONTROL,
+                                       usb_audio_control_set_interface);
+  usb_device_set_set_interface_handler(INTERFACE_AUDIO2_STREAM,
+                                       usb_audio2_stream_set_interface);
+#endif
+
+  usb_device_set_sof_handler(audio_device_on_usb_sof);
 }
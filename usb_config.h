@@ -11,27 +11,64 @@
 enum INTERFACE_ID {
   INTERFACE_AUDIO_CONTROL = 0,
   INTERFACE_AUDIO_STREAM,
+#if PICODAC_ADC
+  // ADC の録音 (PICODAC_ADC=1) は 1 つ目のファンクションの IN ストリーム
+  INTERFACE_AUDIO_CAPTURE,
+#endif
+#if PICODAC_DUAL_OUTPUT
+  // 2 つ目の出力 (PICODAC_DUAL_OUTPUT=1) は独立した UAC2 ファンクション
+  INTERFACE_AUDIO2_CONTROL,
+  INTERFACE_AUDIO2_STREAM,
+#endif
 #if HID_ENABLE
   INTERFACE_HID,
 #endif
   INTERFACE_NUM,
 };
 
-// UAC
+// UAC (1 ファンクションあたり)
 #define AUDIO_INTERFACE_NUM \
   ((INTERFACE_AUDIO_STREAM - INTERFACE_AUDIO_CONTROL) + 1)
+// 1 つ目のファンクションは録音のインターフェースを含む
+#define AUDIO_INTERFACE_NUM_FIRST (AUDIO_INTERFACE_NUM + (PICODAC_ADC ? 1 : 0))
 
+// 24/32bit は 96kHz、16bit は 192kHz ((192 + 1) * 2 * 2 = 772) まで収まる
 #define AUDIO_MAX_PACKET_SIZE ((96 + 1) * 4 * 2)
+// 3 バイトのサブスロットの 24bit (alt 4)
+#define AUDIO_MAX_PACKET_SIZE_24_PACKED ((96 + 1) * 3 * 2)
+// 16bit の 4/6/8ch (alt 6〜8) は 48kHz まで ((48 + 1) * 2 * 8 = 784)
+#define AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(channels) ((48 + 1) * 2 * (channels))
+// 4/6/8ch の alt 6〜8 は出力できるチャンネル数 (AUDIO_MAX_CHANNELS) まで
+#define AUDIO_ALT_MULTICHANNEL_LAST (5 + (AUDIO_MAX_CHANNELS - 2) / 2)
+// ネイティブ DSD64 (PICODAC_DSD=1) の alt は多チャンネルの alt の次
+// 88.2kHz のフレームに 1 チャンネル 32 ビットの DSD (2.8224MHz) を運ぶ
+#define AUDIO_ALT_DSD (AUDIO_ALT_MULTICHANNEL_LAST + 1)
+#define AUDIO_DSD_SAMPLE_RATE 88200
+// 88.2kHz のパケットは 88 か 89 フレーム ((89 + 1) * 4 * 2 = 720)
+#define AUDIO_MAX_PACKET_SIZE_DSD ((89 + 1) * 4 * 2)
+// 全 alt の中で最大のパケット
+#define AUDIO_MAX_PACKET_SIZE_ANY AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(8)
 
 #define EP_AUDIO_STREAM_OUT 0x01
 #define EP_AUDIO_FEEDBACK_IN 0x81
 
+#define EP_AUDIO2_STREAM_OUT 0x03
+#define EP_AUDIO2_FEEDBACK_IN 0x83
+
+// 録音はフィードバックなし (クロックはデバイス側)
+#define EP_AUDIO_CAPTURE_IN 0x84
+
 #define EP_HID_OUT 0x02
 #define EP_HID_IN 0x82
 
+// エンティティ ID は AC インターフェースごとの名前空間なので、2 つ目の
+// ファンクションも同じ ID を使う
 #define AUDIO_CONTROL_ID_INPUT 0x01
 #define AUDIO_CONTROL_ID_FEATURE_UNIT 0x02
 #define AUDIO_CONTROL_ID_OUTPUT 0x03
 #define AUDIO_CONTROL_ID_CLOCK 0x04
+// 録音: ADC の入力端子 -> USB ストリーミングの出力端子
+#define AUDIO_CONTROL_ID_CAPTURE_INPUT 0x05
+#define AUDIO_CONTROL_ID_CAPTURE_OUTPUT 0x06
 
 #define HID_INTERVAL_MS 200
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "audio_device.h"
 #include "usb_common.h"
 #include "usb_config.h"
 // TODO set string descriptor index
@@ -49,6 +50,27 @@ static const struct usb_device_descriptor device_descriptor = {
     .bNumConfigurations = 1   // One configuration
 };
 
+// 出力 0 のチャンネル構成は出力できるチャンネル数 (AUDIO_MAX_CHANNELS) に合わせる
+#if AUDIO_MAX_CHANNELS == 8
+#define OUTPUT_CHANNEL_CONFIG 0x63F  // 7.1 (FL FR FC LFE BL BR SL SR)
+#elif AUDIO_MAX_CHANNELS == 6
+#define OUTPUT_CHANNEL_CONFIG 0x3F  // 5.1 (FL FR FC LFE BL BR)
+#elif AUDIO_MAX_CHANNELS == 4
+#define OUTPUT_CHANNEL_CONFIG 0x33  // FL FR BL BR
+#else
+#define OUTPUT_CHANNEL_CONFIG 0x03  // Front LR
+#endif
+
+struct ac_feature_unit_descriptor {
+  uint8_t bLength;
+  uint8_t bDescriptorType;
+  uint8_t bDescriptorSubtype;
+  uint8_t bUnitID;
+  uint8_t bSourceID;
+  uint32_t bmaControls[1 + AUDIO_MAX_CHANNELS];  // Master + 各チャンネル
+  uint8_t iFeature;
+} __attribute__((packed));
+
 struct configuration_descriptor {
   struct usb_configuration_descriptor config;
   struct usb_interface_association_descriptor iad;
@@ -59,8 +81,14 @@ struct configuration_descriptor {
     struct usb_class_specific_ac_input_terminal_descriptor cs_ac_input_terminal;
     struct usb_class_specific_ac_output_terminal_descriptor
         cs_ac_output_terminal;
-    struct usb_class_specific_ac_feature_unit_descriptor_stereo
-        cs_ac_feature_unit;
+    struct ac_feature_unit_descriptor cs_ac_feature_unit;
+#if PICODAC_ADC
+    // 録音: 再生と同じクロックソースで ADC から USB へ
+    struct usb_class_specific_ac_input_terminal_descriptor
+        cs_ac_capture_input_terminal;
+    struct usb_class_specific_ac_output_terminal_descriptor
+        cs_ac_capture_output_terminal;
+#endif
   } __attribute__((packed)) ac;
   struct as {
     struct as_alt0 {
@@ -79,7 +107,61 @@ struct configuration_descriptor {
     } __attribute__((packed)) as_alt1;
     struct as_alt as_alt2;
     struct as_alt as_alt3;
+    struct as_alt as_alt4;
+    struct as_alt as_alt5;
+    // 4/6/8ch (alt 6〜8) は出力できるチャンネル数まで
+#if 4 <= AUDIO_MAX_CHANNELS
+    struct as_alt as_alt6;
+#endif
+#if 6 <= AUDIO_MAX_CHANNELS
+    struct as_alt as_alt7;
+#endif
+#if 8 <= AUDIO_MAX_CHANNELS
+    struct as_alt as_alt8;
+#endif
+#if PICODAC_DSD
+    // ネイティブ DSD64 (AUDIO_ALT_DSD)
+    struct as_alt as_alt_dsd;
+#endif
   } __attribute__((packed)) as;
+#if PICODAC_ADC
+  // 録音: ステレオの 16bit (alt 1) と 24bit (alt 2)。フィードバックなし
+  struct as_capture {
+    struct as_alt0 as_alt0;
+    struct as_capture_alt {
+      usb_standard_as_interface_descriptor as_interface;
+      struct usb_class_specific_as_interface_descriptor cs_as_interface;
+      struct usb_class_specific_as_type_i_format_descriptor cs_as_format_type;
+      struct usb_standard_as_isochronous_audio_data_endpoint_descriptor
+          as_audio_data_endpoint;
+      struct usb_class_specific_as_isochronous_audio_data_endpoint_descriptor
+          cs_as_audio_data_endpoint;
+    } __attribute__((packed)) as_alt1;
+    struct as_capture_alt as_alt2;
+  } __attribute__((packed)) as_capture;
+#endif
+#if PICODAC_DUAL_OUTPUT
+  // 2 つ目の出力: ステレオのみ (alt 1〜5)
+  struct usb_interface_association_descriptor iad2;
+  struct ac2 {
+    usb_standard_ac_interface_descriptor ac_interface;
+    struct usb_class_specific_ac_interface_header_descriptor cs_ac_interface;
+    struct usb_class_specific_ac_clock_source_descriptor cs_ac_clock_source;
+    struct usb_class_specific_ac_input_terminal_descriptor cs_ac_input_terminal;
+    struct usb_class_specific_ac_output_terminal_descriptor
+        cs_ac_output_terminal;
+    struct usb_class_specific_ac_feature_unit_descriptor_stereo
+        cs_ac_feature_unit;
+  } __attribute__((packed)) ac2;
+  struct as2 {
+    struct as_alt0 as_alt0;
+    struct as_alt as_alt1;
+    struct as_alt as_alt2;
+    struct as_alt as_alt3;
+    struct as_alt as_alt4;
+    struct as_alt as_alt5;
+  } __attribute__((packed)) as2;
+#endif
 #if HID_ENABLE
   struct hid {
     struct usb_interface_descriptor_t hid_interface;
@@ -106,7 +188,7 @@ struct configuration_descriptor {
 
             .bDescriptorType = USB_DT_IAD,
             .bFirstInterface = INTERFACE_AUDIO_CONTROL,
-            .bInterfaceCount = AUDIO_INTERFACE_NUM,
+            .bInterfaceCount = AUDIO_INTERFACE_NUM_FIRST,
             .bFunctionClass = 0x01,     // USB Audio Class
             .bFunctionSubClass = 0x00,  // Subclass Undefined
             .bFunctionProtocol = 0x20,  // UAC 2.0
@@ -134,7 +216,11 @@ struct configuration_descriptor {
                     .bDescriptorType = USB_DT_CS_INTERFACE,
                     .bDescriptorSubtype = 0x01,  // HEADER
                     .bcdACD = 0x0200,            // ADC version
-                    .bCategory = 0x01,           // Desktop Speaker
+#if PICODAC_ADC
+                    .bCategory = 0x08,  // I/O Box
+#else
+                    .bCategory = 0x01,  // Desktop Speaker
+#endif
                     .wTotalLength =
                         sizeof(struct ac) -
                         sizeof(usb_standard_ac_interface_descriptor),
@@ -163,8 +249,9 @@ struct configuration_descriptor {
                     .wTerminalType = 0x0101,                // USB STREAMING
                     .bAssocTerminal = 0x00,                 // Assoc (None)
                     .bCSourceID = AUDIO_CONTROL_ID_CLOCK,   // Clock Source ID
-                    .bNrChannels = 0x02,                    // Channels
-                    .bmChannelConfig = 0x03,                // Front LR
+                    // ステレオの alt は先頭 2ch (FL, FR) だけを使う
+                    .bNrChannels = AUDIO_MAX_CHANNELS,      // Channels
+                    .bmChannelConfig = OUTPUT_CHANNEL_CONFIG,
                     .iChannelNames = 0,
                     .bmControls = 0,
                     .iTerminal = 0,
@@ -186,9 +273,7 @@ struct configuration_descriptor {
                 },
             .cs_ac_feature_unit =
                 {
-                    .bLength = sizeof(
-                        struct
-                        usb_class_specific_ac_feature_unit_descriptor_stereo),
+                    .bLength = sizeof(struct ac_feature_unit_descriptor),
                     .bDescriptorType = USB_DT_CS_INTERFACE,
                     .bDescriptorSubtype = 0x06,  // FEATURE_UNIT
                     .bUnitID = AUDIO_CONTROL_ID_FEATURE_UNIT,
@@ -196,11 +281,56 @@ struct configuration_descriptor {
                     .bmaControls =
                         {
                             0b1111,  // Master (Mute, Vol)
-                            0b1111,  // Left (Mute, Vol)
-                            0b1111,  // Right (Mute, Vol)
+                            0b1111,  // FL (Mute, Vol)
+                            0b1111,  // FR (Mute, Vol)
+#if 4 <= AUDIO_MAX_CHANNELS
+                            0b1111,  // FC, 4ch では BL (Mute, Vol)
+                            0b1111,  // LFE, 4ch では BR (Mute, Vol)
+#endif
+#if 6 <= AUDIO_MAX_CHANNELS
+                            0b1111,  // BL (Mute, Vol)
+                            0b1111,  // BR (Mute, Vol)
+#endif
+#if 8 <= AUDIO_MAX_CHANNELS
+                            0b1111,  // SL (Mute, Vol)
+                            0b1111,  // SR (Mute, Vol)
+#endif
                         },
                     .iFeature = 0,
                 },
+#if PICODAC_ADC
+            .cs_ac_capture_input_terminal =
+                {
+                    .bLength = sizeof(
+                        struct usb_class_specific_ac_input_terminal_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x02,  // INPUT_TERMIKNAL
+                    .bTerminalID = AUDIO_CONTROL_ID_CAPTURE_INPUT,
+                    .wTerminalType = 0x0603,               // Line Connector
+                    .bAssocTerminal = 0x00,                // Assoc (None)
+                    .bCSourceID = AUDIO_CONTROL_ID_CLOCK,  // Clock Source ID
+                    .bNrChannels = 0x02,                   // Channels
+                    .bmChannelConfig = 0x03,               // Front LR
+                    .iChannelNames = 0,
+                    .bmControls = 0,
+                    .iTerminal = 0,
+                },
+            .cs_ac_capture_output_terminal =
+                {
+                    .bLength = sizeof(
+                        struct
+                        usb_class_specific_ac_output_terminal_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x03,  // OUTPUT_TERMINAL
+                    .bTerminalID = AUDIO_CONTROL_ID_CAPTURE_OUTPUT,
+                    .wTerminalType = 0x0101,  // USB STREAMING
+                    .bAssocTerminal = 0x00,   // Assoc (None)
+                    .bSourceID = AUDIO_CONTROL_ID_CAPTURE_INPUT,
+                    .bCSourceID = AUDIO_CONTROL_ID_CLOCK,  // Clock Source
+                    .bmControls = 0,
+                    .iTerminal = 0,
+                },
+#endif
         },
     .as =
         {
@@ -464,7 +594,1199 @@ struct configuration_descriptor {
                             .bInterval = 1,
                         },
                 },
-        },
+            .as_alt4 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = 4,      // Alt 4 (24bit, packed)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 3,           // bytes per sample
+                            .bBitResolution = 24,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_24_PACKED,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+            .as_alt5 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = 5,      // Alt 5 (32bit float)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x04,        // IEEE_FLOAT
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 32,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+#if 4 <= AUDIO_MAX_CHANNELS
+            .as_alt6 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = 6,      // Alt 6 (16bit 4ch)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 4,         // Channels
+                            .bmChannelConfig = 0x33,  // FL FR BL BR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 2,           // bytes per sample
+                            .bBitResolution = 16,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(4),
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+#endif
+#if 6 <= AUDIO_MAX_CHANNELS
+            .as_alt7 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = 7,      // Alt 7 (16bit 6ch)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 6,         // Channels
+                            .bmChannelConfig = 0x3F,  // 5.1 (FL FR FC LFE BL BR)
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 2,           // bytes per sample
+                            .bBitResolution = 16,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(6),
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+#endif
+#if 8 <= AUDIO_MAX_CHANNELS
+            .as_alt8 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = 8,      // Alt 8 (16bit 8ch)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 8,         // Channels
+                            .bmChannelConfig = 0x63F,  // 7.1 (FL FR FC LFE BL BR SL SR)
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 2,           // bytes per sample
+                            .bBitResolution = 16,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_MULTICHANNEL(8),
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+#endif
+#if PICODAC_DSD
+            .as_alt_dsd =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_STREAM,
+                            .bAlternateSetting = AUDIO_ALT_DSD,  // DSD64
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x80000000,  // TYPE_I_RAW_DATA
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 32,        // DSD bits per channel
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_DSD,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+#endif
+        },
+#if PICODAC_ADC
+    .as_capture =
+        {
+            .as_alt0 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_CAPTURE,
+                            .bAlternateSetting = 0,      // Alt 0
+                            .bNumEndpoint = 0,           // No endpoints
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                },
+            .as_alt1 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_CAPTURE,
+                            .bAlternateSetting = 1,      // Alt 1 (16bit)
+                            .bNumEndpoint = 1,           // AS
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_CAPTURE_OUTPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 2,           // bytes per sample
+                            .bBitResolution = 16,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_CAPTURE_IN,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 0,        // Undefined
+                            .wLockDelay = 0,
+                        },
+                },
+            .as_alt2 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO_CAPTURE,
+                            .bAlternateSetting = 2,      // Alt 2 (24bit)
+                            .bNumEndpoint = 1,           // AS
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_CAPTURE_OUTPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 24,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO_CAPTURE_IN,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 0,        // Undefined
+                            .wLockDelay = 0,
+                        },
+                },
+        },
+#endif
+#if PICODAC_DUAL_OUTPUT
+    .iad2 =
+        {
+            .bLength = sizeof(struct usb_interface_association_descriptor),
+
+            .bDescriptorType = USB_DT_IAD,
+            .bFirstInterface = INTERFACE_AUDIO2_CONTROL,
+            .bInterfaceCount = AUDIO_INTERFACE_NUM,
+            .bFunctionClass = 0x01,     // USB Audio Class
+            .bFunctionSubClass = 0x00,  // Subclass Undefined
+            .bFunctionProtocol = 0x20,  // UAC 2.0
+            .iFunction = 0,             // TODO string index
+        },
+    .ac2 =
+        {
+            .ac_interface =
+                {
+                    .bLength = sizeof(usb_standard_ac_interface_descriptor),
+                    .bDescriptorType = USB_DT_INTERFACE,
+                    .bInterfaceNumber = INTERFACE_AUDIO2_CONTROL,
+                    .bAlternateSetting = 0,      // Alt 0
+                    .bNumEndpoint = 0,           // No endpoints
+                    .bInterfaceClass = 0x01,     // AUDIO
+                    .bInterfaceSubClass = 0x01,  // AUDIO_CONTROL
+                    .bInterfaceProtocol = 0x20,  // UAC 2.0
+                    .iInterface = 0,             // TODO string index
+                },
+            .cs_ac_interface =
+                {
+                    .bLength = sizeof(
+                        struct
+                        usb_class_specific_ac_interface_header_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x01,  // HEADER
+                    .bcdACD = 0x0200,            // ADC version
+                    .bCategory = 0x01,           // Desktop Speaker
+                    .wTotalLength =
+                        sizeof(struct ac2) -
+                        sizeof(usb_standard_ac_interface_descriptor),
+                    .bmControls = 0x00,
+                },
+            .cs_ac_clock_source =
+                {
+                    .bLength = sizeof(
+                        struct usb_class_specific_ac_clock_source_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x0A,          // CLOCK_SOURCE
+                    .bClockID = AUDIO_CONTROL_ID_CLOCK,  // Clock Source ID
+                    // TODO
+                    .bmAttributes = 0x03,    // Internal Programmable Clock
+                    .bmControls = 0x03,      // RW (Sampling Freq)
+                    .bAssocTerminal = 0x01,  // Assoc (Input Terminal)
+                    .iClockSource = 0,
+                },
+            .cs_ac_input_terminal =
+                {
+                    .bLength = sizeof(
+                        struct usb_class_specific_ac_input_terminal_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x02,             // INPUT_TERMIKNAL
+                    .bTerminalID = AUDIO_CONTROL_ID_INPUT,  // Input Terminal ID
+                    .wTerminalType = 0x0101,                // USB STREAMING
+                    .bAssocTerminal = 0x00,                 // Assoc (None)
+                    .bCSourceID = AUDIO_CONTROL_ID_CLOCK,   // Clock Source ID
+                    .bNrChannels = 0x02,                    // Channels
+                    .bmChannelConfig = 0x03,                // Front LR
+                    .iChannelNames = 0,
+                    .bmControls = 0,
+                    .iTerminal = 0,
+                },
+            .cs_ac_output_terminal =
+                {
+                    .bLength = sizeof(
+                        struct
+                        usb_class_specific_ac_output_terminal_descriptor),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x03,  // OUTPUT_TERMINAL
+                    .bTerminalID = AUDIO_CONTROL_ID_OUTPUT,
+                    .wTerminalType = 0x0302,  // Headphones
+                    .bAssocTerminal = 0x001,  // Assoc (Input)
+                    .bSourceID = AUDIO_CONTROL_ID_FEATURE_UNIT,
+                    .bCSourceID = AUDIO_CONTROL_ID_CLOCK,  // Clock Source
+                    .bmControls = 0,
+                    .iTerminal = 0,
+                },
+            .cs_ac_feature_unit =
+                {
+                    .bLength = sizeof(
+                        struct
+                        usb_class_specific_ac_feature_unit_descriptor_stereo),
+                    .bDescriptorType = USB_DT_CS_INTERFACE,
+                    .bDescriptorSubtype = 0x06,  // FEATURE_UNIT
+                    .bUnitID = AUDIO_CONTROL_ID_FEATURE_UNIT,
+                    .bSourceID = AUDIO_CONTROL_ID_INPUT,
+                    .bmaControls =
+                        {
+                            0b1111,  // Master (Mute, Vol)
+                            0b1111,  // FL (Mute, Vol)
+                            0b1111,  // FR (Mute, Vol)
+                        },
+                    .iFeature = 0,
+                },
+        },
+    .as2 =
+        {
+            .as_alt0 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 0,      // Alt 0
+                            .bNumEndpoint = 0,           // No endpoints
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                },
+            .as_alt1 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 1,      // Alt 1 (16bit)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength = sizeof(
+                                struct
+                                usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,       // TODO string index
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength = sizeof(
+                                struct
+                                usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 2,           // bytes per sample
+                            .bBitResolution = 16,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+            .as_alt2 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 2,      // Alt 2 (24bit)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 24,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+            .as_alt3 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 3,      // Alt 3 (32bit)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 32,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+            .as_alt4 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 4,      // Alt 4 (24bit, packed)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x01,        // PCM
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 3,           // bytes per sample
+                            .bBitResolution = 24,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE_24_PACKED,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+            .as_alt5 =
+                {
+                    .as_interface =
+                        {
+                            .bLength =
+                                sizeof(usb_standard_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_INTERFACE,
+                            .bInterfaceNumber = INTERFACE_AUDIO2_STREAM,
+                            .bAlternateSetting = 5,      // Alt 5 (32bit float)
+                            .bNumEndpoint = 2,           // AS and Feedback
+                            .bInterfaceClass = 0x01,     // AUDIO
+                            .bInterfaceSubClass = 0x02,  // AUDIO_STREAMING
+                            .bInterfaceProtocol = 0x20,  // UAC 2.0
+                            .iInterface = 0,             // TODO string index
+                        },
+                    .cs_as_interface =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_interface_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x01,  // AS_GENERAL
+                            .bTerminalLink = AUDIO_CONTROL_ID_INPUT,
+                            .bmControls = 0,          // None
+                            .bFormatType = 0x01,      // Type I
+                            .bmFormats = 0x04,        // IEEE_FLOAT
+                            .bNrChannels = 2,         // Channels
+                            .bmChannelConfig = 0x03,  // Front LR
+                            .iChannelNames = 0,
+                        },
+                    .cs_as_format_type =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_type_i_format_descriptor),
+                            .bDescriptorType = USB_DT_CS_INTERFACE,
+                            .bDescriptorSubtype = 0x02,  // FORMAT_TYPE
+                            .bFormatType = 0x01,         // TYPE_I
+                            .bSubslotSize = 4,           // bytes per sample
+                            .bBitResolution = 32,        // bits per sample
+                        },
+                    .as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_STREAM_OUT,
+                            .bmAttributes = 0b0101,  // asyncrhnous(0b100) and
+                                                     // ishochronous(0b01)
+                            .wMaxPacketSize = AUDIO_MAX_PACKET_SIZE,
+                            .bInterval = 0x01,  // 1ms
+                        },
+                    .cs_as_audio_data_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_class_specific_as_isochronous_audio_data_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_CS_ENDPOINT,
+                            .bDescriptorSubtype = 0x01,  // EP_GENERAL
+                            .bmAttributes = 0,           // Non Max Packet Only
+                            .bmControls = 0x00,          // None
+                            .bLockDelayUnits = 1,        // ms
+                            .wLockDelay = 1,             // TODO 0?
+                        },
+                    .as_isochronous_feedback_endpoint =
+                        {
+                            .bLength =
+                                sizeof(
+                                    struct
+                                    usb_standard_as_isochronous_feedback_endpoint_descriptor),
+                            .bDescriptorType = USB_DT_ENDPOINT,
+                            .bEndpointAddress = EP_AUDIO2_FEEDBACK_IN,
+                            .bmAttributes = 0x11,
+                            .wMaxPacketSize = 0x04,
+                            .bInterval = 1,
+                        },
+                },
+        },
+#endif
 #if HID_ENABLE
     .hid =
         {
@@ -3,19 +3,212 @@
 #include "usb_hid.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include "audio_device.h"
+#include "clock_monitor.h"
+#include "i2s.h"
 #include "log.h"
 #include "usb.h"
 #include "usb_config.h"
 
+// テレメトリ
+// OUT レポートの先頭バイトでページを選択し、以降の IN レポートで
+// 選択中のページを返す。IN レポートの先頭バイトはページ番号
+// 各ページのフィールドはリトルエンディアン
+// ページ番号の bit 7 (HID_PAGE_OUTPUT_1) で 2 つ目の出力の値を選ぶ
+// クロックモニタ、HID_PAGE_HEADROOM、HID_PAGE_SPDIF_IN、HID_PAGE_PDM と
+// HID_PAGE_CAPTURE は出力によらない
+enum {
+  HID_PAGE_NONE = 0x00,
+  // [1] valid, [2:3] start frame, [4:5] SOF -> start (us),
+  // [6:7] start error (us, signed)
+  HID_PAGE_SYNC_START = 0x01,
+  // [1] valid, [2:5] LRCLK rate (mHz), [6:9] error (ppb, signed),
+  // [10:11] RMS period jitter (ns), [12:13] peak-to-peak period jitter (ns)
+  HID_PAGE_CLOCK_MONITOR = 0x02,
+  // [1:4] underruns, [5:8] overruns, [9:12] overrun bytes
+  HID_PAGE_BUFFER = 0x03,
+  // [1] active, [2:5] ratio adjustment (ppb, signed), [6:9] cycles per frame
+  HID_PAGE_ASRC = 0x04,
+  // [1] bit 0: valid, bit 1: buffer kept, [2:5] SET_INTERFACE -> first
+  // sample (us), [6:9] first packet -> first sample (us),
+  // [10:11] reconfiguration time (us), [12:15] output gap (us)
+  HID_PAGE_START = 0x05,
+  // [1] adaptive, [2:5] target depth (us), [6:9] packet interval spread (us),
+  // [10:13] lowest fill in the window (us), [14:15] ring buffer length (ms)
+  HID_PAGE_DEPTH = 0x06,
+  // [1:2] DMA block length (us), [3:4] load (permille), [5:8] cycles per block,
+  // [9:12] sample rate (Hz), [13:14] spare cycles per frame
+  HID_PAGE_CPU = 0x07,
+  // [1:4] last underrun duration (us), [5:8] frames concealed by it,
+  // [9:12] frames concealed since boot
+  HID_PAGE_UNDERRUN = 0x08,
+  // [1:4] PIO TX stalls, [5:8] frame count at the last one,
+  // [9:12] ms since the last one (0xFFFFFFFF: none), [13] DMA chain stopped
+  HID_PAGE_HW_UNDERRUN = 0x09,
+  // [1:2] DPRAM allocated to endpoint buffers (bytes), [3:4] DPRAM size,
+  // [5:6] load of all playing outputs (permille), [7] outputs
+  HID_PAGE_HEADROOM = 0x0A,
+  // [1] bit 0: locked, bit 1: playing, [2:5] sample rate (Hz),
+  // [6:9] bad subframes, [10:13] frames dropped or repeated
+  HID_PAGE_SPDIF_IN = 0x0B,
+  // [1] active, [2:3] core 1 load (permille), [4:7] cycles per block,
+  // [8:9] cycles per bit of one channel (x100), [10:13] late blocks,
+  // [14:15] modulator resets
+  HID_PAGE_PDM = 0x0C,
+  // [1] bit 0: active, bit 1: clocks for the capture alone, [2] bit depth,
+  // [3:4] load (permille), [5:8] cycles per packet, [9:10] depth (us),
+  // [11:12] slipped packets, [13:14] empty packets
+  HID_PAGE_CAPTURE = 0x0D,
+
+  HID_PAGE_OUTPUT_1 = 0x80,
+};
+
+#define HID_REPORT_SIZE 16
+
+static uint8_t current_page = HID_PAGE_NONE;
+static uint8_t report[HID_REPORT_SIZE];
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  put_u16(p, v & 0xFFFF);
+  put_u16(p + 2, v >> 16);
+}
+
+static void fill_report() {
+  memset(report, 0, sizeof(report));
+  report[0] = current_page;
+  const uint8_t id = current_page & HID_PAGE_OUTPUT_1 ? 1 : 0;
+  if (AUDIO_DEVICE_NUM <= id) {
+    return;
+  }
+  switch (current_page & ~HID_PAGE_OUTPUT_1) {
+    case HID_PAGE_SYNC_START: {
+      audio_device_sync_start_stats_t stats;
+      audio_device_get_sync_start_stats(id, &stats);
+      report[1] = stats.valid;
+      put_u16(&report[2], stats.start_frame);
+      put_u16(&report[4], stats.sof_to_start_us);
+      put_u16(&report[6], (uint16_t)stats.start_error_us);
+    } break;
+    case HID_PAGE_CLOCK_MONITOR: {
+      clock_monitor_stats_t stats;
+      clock_monitor_get_stats(&stats);
+      report[1] = stats.valid;
+      put_u32(&report[2], stats.rate_mhz);
+      put_u32(&report[6], (uint32_t)stats.error_ppb);
+      put_u16(&report[10], stats.jitter_rms_ns);
+      put_u16(&report[12], stats.jitter_pp_ns);
+    } break;
+    case HID_PAGE_BUFFER: {
+      audio_device_stats_t stats;
+      audio_device_get_stats(id, &stats);
+      put_u32(&report[1], stats.underruns);
+      put_u32(&report[5], stats.overruns);
+      put_u32(&report[9], stats.overrun_bytes);
+    } break;
+    case HID_PAGE_ASRC: {
+      audio_device_asrc_stats_t stats;
+      audio_device_get_asrc_stats(id, &stats);
+      report[1] = stats.active;
+      put_u32(&report[2], (uint32_t)stats.ratio_ppb);
+      put_u32(&report[6], stats.cycles_per_frame);
+    } break;
+    case HID_PAGE_START: {
+      audio_device_start_stats_t stats;
+      audio_device_get_start_stats(id, &stats);
+      report[1] = stats.valid | stats.ring_kept << 1;
+      put_u32(&report[2], stats.stream_start_to_first_sample_us);
+      put_u32(&report[6], stats.first_packet_to_first_sample_us);
+      put_u16(&report[10], stats.switch_us > UINT16_MAX ? UINT16_MAX
+                                                         : stats.switch_us);
+      put_u32(&report[12], stats.output_gap_us);
+    } break;
+    case HID_PAGE_DEPTH: {
+      audio_device_depth_stats_t stats;
+      audio_device_get_depth_stats(id, &stats);
+      report[1] = stats.adaptive;
+      put_u32(&report[2], stats.target_depth_us);
+      put_u32(&report[6], stats.jitter_us);
+      put_u32(&report[10], stats.min_fill_us);
+      put_u16(&report[14], stats.ring_ms);
+    } break;
+    case HID_PAGE_CPU: {
+      audio_device_cpu_stats_t stats;
+      audio_device_get_cpu_stats(id, &stats);
+      put_u16(&report[1], stats.block_us);
+      put_u16(&report[3], stats.load_permille);
+      put_u32(&report[5], stats.cycles_per_block);
+      put_u32(&report[9], stats.sample_rate);
+      put_u16(&report[13], stats.spare_cycles_per_frame);
+    } break;
+    case HID_PAGE_UNDERRUN: {
+      audio_device_underrun_stats_t stats;
+      audio_device_get_underrun_stats(id, &stats);
+      put_u32(&report[1], stats.last_duration_us);
+      put_u32(&report[5], stats.last_concealed_frames);
+      put_u32(&report[9], stats.concealed_frames);
+    } break;
+    case HID_PAGE_HW_UNDERRUN: {
+      i2s_underrun_stats_t stats;
+      audio_device_get_hw_underrun_stats(id, &stats);
+      put_u32(&report[1], stats.tx_stalls);
+      put_u32(&report[5], stats.last_stall_frame);
+      put_u32(&report[9], stats.ms_since_stall);
+      report[13] = stats.dma_stopped;
+    } break;
+    case HID_PAGE_HEADROOM:
+      put_u16(&report[1], usb_device_get_dpram_used());
+      put_u16(&report[3], usb_device_get_dpram_size());
+      put_u16(&report[5], audio_device_get_total_load_permille());
+      report[7] = AUDIO_DEVICE_NUM;
+      break;
+    case HID_PAGE_SPDIF_IN: {
+      audio_device_spdif_in_stats_t stats;
+      audio_device_get_spdif_in_stats(&stats);
+      report[1] = stats.locked | stats.playing << 1;
+      put_u32(&report[2], stats.sample_rate);
+      put_u32(&report[6], stats.bad_subframes);
+      put_u32(&report[10], stats.slips);
+    } break;
+    case HID_PAGE_PDM: {
+      i2s_pdm_stats_t stats;
+      audio_device_get_pdm_stats(&stats);
+      report[1] = stats.active;
+      put_u16(&report[2], stats.load_permille);
+      put_u32(&report[4], stats.cycles_per_block);
+      put_u16(&report[8], (uint16_t)stats.centicycles_per_bit);
+      put_u32(&report[10], stats.late_blocks);
+      put_u16(&report[14], (uint16_t)stats.resets);
+    } break;
+    case HID_PAGE_CAPTURE: {
+      audio_device_capture_stats_t stats;
+      audio_device_get_capture_stats(&stats);
+      report[1] = stats.active | stats.clock_only << 1;
+      report[2] = stats.bit_depth;
+      put_u16(&report[3], stats.load_permille);
+      put_u32(&report[5], stats.cycles_per_packet);
+      put_u16(&report[9], (uint16_t)stats.depth_us);
+      put_u16(&report[11], (uint16_t)stats.slips);
+      put_u16(&report[13], (uint16_t)stats.empty_packets);
+    } break;
+    default:
+      break;
+  }
+}
+
 bool usb_hid_set_interface(uint8_t alt) {
   // 新しい alt を設定する
   LOG_INFO("Set interface HID alt %d\r", alt);
 
   assert(alt == 0);
-  static uint8_t zero[16] = {0};
-  usb_ep_n_start_transfer(EP_HID_IN & 0x7F, true, zero, sizeof(zero));
+  fill_report();
+  usb_ep_n_start_transfer(EP_HID_IN & 0x7F, true, report, sizeof(report));
   usb_ep_n_start_transfer(EP_HID_OUT, false, NULL, 16);
   return true;
 }
@@ -39,13 +232,16 @@ bool usb_hid_control_out_request(const struct usb_setup_packet_t *pkt,
 
 static void ep_hid_out_handler(const uint8_t *buf, uint16_t len) {
   LOG_INFO("ep_hid_out_handler: %d byte", len);
+  if (0 < len) {
+    current_page = buf[0];
+  }
   usb_ep_n_start_transfer(EP_HID_OUT, false, NULL, 16);
 }
 
-static uint8_t zero[16] = {0};
 static void ep_hid_in_handler() {
   // LOG_INFO("ep_hid_in_handler");
-  usb_ep_n_start_transfer(EP_HID_IN & 0x7F, true, zero, sizeof(zero));
+  fill_report();
+  usb_ep_n_start_transfer(EP_HID_IN & 0x7F, true, report, sizeof(report));
 }
 
 void usb_hid_init() {